@@ -11,6 +11,8 @@ def parseArgs():
     parser.add_argument('-c', '--clean', action='store_true')
     parser.add_argument('-S', '--sim-trace', action='store_true')
     parser.add_argument('-C', '--console-print', action='store_true')
+    parser.add_argument('-N', '--native', action='store_true')
+    parser.add_argument('-R', '--coroutine-engine', action='store_true')
 
     args = parser.parse_args()
     return args
@@ -35,11 +37,15 @@ if __name__ == "__main__":
         build_type = "-DCMAKE_BUILD_TYPE=Debug"
     if args.console_print:
         defines.append("-DCONSOLE_PRINT=1")
+    if args.native:
+        defines.append("-DNATIVE=1")
+    if args.coroutine_engine:
+        defines.append("-DCOROUTINE_ENGINE=1")
     if args.sim_trace:
         defines.append("-DSIM_TRACE=1")
     else:
         defines.append("-DSIM_TRACE=0")
 
-    os.system('cmake ' + build_type + ' -S . -B ' + build_dir + ' ' + ''.join(str(x) for x in defines))
+    os.system('cmake ' + build_type + ' -S . -B ' + build_dir + ' ' + ' '.join(str(x) for x in defines))
     os.system('cmake --build build --config ' + args.build_type)
 
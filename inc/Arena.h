@@ -0,0 +1,119 @@
+#pragma once
+
+#include <assert.h>
+#include <memory>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "HugePages.h"
+#include "TagMatch.h"
+#include "debug.h"
+
+/**
+ * Bump allocator owned by a worker thread. It is sized for the config the worker runs and reset between configs, so
+ * setting up and tearing down a cache hierarchy performs no heap allocations, and the memory is only reallocated when
+ * the next config needs a different size. Large arenas are backed with huge pages. Every allocation starts on its own
+ * cache line. Destructors are never run, so only trivially destructible types may be allocated
+ */
+class Arena {
+  public:
+    Arena() = default;
+
+    /**
+     * @brief                   Construct an arena whose backing memory is counted
+     *
+     * @param pHugePageUsage    Usage to count the backing memory in
+     */
+    explicit Arena(HugePageUsage* pHugePageUsage) : storage_(HugePageAllocator<CacheLine>(pHugePageUsage)) {
+    }
+    Arena(const Arena&) = delete;
+    Arena operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+
+    /**
+     * @brief                   Sizes the backing memory to exactly what a config needs, so the arena holds no more
+     * than its admission was charged. Kept as is when it already has that size
+     *
+     * @param capacityInBytes   Bytes needed by the config, as summed with GetAllocationSize
+     */
+    void Resize(uint64_t capacityInBytes);
+
+    /**
+     * @brief Frees the backing memory
+     */
+    void Release();
+
+    /**
+     * @brief Makes all of the memory available again. Everything allocated before is invalidated
+     */
+    inline void Reset() {
+        usedLines_ = 0;
+    }
+
+    /**
+     * @brief           Get the number of bytes an allocation of count objects takes up in an arena
+     *
+     * @tparam T        Type of the objects
+     * @param count     Number of objects
+     * @return          Size in bytes, a multiple of the cache line size
+     */
+    template <typename T>
+    static constexpr uint64_t GetAllocationSize(uint64_t count) {
+        return (count * sizeof(T) + kCacheLineSizeInBytes - 1) / kCacheLineSizeInBytes * kCacheLineSizeInBytes;
+    }
+
+    /**
+     * @brief           Allocates a value-initialized array
+     *
+     * @tparam T        Type of the objects
+     * @param count     Number of objects
+     * @return          Pointer to the first object
+     */
+    template <typename T>
+    T* Allocate(uint64_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena memory is reused without running destructors");
+        T* pObjects = reinterpret_cast<T*>(bump(GetAllocationSize<T>(count)));
+        std::uninitialized_value_construct_n(pObjects, count);
+        return pObjects;
+    }
+
+    /**
+     * @brief               Constructs a single object
+     *
+     * @tparam T            Type of the object
+     * @param arguments     Constructor arguments
+     * @return              Pointer to the object
+     */
+    template <typename T, typename... Arguments>
+    T* New(Arguments&&... arguments) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena memory is reused without running destructors");
+        return new (bump(GetAllocationSize<T>(1))) T(std::forward<Arguments>(arguments)...);
+    }
+
+    /**
+     * @brief Get the number of bytes allocated since the last reset
+     */
+    inline uint64_t GetUsedBytes() const {
+        return usedLines_ * kCacheLineSizeInBytes;
+    }
+
+  private:
+    /**
+     * @brief               Hands out the next sizeInBytes bytes
+     *
+     * @param sizeInBytes   Multiple of the cache line size
+     * @return              Pointer to the memory
+     */
+    inline void* bump(uint64_t sizeInBytes) {
+        const uint64_t numLines = sizeInBytes / kCacheLineSizeInBytes;
+        assert_release(usedLines_ + numLines <= storage_.size() && "Arena was sized too small for this config");
+        CacheLine* pLines = storage_.data() + usedLines_;
+        usedLines_ += numLines;
+        return pLines;
+    }
+
+    std::vector<CacheLine, HugePageAllocator<CacheLine>> storage_;
+    uint64_t usedLines_ = 0;
+};
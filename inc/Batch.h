@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Cache.h"
+#include "Multithreading.h"
+#include "Simulation.h"
+
+class Batch;
+
+// A trace of the suite & what is simulated over it
+struct BatchTrace {
+    std::string filename;
+    // Share of the suite the trace stands for, relative to the other traces
+    double weight;
+    std::shared_ptr<Trace> pTrace;
+    // Configs of the sweep with distinct results on this trace
+    std::unique_ptr<Simulation> pSimulation;
+    // Index in pSimulation of the config whose results each config of the sweep shares, indexed by config
+    std::vector<uint64_t> simulatedIndexOf;
+};
+
+/**
+ * Sweep of the ini run over a suite of traces in one invocation, a client of the library API of Simulation.h. The
+ * traces are parsed concurrently, at most one per worker & as many as fit in the memory budget at once, & the (trace x
+ * config) matrix runs on one worker pool, longest first among the configs that fit in what the traces leave of the
+ * budget. Every trace gets the results of a single-trace run, and every config a weighted mean of its CPI & miss rates
+ * over the suite
+ */
+class Batch {
+  public:
+    /**
+     * @brief           Enumerates the configs of the sweep, nothing is parsed yet
+     *
+     * @param params    Test parameters of the sweep
+     */
+    explicit Batch(const TestParamaters& params);
+    Batch(const Batch&) = delete;
+    Batch operator=(const Batch&) = delete;
+
+    /**
+     * @brief               Adds a trace to the suite
+     *
+     * @param pArgument     Trace file, optionally followed by @<weight>. The weight defaults to 1
+     * @return true         if the weight is valid
+     */
+    bool AddTrace(const char* pArgument);
+
+    /**
+     * @brief                   Parses the traces, simulates every config over each & prints the results
+     *
+     * @param pOutputFilename   Text output file. The results of trace i also go to <file>.trace<i>.csv, the weighted
+     * results of the suite to <file>.csv
+     * @return                  Exit status of the program
+     */
+    int Run(const char* pOutputFilename);
+
+#ifdef _MSC_VER
+    /**
+     * @brief           Parses the traces left to parse one after the other, once each fits in the memory budget
+     *
+     * @param pBatch    void pointer of the Batch
+     *
+     * @return          Status
+     */
+    static DWORD WINAPI LoadTraces(void* pBatch);
+#else
+    /**
+     * @brief           Parses the traces left to parse one after the other, once each fits in the memory budget
+     *
+     * @param pBatch    void pointer of the Batch
+     *
+     * @return          None
+     */
+    static void* LoadTraces(void* pBatch);
+#endif
+
+  private:
+    /**
+     * @brief           Parses a trace & finds the configs with distinct results on it
+     *
+     * @param trace     Trace of the suite, its trace & simulation are left null if it cannot be read
+     */
+    void loadTrace(BatchTrace& trace) const;
+
+    /**
+     * @brief               Prints the weighted results of every config over the suite, then the config with the
+     * lowest weighted CPI
+     *
+     * @param pTextStream   Text output stream
+     * @param pCSVStream    Comma separated value output stream, may be null
+     */
+    void printSuiteResults(FILE* pTextStream, FILE* pCSVStream) const;
+
+    TestParamaters params_;
+    // Configs of the sweep, in enumeration order
+    std::vector<ConfigDescriptor> descriptors_;
+    std::vector<BatchTrace> traces_;
+    // Parsing state of the suite. Guarded by loadLock_, loadCompleted_ is signaled when a trace is parsed
+    Lock_t loadLock_;
+    Condition_t loadCompleted_;
+    uint64_t nextTraceToLoad_ = 0;
+    uint64_t numLoadsInFlight_ = 0;
+    // Memory the traces may take up, & what the traces parsed & being parsed are charged with
+    uint64_t memoryBudget_ = 0;
+    uint64_t chargedBytes_ = 0;
+};
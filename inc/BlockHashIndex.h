@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Arena.h"
+
+// Up to this many ways a set is searched with MatchTags, above it lookups go through a BlockHashIndex
+constexpr uint64_t kMaxScannedAssociativity = 64;
+
+/**
+ * Maps the block address of every valid block of a cache to the way holding it. Open addressing with linear probing
+ * and backward shift deletion, kept at most half full so a lookup is O(1) no matter how many ways a set has. Block
+ * addresses identify their set, so one index serves the whole cache
+ */
+class BlockHashIndex {
+  public:
+    static constexpr uint32_t kNotFound = UINT32_MAX;
+
+    BlockHashIndex() = default;
+
+    /**
+     * @brief               Empties the index and sizes it for the given number of blocks
+     *
+     * @param numBlocks     Most valid blocks the index will ever hold
+     * @param arena         Arena to allocate the entries from
+     */
+    void Reset(uint64_t numBlocks, Arena& arena);
+
+    /**
+     * @brief Releases the memory of the index. The arena it came from is reset by its owner
+     */
+    void Clear();
+
+    /**
+     * @brief               Get the arena memory an index for the given number of blocks takes up
+     *
+     * @param numBlocks     Most valid blocks the index will ever hold
+     * @return              Size in bytes
+     */
+    static uint64_t GetArenaSize(uint64_t numBlocks);
+
+    /**
+     * @brief               Looks up the way holding a block
+     *
+     * @param blockAddress  Block address
+     * @return              Way within the block's set, kNotFound if the block is not valid in the cache
+     */
+    inline uint32_t Find(uint64_t blockAddress) const {
+        for (uint64_t i = hash(blockAddress);; i = (i + 1) & mask_) {
+            const Entry& entry = entries_[i];
+            if (entry.way == kNotFound || entry.blockAddress == blockAddress) {
+                return entry.way;
+            }
+        }
+    }
+
+    /**
+     * @brief               Adds a block that just became valid
+     *
+     * @param blockAddress  Block address, must not already be in the index
+     * @param way           Way within the block's set
+     */
+    void Insert(uint64_t blockAddress, uint32_t way);
+
+    /**
+     * @brief               Removes a block that just became invalid
+     *
+     * @param blockAddress  Block address, must be in the index
+     */
+    void Erase(uint64_t blockAddress);
+
+  private:
+    struct Entry {
+        uint64_t blockAddress;
+        uint32_t way; // kNotFound for an empty entry
+    };
+
+    /**
+     * @brief               Fibonacci hash of a block address onto the entries
+     *
+     * @param blockAddress  Block address
+     * @return              Home entry index
+     */
+    inline uint64_t hash(uint64_t blockAddress) const {
+        return (blockAddress * 0x9E3779B97F4A7C15ULL) >> shift_;
+    }
+
+    Entry* entries_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t shift_ = 64;
+};
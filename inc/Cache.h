@@ -1,44 +1,49 @@
 #pragma once
+#include "BlockHashIndex.h"
+#include "IntrusiveLRU.h"
+#include "LatencyHistogram.h"
 #include "Memory.h"
+#include "NextUseIndex.h"
+#include "PackedLRU.h"
+#include "TagMatch.h"
 #include "list.h"
 
-struct Block {
-    // The LSB of the blockAddress will be the
-    // setIndex, and would be redudant to store
-    uint64_t blockAddress = 0;
-    bool dirty = false;
-    bool valid = false;
-};
-
-struct Set {
-    std::vector<Block> ways;
-    std::vector<uint8_t> lruList;
-    bool busy = false;
+enum ReplacementPolicy {
+    kLRU,
+    kOPT, // Belady's MIN, needs the future of the trace. Only usable as a bound
+    kNumberOfReplacementPolicies,
 };
 
 struct Configuration {
     uint64_t cacheSize;
     uint64_t blockSize;
     uint64_t associativity;
+    ReplacementPolicy replacementPolicy = kLRU;
+    LevelTiming timing;
 
     Configuration() = default;
-    Configuration(uint64_t cacheSize, uint64_t blockSize, uint64_t associativity)
-        : cacheSize(cacheSize), blockSize(blockSize), associativity(associativity) {
+    Configuration(uint64_t cacheSize, uint64_t blockSize, uint64_t associativity, LevelTiming timing)
+        : cacheSize(cacheSize), blockSize(blockSize), associativity(associativity), timing(timing) {
     }
 };
 
+struct ConfigSummary;
+
 class Cache : public Memory {
   public:
+    // Hits are not resolved on issue while sim tracing, so the trace shows every request going through the queues. The
+    // coroutine engine runs every request as a coroutine
+    static constexpr bool kResolveHitsOnIssue = SIM_TRACE != 1 && !kUseCoroutineEngine;
+
     Cache() = delete;
     /**
-     * @brief                       Tries to initialize a cache structure
+     * @brief               Tries to initialize a single cache level, it is linked to its neighbours by its
+     * CacheHierarchy
      *
-     * @param pUpperCache           Pointer to cache object higher in cache hierarchy
-     * @param cacheLevel            Level of cache
-     * @param numberOfCacheLevels   Number of cache levels
-     * @param pConfigs              Array of structure containing all the config info needed per cache level
+     * @param cacheLevel    Level of cache
+     * @param config        Structure containing all the config info needed for this level
      */
-    Cache(Cache* pUpperCache, CacheLevel cacheLevel, uint8_t numberOfCacheLevels, Configuration* pConfigs);
+    Cache(CacheLevel cacheLevel, const Configuration& config);
 
     /**
      * @brief                       Checks whether a given cache config is valid, i.e. not redundant
@@ -49,34 +54,42 @@ class Cache : public Memory {
     static bool IsCacheConfigValid(Configuration config);
 
     /**
-     * @brief       Allocates memory needed for cache struture, recursively calls lower caches
+     * @brief       Allocates memory needed for cache struture
      *
+     * @param arena Arena to allocate from
      */
-    void AllocateMemory();
+    void AllocateMemory(Arena& arena);
 
     /**
-     * @brief           Sets the thread index/ID of the cache instances
+     * @brief                   Get the arena memory AllocateMemory takes up for a cache hierarchy, including the
+     * request manager of main memory. Works from the configs alone, so it can be called before building the caches
      *
-     * @param threadId  Thread ID to be set
+     * @param numCacheLevels    Number of cache levels in the hierarchy
+     * @param pCacheConfigs     Config of every level of the hierarchy
+     * @param mainMemoryTiming  Timing of the main memory of the hierarchy
+     * @return                  Size in bytes
      */
-    void SetThreadId(uint64_t threadId);
+    static uint64_t GetArenaSize(uint8_t numCacheLevels, const Configuration* pCacheConfigs,
+                                 const LevelTiming& mainMemoryTiming);
 
     /**
-     * @brief       Frees all memory allocated by cache structures, recursively calls all lower caches
+     * @brief                   Gives a kOPT cache the next-use index matching its block size
+     *
+     * @param nextUseIndices    Next-use indices built for every block size under test
      */
-    void FreeMemory();
+    void SetNextUseIndices(const std::vector<NextUseIndex>& nextUseIndices);
 
     /**
-     * @brief                       Simulate a clock cycle in the cache
-     * structure(s)
-     *
-     * @param cycle                 Current clock cycle
-     * @param pCompletedRequests    Out. An array of the request indices that were completed this tick. Length is the
-     * return value
+     * @brief           Copies the statistics & latency percentiles of this cache into a summary
      *
-     * @return                      Number of requests completed this tick
+     * @param summary   Out. Summary of the config this cache hierarchy simulated
      */
-    void ProcessCache(uint64_t pCycle, std::vector<int16_t>& pCompletedRequests);
+    void Summarize(ConfigSummary& summary) const;
+
+    /**
+     * @brief       Releases all memory allocated by this cache. The arena it came from is reset by its owner
+     */
+    void FreeMemory();
 
     /**
      * @brief   Get the Config object
@@ -88,17 +101,27 @@ class Cache : public Memory {
     }
 
     /**
-     * @brief   Get the Top Level Cache object
+     * @brief           Adds an access to L1, where accesses enter the hierarchy. A hit to a set no other outstanding
+     * request of this cache touches is handled right away, as nothing can change its outcome before its access time has
+     * passed. It still holds its request slot until then and completes in the same cycle as through the waiting list
      *
-     * @return  Cache* top level cache object
+     * @param access    Instruction struct, comprises an address and access type (R/W)
+     * @param cycle     Current clock cycle
+     *
+     * @return          The index of the added request, -1 if request add failed
      */
-    Cache* GetTopLevelCache() {
-        Memory* pUpperCache = GetUpperCache();
-        while (pUpperCache->GetUpperCache() != nullptr) {
-            pUpperCache = pUpperCache->GetUpperCache();
-        }
-        return static_cast<Cache*>(pUpperCache);
-    }
+    int16_t IssueAccessRequest(Instruction access, uint64_t cycle);
+
+    /**
+     * @brief                       Completes the requests IssueAccessRequest resolved whose access time has passed, and
+     * schedules the next wake up from them and the waiting list. Run on L1 once the hierarchy has been processed for the
+     * cycle. Only one access is issued per cycle, so these never complete in the same cycle as a request from the
+     * waiting list
+     *
+     * @param cycle                 Current clock cycle
+     * @param completedRequests     Out. Vector of the request indices that were completed this tick
+     */
+    void CompleteResolvedRequests(uint64_t cycle, std::vector<int16_t>& completedRequests);
 
     /**
      * @brief           Marks a set as no longer busy
@@ -108,15 +131,28 @@ class Cache : public Memory {
     void ResetCacheSetBusy(uint64_t setIndex);
 
     /**
-     * @brief                       Simulates a single clock cycle in a single cache level
+     * @brief                       Simulates a single clock cycle in a single cache level. The level below must have
+     * been processed this cycle already
      *
      * @param cycle                 Current clock cycle
-     * @param completedRequests     Out. Vector of the request indices that were completed this tick.
+     * @param completedRequests     Out. Vector of the request indices that were completed this tick, only added to
+     * by L1
      *
      * @return                      None
      */
     void InternalProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests);
 
+    /**
+     * @brief                       Simulates a single clock cycle in a single cache level with the coroutine engine.
+     * Resumes the busy requests a fill or work done below may have unblocked, then the waiting requests whose access
+     * time has passed. The level below must have been processed this cycle already
+     *
+     * @param cycle                 Current clock cycle
+     * @param completedRequests     Out. Vector of the request indices that were completed this tick, only added to
+     * by L1
+     */
+    void ResumeRequests(uint64_t cycle, std::vector<int16_t>& completedRequests);
+
     /**
      *  @brief Translates a raw address to a set index
      *
@@ -126,6 +162,72 @@ class Cache : public Memory {
     inline uint64_t addressToSetIndex(uint64_t pAddress) const;
 
   private:
+    // Starts the coroutines of the requests added to every level
+    friend class Memory;
+
+    /**
+     * @brief               Get the arena memory AllocateMemory takes up for a single cache level
+     *
+     * @param config        Config of the cache
+     * @return              Size in bytes
+     */
+    static uint64_t getLevelArenaSize(const Configuration& config);
+
+    // Template argument of the hot path functions meaning "not specialized, read config_.associativity"
+    static constexpr uint64_t kGenericAssociativity = 0;
+
+    /**
+     * @brief           Marks a set as busy until the block it missed on arrives, parking its busy requests
+     *
+     * @param setIndex  Set to mark as busy, must not be busy
+     */
+    inline void setCacheSetBusy(uint64_t setIndex);
+
+    /**
+     * @brief           Moves a request from the waiting requests list to the tail of the busy requests list
+     *
+     * @param poolIndex Pool index of request to move
+     */
+    void moveRequestToBusyList(uint64_t poolIndex);
+
+    /**
+     * @brief           Retires a request from the busy requests list to the free requests list
+     *
+     * @param poolIndex Pool index of request to retire
+     */
+    void retireBusyRequest(uint64_t poolIndex);
+
+    /**
+     * @brief           Adds a request that is in no list to the tail of the busy requests list
+     *
+     * @param poolIndex Pool index of request to park
+     */
+    void parkRequest(uint64_t poolIndex);
+
+    /**
+     * @brief           Takes a request that hit out of the busy requests list
+     *
+     * @param poolIndex Pool index of request to unpark
+     */
+    void unparkRequest(uint64_t poolIndex);
+
+    /**
+     * @brief                       Hands the block of a request that hit to the level above, i.e. wakes its set there,
+     * or reports the request as completed from L1
+     *
+     * @param poolIndex             Pool index of the request
+     * @param completedRequests     Out. Vector of the request indices that were completed this tick
+     */
+    void completeRequest(uint64_t poolIndex, std::vector<int16_t>& completedRequests);
+
+    /**
+     * @brief           Coroutine of a cache request. Waits out the access time, then retries from the busy requests
+     * list until it hits, each time its set's fill lands or the level below does work
+     *
+     * @param poolIndex Pool index of the request
+     */
+    RequestCoroutine runRequest(uint64_t poolIndex);
+
     /**
      *  @brief Translates raw address to block address
      *
@@ -142,13 +244,129 @@ class Cache : public Memory {
      */
     inline uint64_t blockAddressToSetIndex(uint64_t blockAddress) const;
 
+    /**
+     * @brief               Get the associativity, a compile-time constant in the specialized hot paths
+     *
+     * @tparam kAssociativity   Specialized associativity, kGenericAssociativity to read it from config_
+     * @return              Number of ways per set
+     */
+    template <uint64_t kAssociativity>
+    inline uint64_t getAssociativity() const {
+        if constexpr (kAssociativity == kGenericAssociativity) {
+            return config_.associativity;
+        } else {
+            return kAssociativity;
+        }
+    }
+
+    /**
+     * @brief               Get the number of valid/dirty mask words per set
+     *
+     * @tparam kAssociativity   Specialized associativity, kGenericAssociativity to read it from maskWordsPerSet_
+     * @return              Number of uint64_t mask words per set
+     */
+    template <uint64_t kAssociativity>
+    inline uint64_t getMaskWordsPerSet() const {
+        if constexpr (kAssociativity != kGenericAssociativity && kAssociativity <= 64) {
+            return 1;
+        } else {
+            return maskWordsPerSet_;
+        }
+    }
+
+    /**
+     * @brief               Get the tags of the ways of the given set
+     *
+     * @param setIndex      Set index
+     * @return              Pointer to associativity consecutive tags
+     */
+    template <uint64_t kAssociativity = kGenericAssociativity>
+    inline uint64_t* getSetTags(uint64_t setIndex) const {
+        return tags_ + setIndex * getAssociativity<kAssociativity>();
+    }
+
+    /**
+     * @brief               Get the LRU list nodes of the given set. Only used above kMaxPackedLRUAssociativity ways
+     *
+     * @param setIndex      Set index
+     * @return              Pointer to associativity consecutive nodes
+     */
+    template <uint64_t kAssociativity = kGenericAssociativity>
+    inline IntrusiveLRUNode* getLRUNodes(uint64_t setIndex) const {
+        return lruNodes_ + setIndex * getAssociativity<kAssociativity>();
+    }
+
+    /**
+     * @brief               Tests the bit of a block in one of the per-set bit masks
+     *
+     * @param pMasks        validMasks_ or dirtyMasks_
+     * @param setIndex      Set index
+     * @param blockIndex    Block index within the set
+     * @return true         if the bit is set
+     */
+    template <uint64_t kAssociativity = kGenericAssociativity>
+    inline bool testBlockBit(const uint64_t* pMasks, uint64_t setIndex, uint64_t blockIndex) const {
+        return (pMasks[setIndex * getMaskWordsPerSet<kAssociativity>() + (blockIndex >> 6)] >> (blockIndex & 63)) & 1;
+    }
+
+    /**
+     * @brief               Sets or clears the bit of a block in one of the per-set bit masks
+     *
+     * @param pMasks        validMasks_ or dirtyMasks_
+     * @param setIndex      Set index
+     * @param blockIndex    Block index within the set
+     * @param value         Value of the bit
+     */
+    template <uint64_t kAssociativity = kGenericAssociativity>
+    inline void writeBlockBit(uint64_t* pMasks, uint64_t setIndex, uint64_t blockIndex, bool value) {
+        uint64_t& word = pMasks[setIndex * getMaskWordsPerSet<kAssociativity>() + (blockIndex >> 6)];
+        const uint64_t bit = 1ULL << (blockIndex & 63);
+        word = value ? (word | bit) : (word & ~bit);
+    }
+
+    /**
+     * @brief               Get the least recently used block of the given set
+     *
+     * @param setIndex      Set index
+     * @return              Block index
+     */
+    template <uint64_t kAssociativity = kGenericAssociativity>
+    inline uint32_t getLRUBlockIndex(uint64_t setIndex) const {
+        const uint64_t associativity = getAssociativity<kAssociativity>();
+        if (associativity == 1) {
+            return 0;
+        }
+        if (associativity <= kMaxPackedLRUAssociativity) {
+            return PackedLRUAt(packedLRUs_[setIndex], associativity - 1);
+        }
+        return lruEnds_[setIndex].lru;
+    }
+
     /**
      * @brief               Reorder the LRU list for the given set
      *
      * @param setIndex      Set whose LRU list is to be reordered
      * @param mruIndex      Block index that is now the most recently used
      */
-    void updateLRUList(uint64_t setIndex, uint8_t mruIndex);
+    template <uint64_t kAssociativity>
+    void updateLRUList(uint64_t setIndex, uint32_t mruIndex);
+
+    /**
+     * @brief               Picks the block to be replaced in the given set according to the replacement policy
+     *
+     * @param setIndex      Set from which a block needs to be replaced
+     * @return              Block index within the set
+     */
+    template <uint64_t kAssociativity>
+    uint32_t selectVictim(uint64_t setIndex) const;
+
+    /**
+     * @brief               Looks up when the block touched by the given access will next be used
+     *
+     * @param access        Access touching the block
+     * @return              Data access index of the next use, NextUseIndex::kNoNextUse if unknown or never
+     */
+    uint32_t lookUpNextUse(const Instruction& access) const;
 
     /**
      * @brief               Handles the eviction and subsequent interactions
@@ -158,7 +376,8 @@ class Cache : public Memory {
      * @return              Block index within the provided set that the new
      * block occupies, -1 if evict request failed
      */
-    int16_t evictBlock(uint64_t setIndex);
+    template <uint64_t kAssociativity>
+    int64_t evictBlock(uint64_t setIndex);
 
     /**
      * @brief               Searches the given set for the given block address
@@ -168,7 +387,8 @@ class Cache : public Memory {
      * @param pBlockIndex   Output: The block index within the set iff found
      * @return true         if the block is found in the set
      */
-    bool findBlockInSet(uint64_t setIndex, uint64_t blockAddress, uint8_t& pBlockIndex);
+    template <uint64_t kAssociativity>
+    bool findBlockInSet(uint64_t setIndex, uint64_t blockAddress, uint32_t& pBlockIndex);
 
     /**
      * @brief               Acquires the given block address into the given set. Makes any subsequent calls necessary to
@@ -176,18 +396,66 @@ class Cache : public Memory {
      *
      * @param setIndex      Set in which to put new block
      * @param blockAddress  Block address of block to acquire
+     * @param access        Access that missed, passed on so the lower cache knows where in the trace it came from
      * @return              Block index acquired within set, -1 if request failed
      */
-    int16_t requestBlock(uint64_t setIndex, uint64_t blockAddress);
+    template <uint64_t kAssociativity>
+    int64_t requestBlock(uint64_t setIndex, uint64_t blockAddress, const Instruction& access);
 
     /**
      * @brief           Attempts a read or write to the given cache
      *
+     * @tparam kAssociativity   Associativity the hot path is specialized on, kGenericAssociativity for any
      * @param pRequest  Request structure to attempt
      * @return true     If the request was completed and need not be called again
      */
+    template <uint64_t kAssociativity>
     Status handleAccess(Request& pRequest);
 
+    /**
+     * @brief                   Updates the stats, dirty bit & next use of a block an access hit on
+     *
+     * @tparam kAssociativity   Associativity the hot path is specialized on, kGenericAssociativity for any
+     * @param access            Access that hit
+     * @param setIndex          Set of the block
+     * @param blockIndex        Index of the block within its set
+     * @param isFirstAttempt    Whether this is the first time the access was attempted, only then it is counted
+     */
+    template <uint64_t kAssociativity>
+    inline void accountHit(const Instruction& access, uint64_t setIndex, uint32_t blockIndex, bool isFirstAttempt);
+
+    /**
+     * @brief                   Handles an access on issue if it hits, leaves the cache untouched if it misses
+     *
+     * @tparam kAssociativity   Associativity the hot path is specialized on, kGenericAssociativity for any
+     * @param access            Access to look up
+     * @param setIndex          Set of the access, must not be busy
+     * @return true             If the access hit and was accounted
+     */
+    template <uint64_t kAssociativity>
+    bool resolveHit(const Instruction& access, uint64_t setIndex);
+
+    /**
+     * @brief           Check whether a request in the waiting requests list maps to a set
+     *
+     * @param setIndex  Set to look for
+     * @return true     If a waiting request maps to the set
+     */
+    bool isSetWaitedOn(uint64_t setIndex);
+
+    typedef Status (Cache::*HandleAccessFunction_t)(Request&);
+    typedef bool (Cache::*ResolveHitFunction_t)(const Instruction&, uint64_t);
+
+    // handleAccess specialized on associativities 1, 2, 4, 8 and 16, indexed by log2(associativity)
+    static constexpr uint64_t kNumberOfSpecializedAssociativities = 5;
+    static const HandleAccessFunction_t kSpecializedHandleAccessFunctions[kNumberOfSpecializedAssociativities];
+    static const ResolveHitFunction_t kSpecializedResolveHitFunctions[kNumberOfSpecializedAssociativities];
+
+    // Chosen from kSpecializedHandleAccessFunctions at construction, handleAccess<kGenericAssociativity> otherwise
+    HandleAccessFunction_t pHandleAccess_;
+    // Chosen from kSpecializedResolveHitFunctions the same way
+    ResolveHitFunction_t pResolveHit_;
+
     // Cache sizing fields
     Configuration config_;
     uint64_t numSets_;
@@ -196,8 +464,29 @@ class Cache : public Memory {
     uint64_t blockSizeBits_;
     uint64_t blockAddressToSetIndexMask_;
 
-    // Data
-    std::vector<Set> sets_;
+    // Only set under kOPT
+    const NextUseIndex* pNextUseIndex_ = nullptr;
+
+    // Data, structure of arrays all allocated from an arena. Each array is indexed by set, or by set * associativity +
+    // way, with bit masks indexed by set * maskWordsPerSet_ + way / 64. The LSB of the block address will be the set
+    // index, and would be redudant to store, but it keeps tags and block addresses interchangeable
+    uint64_t* tags_;
+    uint64_t* validMasks_;
+    uint64_t* dirtyMasks_;
+    PackedLRU_t* packedLRUs_;    // Up to kMaxPackedLRUAssociativity ways
+    IntrusiveLRUNode* lruNodes_; // Above kMaxPackedLRUAssociativity ways
+    IntrusiveLRUEnds* lruEnds_;  // Above kMaxPackedLRUAssociativity ways
+    bool* busySets_;
+    uint16_t* busyRequestsPerSet_; // Requests of each set parked in the busy requests list
+    // Requests in the busy requests list whose set is not busy. The others can only go on once their set is woken by
+    // ResetCacheSetBusy, so the busy list is only retried while this is nonzero
+    uint64_t wakeableBusyRequests_ = 0;
+    std::vector<int16_t>* pCompletedRequests_ = nullptr; // Of the cycle being resumed, for the coroutine engine
+    uint32_t* nextUses_; // Only allocated under kOPT
+    uint64_t maskWordsPerSet_;
+    BlockHashIndex blockHashIndex_; // Only filled above kMaxScannedAssociativity ways
+    // Cycles from issue to completion of every request this level served, set conflict retries included
+    LatencyHistogram latencies_;
 };
 
 struct TestParamaters {
@@ -206,9 +495,33 @@ struct TestParamaters {
     uint64_t maxBlockSize[kMaxNumberOfCacheLevels];
     uint64_t minCacheSize[kMaxNumberOfCacheLevels];
     uint64_t maxCacheSize[kMaxNumberOfCacheLevels];
-    uint8_t minBlocksPerSet[kMaxNumberOfCacheLevels];
-    uint8_t maxBlocksPerSet[kMaxNumberOfCacheLevels];
+    uint64_t minBlocksPerSet[kMaxNumberOfCacheLevels];
+    uint64_t maxBlocksPerSet[kMaxNumberOfCacheLevels];
+    // Indexed by CacheLevel, main memory included
+    uint64_t minAccessTimeInCycles[kMaxNumberOfCacheLevels + 1];
+    uint64_t maxAccessTimeInCycles[kMaxNumberOfCacheLevels + 1];
+    uint64_t minOutstandingRequests[kMaxNumberOfCacheLevels + 1];
+    uint64_t maxOutstandingRequests[kMaxNumberOfCacheLevels + 1];
     int64_t maxNumberOfThreads;
+    // Memory the configs running at once may take up, 0 to derive it from the memory available to the process
+    uint64_t memoryBudgetInMegabytes;
+    ReplacementPolicy replacementPolicy;
+    // Every config is also simulated under kOPT to measure the gap to optimal replacement
+    bool compareToOptimal;
+};
+
+// A config of the sweep, the caches are only built from it when the config is simulated
+struct ConfigDescriptor {
+    Configuration configs[kMaxNumberOfCacheLevels];
+    LevelTiming mainMemoryTiming;
+    uint8_t numberOfCacheLevels;
+};
+
+// All that is kept of a config once it has been simulated
+struct ConfigSummary {
+    Statistics stats[kMaxNumberOfCacheLevels];
+    LatencySummary latencies[kMaxNumberOfCacheLevels];
+    uint64_t cycles;
 };
 
 inline uint64_t Cache::addressToBlockAddress(uint64_t address) const {
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "Arena.h"
+#include "Cache.h"
+#include "GlobalIncludes.h"
+#include "Memory.h"
+#include "NextUseIndex.h"
+
+/**
+ * The caches of a hierarchy and its main memory, held contiguously in one object with L1 first. The depth is a
+ * template parameter, so the per-cycle sweep over the levels is a fixed-length loop the compiler unrolls instead of a
+ * recursion through the links between levels. The levels point at each other, so a hierarchy never moves
+ *
+ * @tparam kNumCacheLevels  Number of cache levels above main memory
+ */
+template <uint8_t kNumCacheLevels>
+class CacheHierarchy {
+    static_assert(kNumCacheLevels >= 1 && kNumCacheLevels <= kMaxNumberOfCacheLevels, "Unsupported number of levels");
+
+  public:
+    CacheHierarchy() = delete;
+    CacheHierarchy(const CacheHierarchy&) = delete;
+    CacheHierarchy operator=(const CacheHierarchy&) = delete;
+
+    /**
+     * @brief                   Builds the caches of a hierarchy and links them up
+     *
+     * @param pConfigs          Config of every cache level, L1 first
+     * @param mainMemoryTiming  Timing of main memory
+     */
+    CacheHierarchy(const Configuration* pConfigs, const LevelTiming& mainMemoryTiming)
+        : CacheHierarchy(pConfigs, mainMemoryTiming, std::make_index_sequence<kNumCacheLevels>()) {
+    }
+
+    /**
+     * @brief           Sets the thread index/ID of every level
+     *
+     * @param threadId  Thread ID to be set
+     */
+    void SetThreadId(uint64_t threadId) {
+        for (Cache& cache : caches_) {
+            cache.threadId_ = threadId;
+        }
+        mainMemory_.threadId_ = threadId;
+    }
+
+    /**
+     * @brief               Sets the sim trace every level records to. Ignored unless built with SIM_TRACE
+     *
+     * @param pSimTracer    Sim trace of the run, null if it is not traced
+     */
+    void SetSimTracer([[maybe_unused]] SimTracer* pSimTracer) {
+#if (SIM_TRACE == 1)
+        for (Cache& cache : caches_) {
+            cache.pSimTracer_ = pSimTracer;
+        }
+        mainMemory_.pSimTracer_ = pSimTracer;
+#endif
+    }
+
+    /**
+     * @brief                   Gives each kOPT cache the next-use index matching its block size
+     *
+     * @param nextUseIndices    Next-use indices built for every block size under test
+     */
+    void SetNextUseIndices(const std::vector<NextUseIndex>& nextUseIndices) {
+        for (Cache& cache : caches_) {
+            cache.SetNextUseIndices(nextUseIndices);
+        }
+    }
+
+    /**
+     * @brief       Allocates the memory of every level
+     *
+     * @param arena Arena to allocate from, must have at least Cache::GetArenaSize() bytes free
+     */
+    void AllocateMemory(Arena& arena) {
+        for (Cache& cache : caches_) {
+            cache.AllocateMemory(arena);
+        }
+        mainMemory_.AllocateMemory(arena);
+    }
+
+    /**
+     * @brief Releases the memory of every level. The arena it came from is reset by its owner
+     */
+    void FreeMemory() {
+        for (Cache& cache : caches_) {
+            cache.FreeMemory();
+        }
+        mainMemory_.FreeMemory();
+    }
+
+    /**
+     * @brief           Copies the statistics of every cache into a summary
+     *
+     * @param summary   Out. Summary of the config this hierarchy simulated
+     */
+    void Summarize(ConfigSummary& summary) const {
+        for (const Cache& cache : caches_) {
+            cache.Summarize(summary);
+        }
+    }
+
+    /**
+     * @brief                       Simulates a clock cycle in every level, main memory first
+     *
+     * @param cycle                 Current clock cycle
+     * @param completedRequests     Out. Vector of the L1 request indices that were completed this tick
+     */
+    inline void ProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests) {
+        if (Cache::kResolveHitsOnIssue && !hasQueuedRequests()) {
+            // Only hits resolved on issue are in flight. A sweep would find no work at any level
+            for (Cache& cache : caches_) {
+                cache.SetWasWorkDoneThisCycle(false);
+            }
+            mainMemory_.SetWasWorkDoneThisCycle(false);
+            caches_[kL1].CompleteResolvedRequests(cycle, completedRequests);
+            return;
+        }
+        if constexpr (kUseCoroutineEngine) {
+            mainMemory_.ResumeRequests(cycle);
+            for (uint8_t cacheLevel = kNumCacheLevels; cacheLevel-- > 0;) {
+                caches_[cacheLevel].ResumeRequests(cycle, completedRequests);
+            }
+        } else {
+            mainMemory_.InternalProcessCache(cycle);
+            for (uint8_t cacheLevel = kNumCacheLevels; cacheLevel-- > 0;) {
+                caches_[cacheLevel].InternalProcessCache(cycle, completedRequests);
+            }
+        }
+        caches_[kL1].CompleteResolvedRequests(cycle, completedRequests);
+        // Once the sweep is done every level reports whether the level below it did work, which is what its upper
+        // level and the main loop look at. Top down, so every level still holds its own flag when it is read
+        for (uint8_t cacheLevel = 0; cacheLevel < kNumCacheLevels - 1; cacheLevel++) {
+            caches_[cacheLevel].SetWasWorkDoneThisCycle(caches_[cacheLevel + 1].GetWasWorkDoneThisCycle());
+        }
+        caches_[kNumCacheLevels - 1].SetWasWorkDoneThisCycle(mainMemory_.GetWasWorkDoneThisCycle());
+    }
+
+    /**
+     * @brief Get the Earliest Next Useful Cycle of any level
+     *
+     * @return uint64_t the cycle wherein the next useful piece of work can be done
+     */
+    inline uint64_t CalculateEarliestNextUsefulCycle() const {
+        uint64_t earliestNextUsefulCycle = mainMemory_.GetEarliestNextUsefulCycle();
+        for (const Cache& cache : caches_) {
+            if (cache.GetEarliestNextUsefulCycle() < earliestNextUsefulCycle) {
+                earliestNextUsefulCycle = cache.GetEarliestNextUsefulCycle();
+            }
+        }
+        return earliestNextUsefulCycle;
+    }
+
+    /**
+     * @brief Get the Top Level Cache object, where accesses enter the hierarchy
+     *
+     * @return Cache& L1
+     */
+    inline Cache& GetTopLevelCache() {
+        return caches_[kL1];
+    }
+
+  private:
+    /**
+     * @brief   Check whether any level has requests in its waiting or busy lists
+     *
+     * @return  true if a sweep has work to look at
+     */
+    inline bool hasQueuedRequests() const {
+        bool hasQueuedRequests = mainMemory_.HasQueuedRequests();
+        for (const Cache& cache : caches_) {
+            hasQueuedRequests |= cache.HasQueuedRequests();
+        }
+        return hasQueuedRequests;
+    }
+
+    template <size_t... kCacheLevels>
+    CacheHierarchy(const Configuration* pConfigs, const LevelTiming& mainMemoryTiming,
+                   std::index_sequence<kCacheLevels...>)
+        : caches_{Cache(static_cast<CacheLevel>(kCacheLevels), pConfigs[kCacheLevels])...},
+          mainMemory_(kMainMemory, mainMemoryTiming) {
+        for (uint8_t cacheLevel = 0; cacheLevel < kNumCacheLevels; cacheLevel++) {
+            Memory* pUpperCache = cacheLevel > 0 ? &caches_[cacheLevel - 1] : nullptr;
+            Memory* pLowerCache = cacheLevel < kNumCacheLevels - 1 ? &caches_[cacheLevel + 1] : &mainMemory_;
+            caches_[cacheLevel].SetAdjacentLevels(pUpperCache, pLowerCache);
+        }
+        mainMemory_.SetAdjacentLevels(&caches_[kNumCacheLevels - 1], nullptr);
+    }
+
+    Cache caches_[kNumCacheLevels];
+    Memory mainMemory_;
+};
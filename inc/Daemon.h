@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Cache.h"
+#include "Multithreading.h"
+#include "Simulation.h"
+
+class Daemon;
+
+// A client connected to the daemon, served by a thread of its own
+struct DaemonConnection {
+    Daemon* pDaemon;
+    int socket;
+    Thread_t thread;
+    // Set once the thread is done & the socket closed. Guarded by the daemon lock
+    bool isDone;
+};
+
+/**
+ * Long-running simulator serving jobs over a Unix domain socket, a client of the library API of Simulation.h. Traces
+ * are parsed once and stay resident, and a fixed pool of workers runs the configs of every job, so a job costs only its
+ * own simulation. One request per line:
+ *
+ *   LOAD <trace file>              -> TRACE <trace id> <number of instructions>
+ *   JOB <trace id> <LRU|OPT|BOTH>  followed by one config per line, then END
+ *                                  -> ACCEPTED <job id> <number of results>
+ *                                     RESULT <result index> <row of the csv of ./cache>, as each config completes
+ *                                     DONE <job id>
+ *   SHUTDOWN                       -> BYE, the daemon exits once the jobs running are done
+ *
+ * A config is L<n>_CACHE_SIZE=, L<n>_BLOCK_SIZE= & L<n>_ASSOCIATIVITY= for every level, optionally L<n>_ACCESS_TIME=,
+ * L<n>_QUEUE_DEPTH=, MEMORY_ACCESS_TIME= & MEMORY_QUEUE_DEPTH=, separated by spaces. OPT applies to L1, the levels
+ * below use LRU. Under BOTH, result 2i is config i under LRU & result 2i+1 under OPT. A request that fails is answered
+ * with ERROR <reason>. Only on Linux
+ */
+class Daemon {
+  public:
+    /**
+     * @brief               Starts the worker pool
+     *
+     * @param numWorkers    Number of workers
+     */
+    explicit Daemon(uint64_t numWorkers);
+    Daemon(const Daemon&) = delete;
+    Daemon operator=(const Daemon&) = delete;
+
+    /**
+     * @brief               Serves clients on a socket until one of them asks for a shutdown
+     *
+     * @param pSocketPath   Path to create the socket at, removed on exit
+     * @return              Exit status of the program
+     */
+    int Run(const char* pSocketPath);
+
+#ifdef _MSC_VER
+    /**
+     * @brief                   Reads the requests of a client & answers them, until it disconnects
+     *
+     * @param pConnection       void pointer of a DaemonConnection
+     *
+     * @return                  Status
+     */
+    static DWORD WINAPI ServeConnection(void* pConnection);
+#else
+    /**
+     * @brief                   Reads the requests of a client & answers them, until it disconnects
+     *
+     * @param pConnection       void pointer of a DaemonConnection
+     *
+     * @return                  None
+     */
+    static void* ServeConnection(void* pConnection);
+#endif
+
+  private:
+    /**
+     * @brief               Parses a trace into memory unless it already is
+     *
+     * @param pFilename     Trace file
+     * @param traceId       Out. Id of the trace
+     * @return true         if the trace could be read
+     */
+    bool loadTrace(const char* pFilename, uint64_t& traceId);
+
+    /**
+     * @brief               Parses a config of a job request
+     *
+     * @param pLine         Config line, tokenized in place
+     * @param descriptor    Out. Config, its replacement policy aside
+     * @param pError        Out. Reason the config is invalid
+     * @param errorSize     Size of pError
+     * @return true         if the config is valid
+     */
+    static bool parseConfig(char* pLine, ConfigDescriptor& descriptor, char* pError, size_t errorSize);
+
+    /**
+     * @brief               Reads the configs of a job request, runs them on the pool & streams back the results
+     *
+     * @param pRequest      JOB line of the request
+     * @param pInStream     Stream the configs are read from
+     * @param pOutStream    Stream the answers are written to
+     */
+    void runJob(const char* pRequest, FILE* pInStream, FILE* pOutStream);
+
+    WorkerPool pool_;
+    // Guards the job ids & the connections
+    Lock_t lock_;
+    uint64_t nextJobId_;
+    std::vector<std::unique_ptr<DaemonConnection>> connections_;
+    // Set by a SHUTDOWN request, stops accepting clients
+    std::atomic<bool> isStopping_;
+    int listenSocket_;
+    // Guards the resident traces. Indexed by trace id
+    Lock_t tracesLock_;
+    std::vector<std::shared_ptr<Trace>> traces_;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <stdio.h>
+#include <type_traits>
+#include <unordered_map>
+
+#include "Multithreading.h"
+
+constexpr uint64_t kHugePageSizeInBytes = 2 * 1024 * 1024;
+
+// Backing a large buffer got
+enum HugePageBacking {
+    kHugetlbfs,
+    kTransparentHugePages,
+    kHeap,
+    kNumberOfHugePageBackings,
+};
+
+/**
+ * Memory of the large buffers with each backing, live & at its peak. A buffer counts from its allocation to its free,
+ * so a vector that regrew only counts the buffer it holds now. Owned by whoever reports it, e.g. a sweep of ./cache,
+ * so that nothing is counted process-wide
+ */
+class HugePageUsage {
+  public:
+    HugePageUsage();
+    HugePageUsage(const HugePageUsage&) = delete;
+    HugePageUsage& operator=(const HugePageUsage&) = delete;
+
+    /**
+     * @brief               Counts a buffer allocated
+     *
+     * @param pBuffer       Buffer
+     * @param sizeInBytes   Size of the buffer as allocated
+     * @param backing       Backing it got
+     */
+    void RecordAllocation(const void* pBuffer, uint64_t sizeInBytes, HugePageBacking backing);
+
+    /**
+     * @brief               Stops counting a buffer, once freed
+     *
+     * @param pBuffer       Buffer
+     * @param sizeInBytes   Size of the buffer as allocated
+     */
+    void RecordFree(const void* pBuffer, uint64_t sizeInBytes);
+
+    /**
+     * @brief           Prints the peak memory of the large buffers with each backing, and how much memory the kernel
+     * actually backs with transparent huge pages
+     *
+     * @param stream    Output stream to print to
+     */
+    void PrintSummary(FILE* stream);
+
+  private:
+    // Guards all of the below
+    Lock_t lock_;
+    // Backing of the buffers of at least a huge page, which may have any backing. Smaller ones come from the heap
+    std::unordered_map<const void*, HugePageBacking> largeBufferBackings_;
+    uint64_t liveBytes_[kNumberOfHugePageBackings] = {};
+    uint64_t peakBytes_[kNumberOfHugePageBackings] = {};
+};
+
+/**
+ * Backing for the large, poorly localized buffers (trace arrays, next-use indices, arenas holding the tag stores).
+ * Buffers of at least one huge page are mapped with explicit huge pages from hugetlbfs if the pool has enough free
+ * pages, otherwise with regular pages advised for transparent huge pages, never from the heap. Smaller buffers, and
+ * every buffer on platforms without either, come from the heap. Every buffer is at least cache line aligned
+ */
+namespace HugePages {
+    /**
+     * @brief               Allocates a buffer
+     *
+     * @param sizeInBytes   Size of the buffer
+     * @param pUsage        Usage to count the buffer in, null to count it nowhere
+     * @return              The buffer. Throws std::bad_alloc if a buffer of at least a huge page cannot be mapped
+     */
+    void* Allocate(uint64_t sizeInBytes, HugePageUsage* pUsage);
+
+    /**
+     * @brief               Frees a buffer
+     *
+     * @param pBuffer       Buffer from Allocate
+     * @param sizeInBytes   Size it was allocated with
+     * @param pUsage        Usage it was counted in
+     */
+    void Free(void* pBuffer, uint64_t sizeInBytes, HugePageUsage* pUsage);
+}
+
+/**
+ * std::allocator drop-in that allocates from HugePages, for std::vectors of large buffers. It goes with the buffer it
+ * allocated when containers are assigned or swapped, so a buffer is counted off the usage it was counted in
+ */
+template <typename T>
+struct HugePageAllocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    HugePageAllocator() = default;
+    explicit HugePageAllocator(HugePageUsage* pUsage) : pUsage(pUsage) {
+    }
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other) : pUsage(other.pUsage) {
+    }
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(HugePages::Allocate(count * sizeof(T), pUsage));
+    }
+
+    void deallocate(T* pObjects, size_t count) {
+        HugePages::Free(pObjects, count * sizeof(T), pUsage);
+    }
+
+    template <typename U>
+    bool operator==(const HugePageAllocator<U>& other) const {
+        return pUsage == other.pUsage;
+    }
+
+    // Usage the buffers are counted in, null if they are not counted
+    HugePageUsage* pUsage = nullptr;
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <float.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
@@ -27,40 +28,150 @@ constexpr uint64_t kFileLineLengthInBytes = kPaddingLengthInBytes + kAddressLeng
                                             kRwLengthInBytes + kPaddingAfterRwLengthInBytes + kAddressLengthInBytes +
                                             sizeof('\n');
 
+// Names of the replacement policies in the ini, the outputs & the daemon protocol, & of running under both
+extern const char* kReplacementPolicyNames[kNumberOfReplacementPolicies];
+extern const char kCompareToOptimalName[];
+
+// Results of the configs one shard of a sweep was assigned, as written by a shard & read back by cache-merge
+struct PartialResults {
+    uint64_t shardIndex;
+    uint64_t numShards;
+    uint64_t numConfigs; // In the whole sweep
+    bool compareToOptimal;
+    // Of the trace file & the configs, so that only shards of the same sweep are merged
+    uint64_t sweepFingerprint;
+    // Same order in all three
+    std::vector<uint64_t> configIndices;
+    std::vector<ConfigDescriptor> descriptors;
+    std::vector<ConfigSummary> summaries;
+};
+
+// Config with the lowest CPI among the results printed so far
+struct LowestCpi {
+    float cpi = FLT_MAX;
+    uint64_t configIndex = 0;
+};
+
 class IOUtilities {
   public:
     /**
-     * @brief           Prints collected statistics to given stream
+     * @brief                   Prints the statistics of every config of a sweep, then the config with the lowest CPI
+     *
+     * @param descriptors       Every config, in enumeration order
+     * @param summaries         Results of every config
+     * @param compareToOptimal  Whether every odd config is the kOPT twin of the one before it
+     * @param pTextStream       Text output stream
+     * @param pCSVStream        Comma separated value output stream, may be null
+     */
+    static void PrintResults(const std::vector<ConfigDescriptor>& descriptors,
+                             const std::vector<ConfigSummary>& summaries, bool compareToOptimal, FILE* pTextStream,
+                             FILE* pCSVStream);
+
+    /**
+     * @brief                   Prints the statistics of one config of a sweep. Configs are printed in enumeration
+     * order, the kOPT twin of a config right after it
+     *
+     * @param descriptors       Every config, in enumeration order
+     * @param summaries         Results of every config, those up to configIndex at least
+     * @param compareToOptimal  Whether every odd config is the kOPT twin of the one before it
+     * @param configIndex       Config to print
+     * @param lowestCpi         Config with the lowest CPI so far, updated
+     * @param pTextStream       Text output stream
+     * @param pCSVStream        Comma separated value output stream, may be null
+     */
+    static void PrintResult(const std::vector<ConfigDescriptor>& descriptors,
+                            const std::vector<ConfigSummary>& summaries, bool compareToOptimal, uint64_t configIndex,
+                            LowestCpi& lowestCpi, FILE* pTextStream, FILE* pCSVStream);
+
+    /**
+     * @brief               Prints the config with the lowest CPI, once every config was printed
+     *
+     * @param descriptors   Every config, in enumeration order
+     * @param lowestCpi     Config with the lowest CPI
+     * @param pTextStream   Text output stream
+     */
+    static void PrintLowestCpi(const std::vector<ConfigDescriptor>& descriptors, const LowestCpi& lowestCpi,
+                               FILE* pTextStream);
+
+    /**
+     * @brief                       Prints the header row of the csv, one set of columns per level
+     *
+     * @param numberOfCacheLevels   Number of data cache levels of the configs
+     * @param pCSVStream            Comma separated value output stream, may be null
+     */
+    static void PrintCSVHeader(uint8_t numberOfCacheLevels, FILE* pCSVStream);
+
+    /**
+     * @brief           Writes the results of a shard of a sweep
+     *
+     * @param results   Results to write
+     * @param stream    Output stream
+     */
+    static void WritePartialResults(const PartialResults& results, FILE* stream);
+
+    /**
+     * @brief           Reads the results of a shard of a sweep back
+     *
+     * @param stream    Input stream
+     * @param results   Out. Results read
+     * @return true     if the stream held well formed results
+     */
+    static bool ReadPartialResults(FILE* stream, PartialResults& results);
+
+    /**
+     * @brief               Prints collected statistics to given stream
      *
-     * @param memory    Memory structure whose stats to print
-     * @param cycle     Cycle, used to calculate CPI
-     * @param stream    Output stream to print to
+     * @param descriptor    Config whose stats to print
+     * @param summary       Results of the config
+     * @param stream        Output stream to print to
      */
-    static void PrintStatistics(Memory& memory, uint64_t cycle, FILE* stream);
+    static void PrintStatistics(const ConfigDescriptor& descriptor, const ConfigSummary& summary, FILE* stream);
 
     /**
-     * @brief           Prints collected statistics to given stream in the form
+     * @brief               Prints collected statistics to given stream in the form
      * of a comma separated values file
      *
-     * @param memory    Memory structure whose stats to print
-     * @param cycle     Cycle, used to calculate CPI
-     * @param stream    Output stream to print to
+     * @param descriptor    Config whose stats to print
+     * @param summary       Results of the config
+     * @param stream        Output stream to print to
+     */
+    static void PrintStatisticsCSV(const ConfigDescriptor& descriptor, const ConfigSummary& summary, FILE* stream);
+
+    /**
+     * @brief               Prints collected statistics to given stream as one line of JSON, the raw counts of every
+     * level rather than rates
+     *
+     * @param descriptor    Config whose stats to print
+     * @param summary       Results of the config
+     * @param configIndex   Index of the config in the sweep
+     * @param stream        Output stream to print to
+     */
+    static void PrintStatisticsJSON(const ConfigDescriptor& descriptor, const ConfigSummary& summary,
+                                    uint64_t configIndex, FILE* stream);
+
+    /**
+     * @brief               Prints how far the L1 miss rate and the CPI of a config are from its twin with kOPT at L1
+     *
+     * @param summary       Results of the config
+     * @param optimal       Results of the kOPT twin of the config
+     * @param stream        Output stream to print to
      */
-    static void PrintStatisticsCSV(Memory& memory, uint64_t cycle, FILE* stream);
+    static void PrintOptimalGap(const ConfigSummary& summary, const ConfigSummary& optimal, FILE* stream);
 
     /**
      * @brief Prints a message that the config of the cache structure(s) given
      *
-     * @param memory        The pointer to the top-level cache structure
+     * @param descriptor    Config to print
      * @param stream        The output stream
      */
-    static void PrintConfiguration(Memory& memory, FILE* stream);
+    static void PrintConfiguration(const ConfigDescriptor& descriptor, FILE* stream);
 
     /**
-     * @brief Loads test_params.ini if extant, creates it otherwise
+     * @brief           Loads test_params.ini if extant, creates it otherwise
      *
+     * @param params    Out. Parameters of the sweep
      */
-    static void LoadTestParameters();
+    static void LoadTestParameters(TestParamaters& params);
 
     /**
      *  @brief                  Takes in a trace file
@@ -71,9 +182,18 @@ class IOUtilities {
      */
     static uint8_t* ReadInFile(const char* filename, uint64_t& length);
 
+    /**
+     *  @brief                  Takes in a trace file, without exiting on failure as ReadInFile does
+     *
+     *  @param filename         Name of the trace file to read
+     *  @param length           Output. Returns the length of the file in bytes
+     *  @return                 Array of file contents, null if the file cannot be read
+     */
+    static uint8_t* TryReadInFile(const char* filename, uint64_t& length);
+
     /**
      * @brief           Parses the contents of a trace file and coverts to
-     * internal structure array
+     * internal structure array, exits on a malformed line
      *
      * @param buffer    Pointer to the contents of the file
      * @param length    Lenght of buffer in bytes
@@ -81,20 +201,57 @@ class IOUtilities {
      */
     static void ParseBuffer(uint8_t* buffer, uint64_t length, MemoryAccesses& accesses);
 
+    /**
+     * @brief           Parses the contents of a trace file, without exiting on a malformed line as ParseBuffer does
+     *
+     * @param buffer    Pointer to the contents of the file, freed in any case
+     * @param length    Lenght of buffer in bytes
+     * @param accesses  Out. Memory accesses structure with I and D, partially filled on failure
+     * @return          False if a line is malformed
+     */
+    static bool TryParseBuffer(uint8_t* buffer, uint64_t length, MemoryAccesses& accesses);
+
+    /**
+     * @brief                       Counts the accesses in the contents of a trace file, to size its arrays
+     *
+     * @param buffer                Pointer to the contents of the file
+     * @param length                Lenght of buffer in bytes
+     * @param numDataAccesses       Out. Number of data accesses
+     * @param numInstructionAccesses Out. Number of instruction accesses
+     */
+    static void CountAccesses(const uint8_t* buffer, uint64_t length, uint64_t& numDataAccesses,
+                              uint64_t& numInstructionAccesses);
+
+    /**
+     * @brief                       Parses the contents of a trace file into arrays sized by CountAccesses, e.g. in
+     * memory shared with other processes
+     *
+     * @param buffer                Pointer to the contents of the file, as read by ReadInFile. Not freed
+     * @param length                Lenght of buffer in bytes
+     * @param pDataAccesses         Out. Data accesses
+     * @param pInstructionAccesses  Out. Instruction accesses
+     * @return                      False if a line is malformed
+     */
+    static bool TryParseBufferInto(const uint8_t* buffer, uint64_t length, Instruction* pDataAccesses,
+                                   Instruction* pInstructionAccesses);
+
   private:
     /**
-     * @brief Verifies the global test parameters struct is valid
+     * @brief           Verifies the test parameters read from the ini are valid
      *
+     * @param params    Parameters to verify
      */
-    static void verify_test_params();
+    static void verify_test_params(const TestParamaters& params);
 
     /**
-     * @brief       Parses a single line of the trace file
+     * @brief                       Parses a single line of the trace file
      *
-     * @param line  Pointer within the buffer to the start of a line
-     * @param pDataAccess           Pointer to data portion of memory access
-     * @param pInstructionAccess    Pointer to instruction portion of memory access
+     * @param line                  Pointer within the buffer to the start of a line
+     * @param instructionAccess     Out. Instruction portion of memory access
+     * @param pDataAccesses         Out. Data accesses, the data portion of the line is appended to
+     * @param numDataAccesses       In & out. Number of data accesses so far
+     * @return                      False if the line is malformed
      */
-    static void parseLine(uint8_t* line, std::vector<Instruction>& dataAccesses,
-                          std::vector<Instruction>& instructionAccesses);
+    static bool parseLine(const uint8_t* line, Instruction& instructionAccess, Instruction* pDataAccesses,
+                          uint64_t& numDataAccesses);
 };
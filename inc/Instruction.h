@@ -2,8 +2,11 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
+#include "HugePages.h"
+
 enum access_t {
     READ,
     WRITE,
@@ -22,7 +25,28 @@ struct Instruction {
     }
 };
 
+// The trace arrays are large and read with poor locality, so they are backed with huge pages
+typedef std::vector<Instruction, HugePageAllocator<Instruction>> InstructionVector_t;
+// Read-only view of a trace array, over a vector of this process or memory shared with other processes
+typedef std::span<const Instruction> InstructionSpan_t;
+
+struct MemoryAccessesView {
+    InstructionSpan_t dataAccesses_;
+    InstructionSpan_t instructionAccesses_;
+};
+
 struct MemoryAccesses {
-    std::vector<Instruction> dataAccesses_;
-    std::vector<Instruction> instructionAccesses_;
+    InstructionVector_t dataAccesses_;
+    InstructionVector_t instructionAccesses_;
+
+    MemoryAccesses() = default;
+    // Trace arrays counted in a huge page usage
+    explicit MemoryAccesses(HugePageUsage* pHugePageUsage)
+        : dataAccesses_(HugePageAllocator<Instruction>(pHugePageUsage)),
+          instructionAccesses_(HugePageAllocator<Instruction>(pHugePageUsage)) {
+    }
+
+    inline MemoryAccessesView View() const {
+        return MemoryAccessesView{dataAccesses_, instructionAccesses_};
+    }
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * LRU order of a set with more ways than fit in a PackedLRU_t, as a doubly linked list threaded through per-way
+ * nodes. Promotion and finding the least recently used way are O(1) regardless of the associativity
+ */
+struct IntrusiveLRUNode {
+    uint32_t prev; // Towards the most recently used way
+    uint32_t next; // Towards the least recently used way
+};
+
+struct IntrusiveLRUEnds {
+    uint32_t mru;
+    uint32_t lru;
+};
+
+constexpr uint32_t kIntrusiveLRUNone = UINT32_MAX;
+
+/**
+ * @brief               Builds the initial LRU order, way 0 most recently used, the last way least recently used
+ *
+ * @param pNodes        numWays nodes of the set
+ * @param ends          Ends of the set's list
+ * @param numWays       Associativity
+ */
+inline void IntrusiveLRUInit(IntrusiveLRUNode* pNodes, IntrusiveLRUEnds& ends, uint64_t numWays) {
+    for (uint32_t way = 0; way < numWays; way++) {
+        pNodes[way].prev = way == 0 ? kIntrusiveLRUNone : way - 1;
+        pNodes[way].next = way == numWays - 1 ? kIntrusiveLRUNone : way + 1;
+    }
+    ends.mru = 0;
+    ends.lru = static_cast<uint32_t>(numWays - 1);
+}
+
+/**
+ * @brief               Moves a way to the most recently used position
+ *
+ * @param pNodes        Nodes of the set
+ * @param ends          Ends of the set's list
+ * @param way           Way to promote
+ */
+inline void IntrusiveLRUPromote(IntrusiveLRUNode* pNodes, IntrusiveLRUEnds& ends, uint32_t way) {
+    if (ends.mru == way) {
+        return;
+    }
+    // Unlink, way has a prev since it is not the MRU
+    IntrusiveLRUNode& node = pNodes[way];
+    pNodes[node.prev].next = node.next;
+    if (node.next == kIntrusiveLRUNone) {
+        ends.lru = node.prev;
+    } else {
+        pNodes[node.next].prev = node.prev;
+    }
+    // Push front
+    node.prev = kIntrusiveLRUNone;
+    node.next = ends.mru;
+    pNodes[ends.mru].prev = way;
+    ends.mru = way;
+}
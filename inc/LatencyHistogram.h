@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <stdint.h>
+
+// Latency percentiles of the requests a level served, all that is kept of its histogram once a config completes
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t max = 0;
+};
+
+/**
+ * Histogram of request latencies in cycles, log bucketed as in HdrHistogram. Every power of two is split into
+ * kSubBucketHalfCount linear sub-buckets, so that a latency is recorded in O(1) from its highest set bit, with a
+ * relative error of at most 1 / kSubBucketHalfCount. Latencies below kSubBucketCount are exact, those of
+ * 2^kMaxTrackedValueBits cycles or more are counted in the last sub-bucket. The max is always exact
+ */
+class LatencyHistogram {
+  public:
+    static constexpr uint64_t kSubBucketBits = 5;
+    static constexpr uint64_t kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr uint64_t kSubBucketHalfCount = kSubBucketCount / 2;
+    static constexpr uint64_t kMaxTrackedValueBits = 32;
+    static constexpr uint64_t kMaxTrackedValue = (uint64_t{1} << kMaxTrackedValueBits) - 1;
+    static constexpr uint64_t kNumBuckets = kMaxTrackedValueBits - kSubBucketBits + 1;
+    static constexpr uint64_t kNumCounts = (kNumBuckets + 1) * kSubBucketHalfCount;
+
+    /**
+     * @brief           Counts a request
+     *
+     * @param latency   Cycles from its issue to its completion
+     */
+    inline void Record(uint64_t latency) {
+        counts_[countIndexOf(latency)]++;
+        count_++;
+        max_ = std::max(max_, latency);
+    }
+
+    /**
+     * @brief   Get the percentiles of the latencies recorded. A percentile is the highest latency its sub-bucket
+     * stands for, capped by the max
+     *
+     * @return  LatencySummary
+     */
+    LatencySummary Summarize() const {
+        LatencySummary summary;
+        summary.count = count_;
+        summary.max = max_;
+        if (count_ == 0) {
+            return summary;
+        }
+        // Ranks of the percentiles, rounded up so that p99 of fewer than 100 requests is the max
+        const uint64_t ranks[] = {(count_ * 50 + 99) / 100, (count_ * 90 + 99) / 100, (count_ * 99 + 99) / 100};
+        uint64_t* const percentiles[] = {&summary.p50, &summary.p90, &summary.p99};
+        uint64_t rankIndex = 0;
+        uint64_t cumulativeCount = 0;
+        for (uint64_t countIndex = 0; countIndex < kNumCounts && rankIndex < std::size(ranks); countIndex++) {
+            cumulativeCount += counts_[countIndex];
+            while (rankIndex < std::size(ranks) && cumulativeCount >= ranks[rankIndex]) {
+                *percentiles[rankIndex++] = std::min(highestValueOf(countIndex), max_);
+            }
+        }
+        return summary;
+    }
+
+  private:
+    /**
+     * @brief           Get the sub-bucket a latency is counted in
+     *
+     * @param latency   Latency in cycles
+     * @return          Index in counts_
+     */
+    static inline uint64_t countIndexOf(uint64_t latency) {
+        latency = std::min(latency, kMaxTrackedValue);
+        // Bucket 0 holds the first kSubBucketCount latencies, every next bucket twice the range of the one before
+        const uint64_t bucketIndex =
+            static_cast<uint64_t>(std::bit_width(latency | (kSubBucketCount - 1))) - kSubBucketBits;
+        return bucketIndex * kSubBucketHalfCount + (latency >> bucketIndex);
+    }
+
+    /**
+     * @brief               Get the highest latency counted in a sub-bucket
+     *
+     * @param countIndex    Index in counts_
+     * @return              Latency in cycles
+     */
+    static inline uint64_t highestValueOf(uint64_t countIndex) {
+        const uint64_t bucketIndex = countIndex < kSubBucketCount ? 0 : countIndex / kSubBucketHalfCount - 1;
+        const uint64_t subBucketIndex = countIndex - bucketIndex * kSubBucketHalfCount;
+        return ((subBucketIndex + 1) << bucketIndex) - 1;
+    }
+
+    uint64_t counts_[kNumCounts] = {};
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
@@ -3,16 +3,32 @@
 #include "GlobalIncludes.h"
 #include "RequestManager.h"
 #include "list.h"
-#include <memory>
+#include <vector>
 
-// Obviously these are approximations
-constexpr uint64_t kAccessTimeInCycles[] = {
+class SimTracer;
+
+// Obviously these are approximations. Defaults of the ini, which can sweep them per level
+constexpr uint64_t kDefaultAccessTimeInCycles[] = {
     3,  // L1
     12, // L2
     38, // L3
     195 // Main Memory
 };
 
+// Defaults of the number of requests each level can have outstanding, also sweepable per level
+constexpr uint64_t kDefaultMaxOutstandingRequests[] = {
+    8,  // L1
+    16, // L2
+    32, // L3
+    64  // Main Memory
+};
+
+// Timing of a single level of a hierarchy
+struct LevelTiming {
+    uint64_t accessTimeInCycles;
+    uint64_t maxOutstandingRequests; // Size of its request pool
+};
+
 enum Status {
     kHit,
     kMiss,
@@ -36,11 +52,20 @@ class Memory {
     Memory operator=(const Memory&) = delete;
 
     /**
-     * @brief Construct a new Memory object
+     * @brief               Construct a new Memory object, not yet linked into a hierarchy
+     *
+     * @param cacheLevel    Level of this object in its hierarchy
+     * @param timing        Access time & request pool size of this level
+     */
+    Memory(CacheLevel cacheLevel, const LevelTiming& timing);
+
+    /**
+     * @brief               Links this level to its neighbours in the hierarchy that holds it
      *
-     * @param pLowestCache
+     * @param pUpperCache   Level above this one, nullptr for L1
+     * @param pLowerCache   Level below this one, nullptr for main memory
      */
-    Memory(Memory* pLowestCache, CacheLevel cacheLevel);
+    void SetAdjacentLevels(Memory* pUpperCache, Memory* pLowerCache);
 
     /**
      * @brief Destroy the Memory object
@@ -51,8 +76,9 @@ class Memory {
     /**
      * @brief       Allocates memory needed for memory object
      *
+     * @param arena Arena to allocate from
      */
-    void AllocateMemory();
+    void AllocateMemory(Arena& arena);
 
     /**
      * @brief Get the Upper Cache object
@@ -100,7 +126,7 @@ class Memory {
     }
 
     /**
-     * @brief Frees memory allocated by this Memory object
+     * @brief Releases memory allocated by this Memory object. The arena it came from is reset by its owner
      *
      */
     void FreeMemory();
@@ -126,22 +152,27 @@ class Memory {
     }
 
     /**
-     * @brief                       Simulates a single clock cycle in a single cache level
+     * @brief           Simulates a single clock cycle in main memory
      *
-     * @param cycle                 Current clock cycle
-     * @param completedRequests     Out. A vector of the request indices that were completed this tick.
+     * @param cycle     Current clock cycle
+     */
+    void InternalProcessCache(uint64_t cycle);
+
+    /**
+     * @brief           Simulates a single clock cycle in main memory with the coroutine engine, by resuming the
+     * requests whose access time has passed
      *
-     * @return                      None
+     * @param cycle     Current clock cycle
      */
-    void InternalProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests);
+    void ResumeRequests(uint64_t cycle);
 
     /**
-     * @brief Get the Earliest Next Useful Cycle
+     * @brief   Check whether this level has requests a sweep would process
      *
-     * @return uint64_t the cycle wherein the next useful piece of work can be done
+     * @return  true if any request is waiting or busy
      */
-    inline uint64_t GetEarliestNextUsefulCycle() const {
-        return earliestNextUsefulCycle_;
+    inline bool HasQueuedRequests() const {
+        return pRequestManager_->HasQueuedRequests();
     }
 
     /**
@@ -149,7 +180,9 @@ class Memory {
      *
      * @return uint64_t the cycle wherein the next useful piece of work can be done
      */
-    uint64_t CalculateEarliestNextUsefulCycle() const;
+    inline uint64_t GetEarliestNextUsefulCycle() const {
+        return earliestNextUsefulCycle_;
+    }
 
     /**
      * @brief Simulates a read or write to an address
@@ -172,6 +205,10 @@ class Memory {
 
     // Multi-threading field
     uint64_t threadId_;
+#if (SIM_TRACE == 1)
+    // Sim trace of the run this level is part of, null if the run is not traced
+    SimTracer* pSimTracer_ = nullptr;
+#endif
 
   protected:
     /**
@@ -183,18 +220,88 @@ class Memory {
      */
     Status handleAccess(Request& pRequest);
 
-    // Cache hierarchy fields
-    Memory* const pUpperCache_;
-    std::unique_ptr<Memory> pLowerCache_;
-    Memory* pMainMemory_;
+    // Suspends the coroutine of a request until the given cycle
+    struct WaitForCycle {
+        Memory& memory;
+        uint64_t poolIndex;
+        uint64_t cycle;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            memory.pRequestManager_->GetCoroutineAtIndex(poolIndex) = coroutine;
+            memory.pRequestManager_->ScheduleRequest(poolIndex, cycle);
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    // Suspends the coroutine of a request until its level resumes it from whichever list it has put itself in
+    struct WaitForWakeUp {
+        Memory& memory;
+        uint64_t poolIndex;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            memory.pRequestManager_->GetCoroutineAtIndex(poolIndex) = coroutine;
+        }
+
+        void await_resume() const noexcept {
+        }
+    };
+
+    /**
+     * @brief           Starts the coroutine of a request that was just added to this level
+     *
+     * @param poolIndex Pool index of the request
+     */
+    void startRequest(uint64_t poolIndex);
+
+    /**
+     * @brief           Coroutine of a main memory request. Waits out the access time and then fills the block in the
+     * level above
+     *
+     * @param poolIndex Pool index of the request
+     */
+    RequestCoroutine runRequest(uint64_t poolIndex);
+
+    /**
+     * @brief Resumes the waiting requests whose call back cycle has come, in call back order
+     */
+    void resumeDueRequests();
+
+    /**
+     * @brief           Resumes the coroutine of a request and frees the request once it is done
+     *
+     * @param poolIndex Pool index of the request
+     */
+    void resumeRequest(uint64_t poolIndex);
+
+    /**
+     * @brief Schedules the next wake up of this level at the call back cycle of the head of its waiting requests list.
+     * Every level has a single access time, so the waiting requests list is in call back order and its head is the next
+     * event of this level
+     */
+    void updateEarliestNextUsefulCycle();
+
+    // Cache hierarchy fields, the levels are owned by their CacheHierarchy
+    Memory* pUpperCache_ = nullptr;
+    Memory* pLowerCache_ = nullptr;
     CacheLevel cacheLevel_;
+    LevelTiming timing_;
 
     uint64_t cycle_ = 0;
 
-    std::unique_ptr<RequestManager> pRequestManager_;
+    RequestManager* pRequestManager_ = nullptr; // Allocated from an arena
 
     // Data for simulator performance
-    uint64_t earliestNextUsefulCycle_;
+    uint64_t earliestNextUsefulCycle_; // As of the last time this level was processed
     bool wasWorkDoneThisCycle_;
 
     Statistics stats_;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <thread>
+
+#include "GlobalIncludes.h"
+#include "debug.h"
+
+/**
+ * Bounded lock-free queue with any number of producers & one consumer. Every slot carries a sequence number telling
+ * whose turn it is: a producer claims a slot by advancing the tail & publishes its item by bumping the slot's sequence,
+ * so producers never wait on each other and the consumer never takes a lock. A producer finding the queue full yields
+ * until the consumer catches up
+ */
+template <typename T>
+class MpscQueue {
+  public:
+    /**
+     * @brief           Allocates the slots
+     *
+     * @param capacity  Number of slots, power of 2
+     */
+    explicit MpscQueue(uint64_t capacity) : mask_(capacity - 1), slots_(std::make_unique<Slot[]>(capacity)) {
+        assert_release(isPowerOfTwo(capacity));
+        for (uint64_t i = 0; i < capacity; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        head_ = 0;
+        tail_.store(0, std::memory_order_relaxed);
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief       Appends an item, waits for a free slot if the queue is full. Callable from any thread
+     *
+     * @param item  Item to append
+     */
+    void Push(const T& item) {
+        uint64_t position = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[position & mask_];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                // The slot is free, claim it unless another producer got there first
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return;
+                }
+            } else if (sequence < position) {
+                // Full, the consumer has not taken the item of the previous lap yet
+                std::this_thread::yield();
+                position = tail_.load(std::memory_order_relaxed);
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief       Takes the oldest item. Only callable from the consumer thread
+     *
+     * @param item  Out. Item taken
+     * @return true if there was an item
+     */
+    bool TryPop(T& item) {
+        Slot& slot = slots_[head_ & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        item = slot.item;
+        // Free for the producer one lap ahead
+        slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+    /**
+     * @brief   Whether there is no item to take. Only callable from the consumer thread
+     *
+     * @return true if TryPop would fail
+     */
+    bool IsEmpty() const {
+        return slots_[head_ & mask_].sequence.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+  private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        T item;
+    };
+
+    const uint64_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    // Only touched by the consumer
+    uint64_t head_;
+    // Producers & the consumer on separate cache lines
+    alignas(64) std::atomic<uint64_t> tail_;
+};
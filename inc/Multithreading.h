@@ -8,6 +8,7 @@
 
 typedef pthread_t Thread_t;
 typedef pthread_mutex_t Lock_t;
+typedef pthread_cond_t Condition_t;
 #define THREAD_FUNCTION_TYPE(function) void*(*function)(void*)
 #endif
 
@@ -16,6 +17,7 @@ typedef pthread_mutex_t Lock_t;
 
 typedef HANDLE Thread_t;
 typedef RTL_CRITICAL_SECTION Lock_t;
+typedef CONDITION_VARIABLE Condition_t;
 #define THREAD_FUNCTION_TYPE(function)  LPTHREAD_START_ROUTINE function
 #endif
 
@@ -23,6 +25,12 @@ namespace Multithreading {
     void InitializeLock(Lock_t *pLock);
     void Lock(Lock_t *pLock);
     void Unlock(Lock_t *pLock);
+    void InitializeCondition(Condition_t *pCondition);
+    // Releases the lock while waiting, holds it again on return. May return spuriously, so wait in a loop
+    void WaitForCondition(Condition_t *pCondition, Lock_t *pLock);
+    // As WaitForCondition, returns after at most the timeout
+    void WaitForConditionFor(Condition_t *pCondition, Lock_t *pLock, uint64_t timeoutInMilliseconds);
+    void WakeAll(Condition_t *pCondition);
     void StartThread(THREAD_FUNCTION_TYPE(threadFunction), void *pThreadData, Thread_t *pThreadOut);
     void WaitForThreads(std::vector<Thread_t> threads);
 }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Instruction.h"
+
+/**
+ * For every data access in the trace, holds the index of the next data access that touches the same block, for a
+ * given block size. This is what Belady's MIN (kOPT) replacement needs to know the future
+ */
+class NextUseIndex {
+  public:
+    NextUseIndex() = delete;
+
+    /**
+     * @brief                   Builds the index in one backward pass over the accesses
+     *
+     * @param dataAccesses      Data accesses of the trace
+     * @param blockSize         Block size the index is built for
+     * @param pHugePageUsage    Usage to count the index in, null if it is not counted
+     */
+    NextUseIndex(InstructionSpan_t dataAccesses, uint64_t blockSize, HugePageUsage* pHugePageUsage);
+
+    /**
+     * @brief                   Get the index of the next access to the block touched by the given access
+     *
+     * @param dataAccessIndex   Index of the access within the data accesses
+     * @return                  Index of the next access to the same block, kNoNextUse if there is none
+     */
+    inline uint32_t GetNextUse(uint64_t dataAccessIndex) const {
+        return nextUse_[dataAccessIndex];
+    }
+
+    /**
+     * @brief Get the block size this index was built for
+     *
+     * @return uint64_t
+     */
+    inline uint64_t GetBlockSize() const {
+        return blockSize_;
+    }
+
+    /**
+     * @brief Get the memory taken up by the index
+     */
+    inline uint64_t GetSizeInBytes() const {
+        return nextUse_.size() * sizeof(uint32_t);
+    }
+
+    static constexpr uint32_t kNoNextUse = UINT32_MAX;
+
+  private:
+    std::vector<uint32_t, HugePageAllocator<uint32_t>> nextUse_;
+    uint64_t blockSize_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bit>
+#include <stdint.h>
+
+/**
+ * LRU order of a set of up to 16 ways packed in one 64-bit word. Nibble i holds the index of the way at recency
+ * position i, position 0 being the most recently used. All operations are branch-free
+ */
+typedef uint64_t PackedLRU_t;
+
+constexpr uint64_t kMaxPackedLRUAssociativity = 16;
+constexpr uint64_t kBitsPerPackedLRUEntry = 4;
+constexpr PackedLRU_t kPackedLRUNibbleOnes = 0x1111111111111111ULL;
+constexpr PackedLRU_t kPackedLRUNibbleHighBits = 0x8888888888888888ULL;
+
+/**
+ * @brief               Builds the initial LRU order, way 0 most recently used, the last way least recently used
+ *
+ * @param numWays       Associativity, at most kMaxPackedLRUAssociativity
+ * @return              Packed LRU order
+ */
+constexpr PackedLRU_t PackedLRUInit(uint64_t numWays) {
+    PackedLRU_t lru = 0;
+    for (uint64_t way = 0; way < numWays; way++) {
+        lru |= way << (way * kBitsPerPackedLRUEntry);
+    }
+    return lru;
+}
+
+/**
+ * @brief               Get the way at a recency position
+ *
+ * @param lru           Packed LRU order
+ * @param position      0 for the most recently used, associativity - 1 for the least
+ * @return              Way index
+ */
+inline uint8_t PackedLRUAt(PackedLRU_t lru, uint64_t position) {
+    return static_cast<uint8_t>((lru >> (position * kBitsPerPackedLRUEntry)) & 0xF);
+}
+
+/**
+ * @brief               Moves a way to the most recently used position, shifting the ways before it down by one
+ *
+ * @param lru           Packed LRU order
+ * @param way           Way to promote, must be in the order
+ * @return              New packed LRU order
+ */
+inline PackedLRU_t PackedLRUPromote(PackedLRU_t lru, uint8_t way) {
+    // Nibbles equal to way become 0. The lowest flagged zero nibble is exact, false positives are only above it
+    const PackedLRU_t difference = lru ^ (way * kPackedLRUNibbleOnes);
+    const PackedLRU_t zeroNibbles = (difference - kPackedLRUNibbleOnes) & ~difference & kPackedLRUNibbleHighBits;
+    const uint64_t position = static_cast<uint64_t>(std::countr_zero(zeroNibbles)) / kBitsPerPackedLRUEntry;
+    const PackedLRU_t beforeMask = (1ULL << (position * kBitsPerPackedLRUEntry)) - 1;
+    const PackedLRU_t throughMask = (beforeMask << kBitsPerPackedLRUEntry) | 0xF;
+    return (lru & ~throughMask) | ((lru & beforeMask) << kBitsPerPackedLRUEntry) | way;
+}
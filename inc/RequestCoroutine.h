@@ -0,0 +1,67 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "debug.h"
+
+#ifndef COROUTINE_ENGINE
+#define COROUTINE_ENGINE (0)
+#endif
+
+// Runs every request as a coroutine rather than through the per-cycle sweep of the request lists
+constexpr bool kUseCoroutineEngine = COROUTINE_ENGINE == 1;
+
+constexpr uint64_t kMaxCoroutineFrameSizeInBytes = 256;
+
+// Storage for the frame of the coroutine of one request. Every request slot has one, so starting a request does not
+// allocate
+struct alignas(16) CoroutineFrame {
+    uint8_t bytes[kMaxCoroutineFrameSizeInBytes];
+};
+
+// Frame storage for the next request coroutine started on this thread, set by the level that starts it
+inline thread_local CoroutineFrame* gNextCoroutineFrame = nullptr;
+
+/**
+ * Return type of the coroutine that simulates a request from the moment it is added to a level until it completes. It
+ * runs right away up to its first co_await, which hands its handle to whatever it waits on. Once it is done its level
+ * destroys it and frees its request slot. The object itself carries nothing
+ */
+struct RequestCoroutine {
+    struct promise_type {
+        static void* operator new(size_t size) {
+            assert_release(gNextCoroutineFrame && "Request coroutines are only started by their level");
+            assert_release(size <= sizeof(CoroutineFrame) && "Request coroutine frame outgrew its slot");
+            void* pFrame = gNextCoroutineFrame;
+            gNextCoroutineFrame = nullptr;
+            return pFrame;
+        }
+
+        static void operator delete(void*) {
+            // The frame belongs to its request slot
+        }
+
+        RequestCoroutine get_return_object() {
+            return RequestCoroutine();
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        // Stays suspended when done so that its level can tell it completed
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "Arena.h"
 #include "GlobalIncludes.h"
 #include "Instruction.h"
+#include "RequestCoroutine.h"
+#include "debug.h"
 #include "list.h"
 
 struct Request {
@@ -18,89 +21,155 @@ class RequestManager {
     RequestManager operator=(const RequestManager&) = delete;
 
     /**
-     * @brief               Initializes the request manager and the request lists it maintains
+     * @brief                           Initializes the request manager and the request lists it maintains
      *
-     * @param cacheLevel    The cache level of the cache whose requests this manager manages
+     * @param maxOutstandingRequests    Size of the request pool of the level whose requests this manager manages
+     * @param arena                     Arena the request pool & lists are allocated from
      *
      */
-    RequestManager(CacheLevel cacheLevel);
+    RequestManager(uint64_t maxOutstandingRequests, Arena& arena);
 
     /**
-     * @brief Destroy the Request Manager object
+     * @brief                           Get the arena memory a request manager and its requests take up
      *
+     * @param maxOutstandingRequests    Size of the request pool of the level whose requests the manager manages
+     * @return                          Size in bytes
      */
-    ~RequestManager();
+    static uint64_t GetArenaSize(uint64_t maxOutstandingRequests);
 
     /**
      * @brief           Add a request to the tail of the busy requests list
      *
-     * @param pElement  List element of request to add
+     * @param poolIndex Pool index of request to add
      *
      */
-    void AddRequestToBusyList(DoubleListElement* pElement);
+    inline void AddRequestToBusyList(uint64_t poolIndex) {
+        CODE_FOR_ASSERT(bool ret =) busyRequests_.PushBack(poolIndex);
+        assert(ret);
+    }
 
     /**
      * @brief           Remove given request from busy requests list
      *
-     * @param pElement  List element of request to be removed
+     * @param poolIndex Pool index of request to be removed
      */
-    void RemoveRequestFromBusyList(DoubleListElement* pElement);
+    inline void RemoveRequestFromBusyList(uint64_t poolIndex) {
+        busyRequests_.Remove(poolIndex);
+    }
 
     /**
      * @brief           Remove given request from waiting requests list
      *
-     * @param pElement  List element of request to be removed
+     * @param poolIndex Pool index of request to be removed
      */
-    void RemoveRequestFromWaitingList(DoubleListElement* pElement);
+    inline void RemoveRequestFromWaitingList(uint64_t poolIndex) {
+        waitingRequests_.Remove(poolIndex);
+    }
 
     /**
      * @brief           Add a request to the head of the free requests list
      *
-     * @param pElement  List element of request to add
+     * @param poolIndex Pool index of request to add
      *
      */
-    void PushRequestToFreeList(DoubleListElement* pElement);
+    inline void PushRequestToFreeList(uint64_t poolIndex) {
+        CODE_FOR_ASSERT(bool ret =) freeRequests_.PushFront(poolIndex);
+        assert(ret);
+    }
 
     /**
      * @brief           Add a request to the tail of the waiting requests list
      *
-     * @param pElement  List element of request to add
+     * @param poolIndex Pool index of request to add
+     *
+     */
+    inline void AddRequestToWaitingList(uint64_t poolIndex) {
+        CODE_FOR_ASSERT(bool ret =) waitingRequests_.PushBack(poolIndex);
+        assert(ret);
+    }
+
+    /**
+     * @brief           Add a request to the tail of the resolved requests list, the requests that were handled when
+     * they were added and only wait out their access time
+     *
+     * @param poolIndex Pool index of request to add
+     *
+     */
+    inline void AddRequestToResolvedList(uint64_t poolIndex) {
+        CODE_FOR_ASSERT(bool ret =) resolvedRequests_.PushBack(poolIndex);
+        assert(ret);
+    }
+
+    /**
+     * @brief           Remove given request from resolved requests list
+     *
+     * @param poolIndex Pool index of request to be removed
+     */
+    inline void RemoveRequestFromResolvedList(uint64_t poolIndex) {
+        resolvedRequests_.Remove(poolIndex);
+    }
+
+    /**
+     * @brief   Check whether a request can be added
      *
+     * @return  true if the free requests list is not empty
      */
-    void AddRequestToWaitingList(DoubleListElement* pElement);
+    inline bool HasFreeRequests() const {
+        return freeRequests_.GetCount() != 0;
+    }
 
     /**
      * @brief   Pop request from head of free requests list
      *
-     * @return  List element of request, nullptr if list is empty
+     * @return  Pool index of request, IndexList::kNone if list is empty
      */
-    DoubleListElement* PopRequestFromFreeList();
+    inline uint64_t PopRequestFromFreeList() {
+        return freeRequests_.PopFront();
+    }
 
     /**
-     * @brief   Peek at the head element of the busy requests list
+     * @brief   Check whether any request is busy
      *
-     * @return  List element of the head of the busy requests list
+     * @return  true if the busy requests list is not empty
      */
-    DoubleListElement* PeekHeadOfBusyList() {
-        return pBusyRequests_->PeekHead();
+    inline bool HasBusyRequests() const {
+        return busyRequests_.GetCount() != 0;
     }
 
     /**
-     * @brief   Get the Waiting Requests object, for use in for_each_in_double_list macro
+     * @brief   Check whether any request still has to go through the waiting or busy lists
+     *
+     * @return  true if either list is not empty
+     */
+    inline bool HasQueuedRequests() const {
+        return (waitingRequests_.GetCount() | busyRequests_.GetCount()) != 0;
+    }
+
+    /**
+     * @brief   Get the Waiting Requests object, for use in for_each_in_index_list macro
      *
      * @return  Waiting requests list
      */
-    DoubleList* GetWaitingRequests() {
-        return pWaitingRequests_;
+    IndexList* GetWaitingRequests() {
+        return &waitingRequests_;
+    }
+
+    /**
+     * @brief   Get the Resolved Requests object, for use in for_each_in_index_list macro
+     *
+     * @return  Resolved requests list
+     */
+    IndexList* GetResolvedRequests() {
+        return &resolvedRequests_;
     }
 
     /**
-     * @brief   Get the Busy Requests object, for use in for_each_in_double_list macro
+     * @brief   Get the Busy Requests object, for use in for_each_in_index_list macro
      *
      * @return  Busy requests list
      */
-    DoubleList* GetBusyRequests() {
-        return pBusyRequests_;
+    IndexList* GetBusyRequests() {
+        return &busyRequests_;
     }
 
     /**
@@ -131,16 +200,49 @@ class RequestManager {
      */
     void NewInstruction(uint64_t poolIndex, Instruction access, uint64_t cycle, uint64_t accessTimeInCycles);
 
-    static constexpr uint64_t kMaxNumberOfRequests = 8;
+    /**
+     * @brief           Adds a request to the waiting requests list, which is kept in call back order. Requests that
+     * call back in the same cycle stay in the order they were added
+     *
+     * @param poolIndex Pool index of request to add
+     * @param cycle     Cycle to call the request back in
+     */
+    void ScheduleRequest(uint64_t poolIndex, uint64_t cycle);
+
+    /**
+     * @brief           Get the storage for the coroutine frame of a request. Only allocated for the coroutine engine
+     *
+     * @param poolIndex Pool index of request
+     * @return          Frame storage
+     */
+    inline CoroutineFrame& GetCoroutineFrameAtIndex(uint64_t poolIndex) {
+        return pCoroutineFrames_[poolIndex];
+    }
+
+    /**
+     * @brief           Get the coroutine of a request, set each time it suspends. Only allocated for the coroutine
+     * engine
+     *
+     * @param poolIndex Pool index of request
+     * @return          Handle of the suspended coroutine
+     */
+    inline std::coroutine_handle<>& GetCoroutineAtIndex(uint64_t poolIndex) {
+        return pCoroutines_[poolIndex];
+    }
 
     static constexpr int16_t kInvalidRequestIndex = -1;
 
   private:
-    Request* pRequestPool_;
-    DoubleList* pWaitingRequests_;
-    DoubleList* pFreeRequests_;
-    DoubleList* pBusyRequests_;
     uint64_t maxOutstandingRequests_;
+    Request* pRequestPool_;
+    // Every request is in exactly one of the lists below, so they share one node per request
+    IndexListNode* pRequestNodes_;
+    IndexList waitingRequests_;
+    IndexList freeRequests_;
+    IndexList busyRequests_;
+    IndexList resolvedRequests_;
+    CoroutineFrame* pCoroutineFrames_;
+    std::coroutine_handle<>* pCoroutines_;
 };
 
 inline uint64_t RequestManager::GetPoolIndex(Request* pRequest) {
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Cache.h"
+#include "IOUtilities.h"
+#include "MpscQueue.h"
+#include "Multithreading.h"
+
+/**
+ * Writes the results of a sweep as the configs complete, from a thread of its own fed by the workers through a
+ * lock-free queue, so that partial results can be read mid-run. The JSON lines & columnar outputs get every config in
+ * completion order. The text & csv outputs keep the enumeration order of a sweep, every config is printed as soon as
+ * the ones before it completed. Text going to the console is printed once the sweep is done, after the progress bar
+ *
+ * The columnar output is made of a header & blocks of rows, all in native byte order:
+ *
+ *   "CSIMCOL1", uint64_t number of columns, the name of every column NUL-terminated
+ *   per block: uint64_t number of rows, then every column in turn as that many uint64_t
+ *
+ * Blocks are written once full or every kColumnsFlushPeriod, so a file cut short loses at most its last block
+ */
+class ResultWriter {
+  public:
+    /**
+     * @brief                   Sets up the outputs, nothing is written until Start
+     *
+     * @param descriptors       Every config of the sweep, in enumeration order
+     * @param summaries         Results of every config, filled in by the workers. Aliases are filled in by the writer
+     * @param aliasOf           Index of the config whose results a config shares, its own index if it is simulated
+     * @param compareToOptimal  Whether every odd config is the kOPT twin of the one before it
+     * @param pTextStream       Text output stream, null if none
+     * @param pCSVStream        Comma separated value output stream, null if none
+     * @param pJSONStream       JSON lines output stream, null if none
+     * @param pColumnsStream    Columnar output stream, null if none
+     */
+    ResultWriter(const std::vector<ConfigDescriptor>& descriptors, std::vector<ConfigSummary>& summaries,
+                 const std::vector<uint64_t>& aliasOf, bool compareToOptimal, FILE* pTextStream, FILE* pCSVStream,
+                 FILE* pJSONStream, FILE* pColumnsStream);
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter operator=(const ResultWriter&) = delete;
+
+    /**
+     * @brief Writes the headers & starts the writer thread
+     */
+    void Start();
+
+    /**
+     * @brief               Hands a config over to the writer once its summary is filled in, waking it if asleep.
+     * Callable from any thread, only waits on the writer if it is kQueueCapacity configs behind
+     *
+     * @param configIndex   Config that completed, its aliases with it
+     */
+    inline void Push(uint64_t configIndex);
+
+    /**
+     * @brief Writes the configs left once every config was pushed, then the config with the lowest CPI, and stops the
+     * writer thread
+     */
+    void Finish();
+
+#ifdef _MSC_VER
+    /**
+     * @brief                   Writer thread. Writes the configs pushed until Finish
+     *
+     * @param pResultWriter     void pointer of a ResultWriter
+     *
+     * @return                  Status
+     */
+    static DWORD WINAPI Run(void* pResultWriter);
+#else
+    /**
+     * @brief                   Writer thread. Writes the configs pushed until Finish
+     *
+     * @param pResultWriter     void pointer of a ResultWriter
+     *
+     * @return                  None
+     */
+    static void* Run(void* pResultWriter);
+#endif
+
+    static constexpr uint64_t kQueueCapacity = 1 << 12;
+
+    static constexpr uint64_t kRowsPerBlock = 1 << 10;
+
+    static constexpr auto kColumnsFlushPeriod = std::chrono::seconds(1);
+
+  private:
+    /**
+     * @brief               Writes a config that completed & the configs aliasing it
+     *
+     * @param configIndex   Config simulated
+     */
+    void writeCompleted(uint64_t configIndex);
+
+    /**
+     * @brief Prints the configs to the text & csv outputs for as long as the next one in enumeration order completed
+     */
+    void printInOrder();
+
+    /**
+     * @brief Writes the rows of the columnar output buffered so far as a block
+     */
+    void flushColumns();
+
+    /**
+     * @brief Flushes every output, so that what was written so far can be read
+     */
+    void flushStreams();
+
+    const std::vector<ConfigDescriptor>& descriptors_;
+    std::vector<ConfigSummary>& summaries_;
+    bool compareToOptimal_;
+    FILE* pTextStream_;
+    FILE* pCSVStream_;
+    FILE* pJSONStream_;
+    FILE* pColumnsStream_;
+    // Text going to the console waits for the end of the sweep
+    bool isTextDeferred_;
+    // Configs aliasing each simulated config, as linked lists threaded through nextAlias_. Indexed by config
+    std::vector<uint64_t> firstAlias_;
+    std::vector<uint64_t> nextAlias_;
+    // Configs written, & the next one in enumeration order to print. Only touched by the writer
+    std::vector<bool> isWritten_;
+    uint64_t nextToPrint_;
+    LowestCpi lowestCpi_;
+    // Rows buffered for the next block of the columnar output, indexed by column
+    std::vector<std::vector<uint64_t>> columns_;
+    std::chrono::steady_clock::time_point lastColumnsFlush_;
+    MpscQueue<uint64_t> completedConfigs_;
+    // Set by Finish once every config was pushed
+    std::atomic<bool> isFinishing_;
+    // The writer sleeps on workAvailable_ under lock_ while there is nothing to write, Push & Finish wake it. Push only
+    // locks to wake it while isWriterAsleep_ is set, so that the workers do not serialize on lock_
+    Lock_t lock_;
+    Condition_t workAvailable_;
+    std::atomic<bool> isWriterAsleep_;
+    Thread_t thread_;
+};
+
+inline void ResultWriter::Push(uint64_t configIndex) {
+    completedConfigs_.Push(configIndex);
+    // Pairs with the fence of the writer between setting isWriterAsleep_ & checking the queue: either the writer sees
+    // the config, or this sees the flag & wakes it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (isWriterAsleep_.load(std::memory_order_relaxed)) {
+        Multithreading::Lock(&lock_);
+        Multithreading::WakeAll(&workAvailable_);
+        Multithreading::Unlock(&lock_);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Instruction.h"
+
+/**
+ * Parsed trace arrays in a POSIX shared memory segment, so that processes simulating the same trace on one host (e.g.
+ * the shards of a sweep) parse it once and read a single copy. The segment is named after the identity of the trace
+ * file. The first process to attach parses the trace into it, the others wait for it to be ready. Every process holds a
+ * shared flock on the segment while attached: the last one to detach is the one that can lock it exclusively, & removes
+ * it. The kernel drops the locks of processes that crash, so their segments are removed by the next process to attach
+ * to any trace. Only on Linux; elsewhere Attach fails and every process parses the trace itself
+ */
+class SharedTrace {
+  public:
+    SharedTrace() = default;
+    SharedTrace(const SharedTrace&) = delete;
+    SharedTrace operator=(const SharedTrace&) = delete;
+
+    ~SharedTrace();
+
+    /**
+     * @brief                   Attaches to the segment of a trace, parsing the trace into it first if needed
+     *
+     * @param pTraceFilename    Trace file
+     * @return true             if attached, GetView can be used
+     */
+    bool Attach(const char* pTraceFilename);
+
+    /**
+     * @brief   Get the trace arrays in the segment, read-only
+     *
+     * @return  View of the accesses
+     */
+    MemoryAccessesView GetView() const;
+
+    // Start of the segment, ahead of the trace arrays
+    struct Header;
+
+  private:
+    /**
+     * @brief                   Sizes the segment just created as fd_ & parses the trace into it
+     *
+     * @param pTraceFilename    Trace file
+     * @return true             if parsed, false if the trace cannot be read or is malformed & the segment was removed
+     */
+    bool create(const char* pTraceFilename);
+
+    /**
+     * @brief       Maps the segment opened as fd_, created by another process, once it is ready
+     *
+     * @return true if mapped, false if the segment was removed meanwhile, or its creator died before it was ready
+     */
+    bool open();
+
+    /**
+     * @brief       Maps the trace arrays of the segment read-only
+     */
+    void mapArrays();
+
+    /**
+     * @brief       Unmaps the segment & closes fd_, releasing the lock on it
+     */
+    void detach();
+
+    Header* pHeader_ = nullptr;
+    const Instruction* pArrays_ = nullptr;
+    uint64_t arraysSizeInBytes_ = 0;
+    // Open while attached, it holds the lock
+    int fd_ = -1;
+    char name_[96] = "";
+};
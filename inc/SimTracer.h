@@ -53,10 +53,13 @@ public:
     /**
      * @brief                   Construct a new Sim Tracer object
      * 
-     * @param filename          name of file to open
-     * @param numberOfConfigs   total number of configs under test
+     * @param filename              name of file to open
+     * @param numberOfConfigs       total number of configs under test
+     * @param numberOfCacheLevels   number of data cache levels of every config
+     * @param maxNumberOfThreads    number of thread slots the configs run in
      */
-    SimTracer(const char *filename, uint64_t numberOfConfigs);
+    SimTracer(const char *filename, uint64_t numberOfConfigs, uint8_t numberOfCacheLevels,
+              int64_t maxNumberOfThreads);
 
     /**
      * @brief Destroy the Sim Tracer object
@@ -83,6 +86,8 @@ public:
 private:
 
     FILE *pFile_;
+    uint8_t numberOfCacheLevels_;
+    int64_t maxNumberOfThreads_;
     uint8_t **pBufferAppendPoints_;
     uint8_t **pSimTraceBuffer_;
     uint64_t *pEntryCounters_;
@@ -90,6 +95,13 @@ private:
 };
 
 
+// Records an entry to the sim trace of a memory object's hierarchy, if it has one
+#define SIM_TRACE_PRINT(pMemory, traceEntryId, ...)                                                  \
+    do {                                                                                             \
+        if ((pMemory)->pSimTracer_) {                                                                \
+            (pMemory)->pSimTracer_->Print(traceEntryId, pMemory __VA_OPT__(,) __VA_ARGS__);          \
+        }                                                                                            \
+    } while (0)
 
 #else
 
@@ -99,4 +111,6 @@ public:
     void Print(...) {};
 };
 
+#define SIM_TRACE_PRINT(...)
+
 #endif // SIM_TRACE
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "Cache.h"
+#include "Instruction.h"
+#include "Multithreading.h"
+#include "NextUseIndex.h"
+
+/**
+ * Library API of the simulator, for tools that simulate hierarchies in-process instead of running ./cache once per
+ * sweep. Nothing in it is process-global: traces, simulations & worker pools are independent objects, and any number
+ * of each can be used at once from any thread. ./cache --daemon is built on it, and cachesim.h wraps it in a C ABI
+ */
+
+/**
+ * A trace parsed into memory, shared by every simulation of it
+ */
+class Trace {
+  public:
+    /**
+     * @brief               Parses a trace file into memory
+     *
+     * @param pFilename     Trace file
+     * @return              The trace, null if the file cannot be read or has a malformed line
+     */
+    static std::shared_ptr<Trace> Load(const char* pFilename);
+
+    /**
+     * @brief               Takes over the arrays of a trace already parsed, use Load to parse a file
+     *
+     * @param pFilename     Trace file
+     * @param accesses      Its arrays
+     */
+    Trace(const char* pFilename, MemoryAccesses&& accesses);
+    Trace(const Trace&) = delete;
+    Trace operator=(const Trace&) = delete;
+
+    /**
+     * @brief Get the name of the trace file
+     */
+    inline const std::string& GetFilename() const;
+
+    /**
+     * @brief Get the number of instructions in the trace
+     */
+    inline uint64_t GetNumInstructions() const;
+
+    /**
+     * @brief Get the trace arrays
+     */
+    inline MemoryAccessesView GetAccesses() const;
+
+    /**
+     * @brief               Get the next-use indices of every block size the kOPT levels of some configs use, building
+     * those not built yet. A snapshot: indices built later for other configs go into a new one, so that the configs
+     * running on this one are not disturbed
+     *
+     * @param descriptors   Configs to get the next-use indices of
+     * @return              Next-use indices covering the configs, among others
+     */
+    std::shared_ptr<const std::vector<NextUseIndex>>
+    GetNextUseIndices(const std::vector<ConfigDescriptor>& descriptors);
+
+  private:
+    std::string filename_;
+    MemoryAccesses accesses_;
+    // Guards pNextUseIndices_
+    Lock_t lock_;
+    std::shared_ptr<const std::vector<NextUseIndex>> pNextUseIndices_;
+};
+
+/**
+ * Configs simulated over a trace & their results. The configs are run either on the calling thread with Run, on a
+ * WorkerPool with WorkerPool::Submit, or on threads of the caller's own with RunConfig. Results can be read as each
+ * config completes. Must outlive the configs running
+ */
+class Simulation {
+  public:
+    /**
+     * @brief               Sets up the configs, nothing is simulated yet
+     *
+     * @param pTrace        Trace to simulate, kept in memory by the simulation
+     * @param descriptors   Configs to simulate, each valid as told by IsDescriptorValid
+     */
+    Simulation(std::shared_ptr<Trace> pTrace, std::vector<ConfigDescriptor> descriptors);
+    Simulation(const Simulation&) = delete;
+    Simulation operator=(const Simulation&) = delete;
+
+    /**
+     * @brief                       Get a hierarchy with the default timings of ./cache & no caches sized yet
+     *
+     * @param numberOfCacheLevels   Number of data cache levels
+     * @return                      Config to fill in the sizes of
+     */
+    static ConfigDescriptor GetDefaultDescriptor(uint8_t numberOfCacheLevels);
+
+    /**
+     * @brief               Checks that a config can be simulated, under the same constraints as the sweeps of the ini
+     *
+     * @param descriptor    Config to check
+     * @param pError        Out. Reason the config is invalid
+     * @param errorSize     Size of pError
+     * @return true         if the config is valid
+     */
+    static bool IsDescriptorValid(const ConfigDescriptor& descriptor, char* pError, size_t errorSize);
+
+    /**
+     * @brief Simulates every config on the calling thread, returns once all are done
+     */
+    void Run();
+
+    /**
+     * @brief               Simulates one config on the calling thread. Configs may run concurrently on any threads,
+     * each once
+     *
+     * @param configIndex   Config to simulate
+     * @param arena         Scratch memory of the calling thread, resized for the config & reused across configs
+     */
+    void RunConfig(uint64_t configIndex, Arena& arena);
+
+    /**
+     * @brief               Takes the configs that completed since the last call, waiting for one if none did
+     *
+     * @param configIndices Out. Configs completed, in completion order
+     * @return true         if there were configs left to take, false once all of them were taken
+     */
+    bool WaitForCompleted(std::vector<uint64_t>& configIndices);
+
+    /**
+     * @brief Waits for every config to complete
+     */
+    void Wait();
+
+    /**
+     * @brief Get the number of configs simulated
+     */
+    inline uint64_t GetNumConfigs() const;
+
+    /**
+     * @brief Get a config simulated
+     */
+    inline const ConfigDescriptor& GetDescriptor(uint64_t configIndex) const;
+
+    /**
+     * @brief Get the results of a config, once it completed
+     */
+    inline const ConfigSummary& GetSummary(uint64_t configIndex) const;
+
+  private:
+    std::shared_ptr<Trace> pTrace_;
+    MemoryAccessesView accesses_;
+    std::shared_ptr<const std::vector<NextUseIndex>> pNextUseIndices_;
+    std::vector<ConfigDescriptor> descriptors_;
+    std::vector<ConfigSummary> summaries_;
+    // Guards the completion of the configs
+    Lock_t lock_;
+    Condition_t configCompleted_;
+    // Configs completed but not taken by WaitForCompleted yet, & the number of configs not completed
+    std::vector<uint64_t> completedConfigs_;
+    uint64_t numConfigsLeft_;
+};
+
+class WorkerPool;
+
+struct PoolWorkItem {
+    Simulation* pSimulation;
+    uint64_t configIndex;
+    // Memory the config takes up while it runs
+    uint64_t footprint;
+};
+
+struct PoolWorkerContext {
+    WorkerPool* pPool;
+    uint64_t threadId;
+};
+
+/**
+ * Fixed pool of workers running the configs of any number of simulations, in the order they were submitted. Every
+ * worker has an arena of its own, reused across configs. Given a memory budget, a worker only starts a config once it
+ * fits next to the configs already running, taking the first one submitted that does, as the workers of ./cache do
+ */
+class WorkerPool {
+  public:
+    /**
+     * @brief               Starts the workers
+     *
+     * @param numWorkers    Number of workers
+     */
+    explicit WorkerPool(uint64_t numWorkers);
+
+    /**
+     * @brief               Starts the workers, running as many configs at once as fit in a memory budget
+     *
+     * @param numWorkers    Number of workers
+     * @param memoryBudget  Memory the configs running at once may take up together. A config over it on its own
+     * runs once nothing else does
+     */
+    WorkerPool(uint64_t numWorkers, uint64_t memoryBudget);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Runs the configs submitted so far to completion, then stops the workers
+     */
+    ~WorkerPool();
+
+    /**
+     * @brief               Queues every config of a simulation. Its results are read from the simulation
+     *
+     * @param simulation    Simulation to run
+     */
+    void Submit(Simulation& simulation);
+
+    /**
+     * @brief               Queues one config of a simulation, for callers that order the configs of several
+     * simulations themselves. Each config is submitted once
+     *
+     * @param simulation    Simulation to run the config of
+     * @param configIndex   Config to run
+     */
+    void Submit(Simulation& simulation, uint64_t configIndex);
+
+    /**
+     * @brief Get the number of workers
+     */
+    inline uint64_t GetNumWorkers() const;
+
+#ifdef _MSC_VER
+    /**
+     * @brief                   Worker of the pool. Simulates the configs queued until the pool stops
+     *
+     * @param pWorkerContext    void pointer of a PoolWorkerContext
+     *
+     * @return                  Status
+     */
+    static DWORD WINAPI RunWorker(void* pWorkerContext);
+#else
+    /**
+     * @brief                   Worker of the pool. Simulates the configs queued until the pool stops
+     *
+     * @param pWorkerContext    void pointer of a PoolWorkerContext
+     *
+     * @return                  None
+     */
+    static void* RunWorker(void* pWorkerContext);
+#endif
+
+  private:
+    /**
+     * @brief               Frees the memory of the worker's last config & takes the next config off the queue that fits
+     * in the memory budget, waits for one if there is none
+     *
+     * @param threadId      Worker
+     * @param workItem      Out. Config to simulate
+     * @return true         if there was a config, false once the pool stops
+     */
+    bool popWorkItem(uint64_t threadId, PoolWorkItem& workItem);
+
+    // Guards the work queue & the memory admitted. workAvailable_ is also signaled when a worker frees memory
+    Lock_t lock_;
+    Condition_t workAvailable_;
+    std::deque<PoolWorkItem> workQueue_;
+    bool isStopping_;
+    uint64_t memoryBudget_;
+    // Memory of the configs running, & of the config of each worker. Indexed by thread slot
+    uint64_t admittedBytes_;
+    std::vector<uint64_t> workerFootprints_;
+    // Indexed by thread slot
+    std::vector<Thread_t> workers_;
+    std::vector<PoolWorkerContext> workerContexts_;
+    std::vector<Arena> arenas_;
+};
+
+inline const std::string& Trace::GetFilename() const {
+    return filename_;
+}
+
+inline uint64_t Trace::GetNumInstructions() const {
+    return accesses_.instructionAccesses_.size();
+}
+
+inline MemoryAccessesView Trace::GetAccesses() const {
+    return accesses_.View();
+}
+
+inline uint64_t Simulation::GetNumConfigs() const {
+    return descriptors_.size();
+}
+
+inline const ConfigDescriptor& Simulation::GetDescriptor(uint64_t configIndex) const {
+    return descriptors_[configIndex];
+}
+
+inline const ConfigSummary& Simulation::GetSummary(uint64_t configIndex) const {
+    return summaries_[configIndex];
+}
+
+inline uint64_t WorkerPool::GetNumWorkers() const {
+    return workers_.size();
+}
@@ -1,14 +1,22 @@
 #pragma once
 
 #include <atomic>
+#include <map>
+#include <memory>
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
 
+#include "Arena.h"
 #include "Cache.h"
 #include "Multithreading.h"
+#include "ResultWriter.h"
+#include "SharedTrace.h"
+#include "Topology.h"
+#include "TraceFootprint.h"
 
 class Simulator;
+class SimTracer;
 
 enum CacheType {
     kDataCache,
@@ -17,50 +25,119 @@ enum CacheType {
 };
 
 struct SimCacheContext {
-    std::vector<Cache*> caches;
+    const ConfigDescriptor* pDescriptor;
+    // Trace arrays on the node of the worker
+    const MemoryAccessesView* pAccesses;
+    const std::vector<NextUseIndex>* pNextUseIndices;
+    // Out. Results of the config
+    ConfigSummary* pSummary;
+    // Out. Accesses issued so far, synced periodically for progress tracking
+    uint64_t* pAccessIndex;
+    // Sim trace the run is recorded to, null if it is not traced. Only set in SIM_TRACE builds
+    SimTracer* pSimTracer;
+    // Guards the sim trace file
+    Lock_t* pLock;
+    uint64_t threadId;
+    Arena* pArena;
+};
+
+struct WorkerContext {
+    Simulator* pSimulator;
+    uint64_t threadId;
+};
+
+// Copy of the trace arrays placed on one NUMA node
+struct TraceReplica {
+    MemoryAccesses accesses;
+    std::vector<NextUseIndex> nextUseIndices;
+};
+
+struct ReplicaContext {
     Simulator* pSimulator;
-    uint64_t configIndex;
+    uint64_t nodeIndex;
 };
 
 class Simulator {
   public:
-    Simulator(const char* inputFilename);
+    /**
+     * @brief                   Parses the trace & enumerates the configs of the sweep
+     *
+     * @param inputFilename     Trace file
+     * @param params            Parameters of the sweep, as read from the ini
+     * @param shardIndex        Shard of the sweep this process simulates
+     * @param numShards         Number of processes the sweep is split across
+     */
+    Simulator(const char* inputFilename, const TestParamaters& params, uint64_t shardIndex = 0,
+              uint64_t numShards = 1);
 
     ~Simulator();
 
 #ifdef _MSC_VER
     /**
-     * @brief                       Runs through all memory accesses with given setup cache
+     * @brief                   Worker of the thread pool. Simulates configs from the config queue until it is empty
+     *
+     * @param pWorkerContext    void pointer of a WorkerContext
+     *
+     * @return                  Status
+     */
+    static DWORD WINAPI RunWorker(void* pWorkerContext);
+#else
+    /**
+     * @brief                   Worker of the thread pool. Simulates configs from the config queue until it is empty
+     *
+     * @param pWorkerContext    void pointer of a WorkerContext
+     *
+     * @return                  None
+     */
+    static void* RunWorker(void* pWorkerContext);
+#endif
+
+#ifdef _MSC_VER
+    /**
+     * @brief                   Copies the trace arrays into the replica of a node, from a thread running on that node
+     * so that the copy is allocated there
      *
-     * @param pSimCacheContext      void pointer of a SimCacheContext
+     * @param pReplicaContext   void pointer of a ReplicaContext
      *
-     * @return                      Status
+     * @return                  Status
      */
-    static DWORD WINAPI SimCache(void* pSimCacheContext);
+    static DWORD WINAPI BuildTraceReplica(void* pReplicaContext);
 #else
     /**
-     * @brief                       Runs through all memory accesses with given setup cache
+     * @brief                   Copies the trace arrays into the replica of a node, from a thread running on that node
+     * so that the copy is allocated there
      *
-     * @param pSimCacheContext      void pointer of a SimCacheContext
+     * @param pReplicaContext   void pointer of a ReplicaContext
      *
-     * @return                      None
+     * @return                  None
      */
-    static void* SimCache(void* pSimCacheContext);
+    static void* BuildTraceReplica(void* pReplicaContext);
 #endif
 
     /**
-     * @brief Generate threads that will call sim_cache
+     * @brief Starts a pool of MAX_NUM_THREADS workers that simulate every config to test, and waits for them
      *
      */
     void CreateAndRunThreads();
 
     /**
-     * @brief               Print the statistics gathered in the simulations
+     * @brief                   Sets the outputs the results of every config are streamed to as it completes, see
+     * ResultWriter. Must be called before CreateAndRunThreads
+     *
+     * @param pTextStream       Text output stream, null if none
+     * @param pCSVStream        Comma separated value output stream, null if none
+     * @param pJSONStream       JSON lines output stream, null if none
+     * @param pColumnsStream    Columnar output stream, null if none
+     */
+    void SetResultStreams(FILE* pTextStream, FILE* pCSVStream, FILE* pJSONStream, FILE* pColumnsStream);
+
+    /**
+     * @brief               Writes the results of the configs of this shard, for cache-merge to combine with those of
+     * the other shards
      *
-     * @param pTextStream   Text file output stream
-     * @param pCSVStream    Comma separated value file output stream
+     * @param pStream       Output stream
      */
-    void PrintStats(FILE* pTextStream, FILE* pCSVStream);
+    void WritePartialResults(FILE* pStream);
 
 #ifdef _MSC_VER
     /**
@@ -90,19 +167,66 @@ class Simulator {
     /**
      * @brief Get accesses, a list of Instruction objects
      */
-    inline const MemoryAccesses& GetAccesses() const;
+    inline const MemoryAccessesView& GetAccesses() const;
+
+    /**
+     * @brief Get the summary of the results of a config
+     *
+     */
+    inline ConfigSummary& GetSummary(uint64_t index);
+
+    /**
+     * @brief                   Runs through all memory accesses with the caches of a config. Needs no Simulator, so
+     * any worker pool can run configs with it
+     *
+     * @param simCacheContext   Config to run & the thread slot to run it in
+     */
+    static void SimCache(const SimCacheContext& simCacheContext);
+
+    /**
+     * @brief               Get the arena memory SimCache needs to run a config
+     *
+     * @param descriptor    Config to run
+     * @return              Size in bytes
+     */
+    static uint64_t GetArenaSize(const ConfigDescriptor& descriptor);
+
+    /**
+     * @brief           Enumerates the configs an ini sweeps through, in the order their results are printed. Exits if
+     * one is invalid as told by Simulation::IsDescriptorValid
+     *
+     * @param params    Test parameters of the sweep
+     * @return          Configs of the sweep
+     */
+    static std::vector<ConfigDescriptor> EnumerateConfigs(const TestParamaters& params);
 
     /**
-     * @brief Get the cycle counter
+     * @brief               Get the key of the results of a config on a trace. Configs with the same key give the same
+     * results, so only one of them needs to be simulated
      *
+     * @param descriptor    Config
+     * @param footprint     Footprint of the trace
+     * @return              Per-level (block size, number of sets, associativity or 0 if conflict-free) + policy
      */
-    inline uint64_t& GetCycleCounter(uint64_t index);
+    static std::vector<uint64_t> GetResultKey(const ConfigDescriptor& descriptor, TraceFootprint& footprint);
 
     /**
-     * @brief Get the threads outstanding
+     * @brief               Estimates the cost of simulating a config, total sets x levels x trace length. Only the
+     * order of the estimates matters, measured run times rescale them per kind of config
      *
+     * @param descriptor    Config to estimate
+     * @param numAccesses   Length of the trace
+     * @return              Cost in arbitrary units
      */
-    inline std::vector<Thread_t>& GetThreadsOutstanding();
+    static double EstimateCost(const ConfigDescriptor& descriptor, uint64_t numAccesses);
+
+    /**
+     * @brief           Get the memory a run may use, MEMORY_BUDGET_MB or three quarters of the memory available if 0
+     *
+     * @param params    Test parameters of the run
+     * @return          Size in bytes, UINT64_MAX if unknown
+     */
+    static uint64_t GetMemoryBudget(const TestParamaters& params);
 
     /**
      * @brief Decrement the configs to test counter
@@ -118,60 +242,191 @@ class Simulator {
 
     Lock_t lock_;
 
-    static constexpr Thread_t kInvalidThreadId =
-#ifdef __GNUC__
-        static_cast<Thread_t>(UINT64_MAX);
-#elif defined(_MSC_VER)
-        reinterpret_cast<Thread_t>(UINT64_MAX);
-#endif
-
     static constexpr uint64_t kInvalidRequestIndex = UINT64_MAX;
 
     static constexpr uint64_t kDataAccessRequest = UINT64_MAX - 1;
 
     static constexpr uint64_t kProgressTrackerSyncPeriod = 1 << 14;
 
+    // Every config is simulated alongside the same instruction cache
+    static const Configuration kInstructionCacheConfig;
+
     static_assert(isPowerOfTwo(kProgressTrackerSyncPeriod), "Sync period must be power of two");
 
   private:
     /**
      *  @brief Recursive function to tell all cache configs
      * 
+     *  @param params           Test parameters of the sweep
      *  @param cacheLevel      the level of the cache this function will try to init
      *  @param minBlockSize     minimum block size this cache level will try to init
      *  @param minCacheSize     minimum cache size this cache level will try to init
+     *  @param configs          Config of every level above this one so far, this level's is filled in
+     *  @param descriptors      Out. Configs of the sweep, appended to
+     */
+    static void SetupCaches(const TestParamaters& params, CacheLevel cacheLevel, uint64_t minBlockSize,
+                            uint64_t minCacheSize, Configuration (&configs)[kMaxNumberOfCacheLevels],
+                            std::vector<ConfigDescriptor>& descriptors);
+
+    /**
+     *  @brief              Get every timing the ini sweeps a level through, access times & queue depths doubling
+     *
+     *  @param params       Test parameters of the sweep
+     *  @param cacheLevel   Level to get the timings of, main memory included
+     *  @return             Timings to test
+     */
+    static std::vector<LevelTiming> getTimingsToTest(const TestParamaters& params, CacheLevel cacheLevel);
+
+    /**
+     *  @brief                  Adds the descriptors of a full hierarchy, one per replacement policy under test
+     *
+     *  @param params           Test parameters of the sweep
+     *  @param pConfigs         Config of every cache level
+     *  @param mainMemoryTiming Timing of main memory
+     *  @param descriptors      Out. Configs of the sweep, appended to
+     */
+    static void addDescriptors(const TestParamaters& params, Configuration* pConfigs,
+                               const LevelTiming& mainMemoryTiming, std::vector<ConfigDescriptor>& descriptors);
+
+    /**
+     *  @brief Builds a next-use index for every block size under test, needed by kOPT caches
+     */
+    void buildNextUseIndices();
+
+    /**
+     * @brief Splits the configs to simulate across the shards, longest first onto the least loaded shard. Aliases go
+     * with the config they alias
+     */
+    void assignShards();
+
+    /**
+     * @brief               Get the expected run time of a config, its estimated cost scaled by the run time per unit
+     * of cost measured so far on configs of its kind. Kinds with nothing measured yet use the mean over all kinds
+     *
+     * @param configIndex   Config to predict
+     * @return              Expected run time, in seconds once anything was measured
+     */
+    double predictRunTime(uint64_t configIndex) const;
+
+    /**
+     * @brief               Reorders the configs left in the config queue longest first. Must hold lock_
+     */
+    void sortConfigQueue();
+
+    /**
+     * @brief               Records how long a config took to simulate and reorders the queue with it
+     *
+     * @param configIndex   Config that was simulated
+     * @param seconds       Wall time it took
      */
-    void SetupCaches(CacheLevel cacheLevel, uint64_t minBlockSize, uint64_t minCacheSize);
+    void recordRunTime(uint64_t configIndex, double seconds);
+
+    /**
+     * @brief               Takes the longest config off the config queue that fits in the memory budget next to the
+     * configs running on the other workers. Waits for one of them to finish if none fits. The arena of the worker is
+     * charged with the config until the worker takes another one
+     *
+     * @param threadId      Thread slot of the worker
+     * @param configIndex   Out. Index of the config to simulate
+     * @return true         if there was a config left
+     */
+    bool popQueuedConfig(uint64_t threadId, uint64_t& configIndex);
+
+    /**
+     * @brief Sets the memory budget of the configs to what is left of MEMORY_BUDGET_MB once the trace arrays are in
+     * memory, and prints it
+     */
+    void setMemoryBudget();
+
+    /**
+     * @brief                       Runs through all memory accesses with the caches of a config
+     *
+     * @tparam kNumDataCacheLevels  Number of data cache levels of the config
+     * @param context               Config to run & the thread slot to run it in
+     */
+    template <uint8_t kNumDataCacheLevels>
+    static void simulateConfig(const SimCacheContext& context);
 
     // Common across all threads
+    TestParamaters params_;
+    // Sim trace of the sweep, only in SIM_TRACE builds
+    SimTracer* pSimTracer_ = nullptr;
+    // Large buffers of the sweep, counted for its summary
+    HugePageUsage hugePageUsage_;
+    Topology topology_;
+    // Trace arrays parsed by this process, empty if they are shared with other processes
     MemoryAccesses accesses_;
-    std::vector<Thread_t> threads_;
-    std::vector<std::vector<std::unique_ptr<Cache>>> caches_;
-    std::vector<uint64_t> cycleCounters_;
-    std::vector<Thread_t> threadsOutstanding_;
+    SharedTrace sharedTrace_;
+    // Trace arrays in use, over accesses_ or the shared segment
+    MemoryAccessesView trace_;
+    std::vector<NextUseIndex> nextUseIndices_;
+    // Whether the workers are pinned to their NUMA nodes, only when they span more than one & the sweep is not sharded
+    bool isPinningWorkers_ = false;
+    // Indexed by NUMA node, only built when the workers are pinned
+    std::vector<TraceReplica> traceReplicas_;
+    TraceFootprint footprint_;
+    uint64_t shardIndex_;
+    uint64_t numShards_;
+    // Identity of the trace & the configs, shards of the same sweep have the same
+    uint64_t sweepFingerprint_;
+    // Indexed by thread slot
+    std::vector<Thread_t> workers_;
+    std::vector<WorkerContext> workerContexts_;
+    std::vector<ConfigDescriptor> descriptors_;
+    std::vector<ConfigSummary> summaries_;
+    // Indexed by thread slot, sized for the config running in the slot
+    std::vector<Arena> arenas_;
+    // Memory each config takes up while it runs, indexed by config
+    std::vector<uint64_t> footprints_;
+    // Memory the configs running at once may take up together
+    uint64_t memoryBudget_;
+    // Memory charged to the arena of each thread slot, & to all of them. Guarded by lock_
+    std::vector<uint64_t> workerFootprints_;
+    uint64_t admittedBytes_;
+    // Signaled when a worker gives back the memory of its last config, or the last config is handed out
+    Condition_t memoryReleased_;
+    uint64_t peakAdmittedBytes_;
     uint64_t numConfigs_;
+    // Configs the workers simulate, longest first, & the position of the next one to hand out. Guarded by lock_
+    std::vector<uint64_t> configQueue_;
+    uint64_t nextQueuedConfig_;
+    // Indexed by config
+    std::vector<double> estimatedCosts_;
+    // Run time & estimated cost of the configs simulated so far, per number of levels & replacement policy. Guarded
+    // by lock_
+    double measuredSeconds_[kMaxNumberOfCacheLevels + 1][kNumberOfReplacementPolicies];
+    double measuredCosts_[kMaxNumberOfCacheLevels + 1][kNumberOfReplacementPolicies];
+    // Index of the config whose results a config shares, its own index if it is simulated
+    std::vector<uint64_t> aliasOf_;
+    // Shard each config is simulated in, indexed by config
+    std::vector<uint64_t> shardOf_;
+    // Configs whose results this shard produces, aliases included, & the ones of them it simulates
+    uint64_t numConfigsInShard_;
+    uint64_t numConfigsSimulatedInShard_;
+    // Per-level (block size, number of sets, associativity or 0 if conflict-free) + policy -> index of first config
+    std::map<std::vector<uint64_t>, uint64_t> scheduledConfigs_;
+
+    // Outputs of the results, & the writer streaming them while the workers run
+    FILE* pTextStream_ = nullptr;
+    FILE* pCSVStream_ = nullptr;
+    FILE* pJSONStream_ = nullptr;
+    FILE* pColumnsStream_ = nullptr;
+    std::unique_ptr<ResultWriter> pResultWriter_;
 
-    // Note: No performance benefit is seen by limiting the
-    // number of outstanding threads. The only benefit is
-    // memory savings & keeping the computer usable when
-    // running with large numbers of configs
+    // Workers simulating a config right now
     std::atomic<int64_t> numThreadsOutstanding_;
     uint64_t configsToTest_;
     std::vector<uint64_t> accessIndices_;
 };
 
 inline uint64_t Simulator::GetNumAccesses() const {
-    return accesses_.instructionAccesses_.size();
-}
-
-inline const MemoryAccesses& Simulator::GetAccesses() const {
-    return accesses_;
+    return trace_.instructionAccesses_.size();
 }
 
-inline uint64_t& Simulator::GetCycleCounter(uint64_t index) {
-    return cycleCounters_[index];
+inline const MemoryAccessesView& Simulator::GetAccesses() const {
+    return trace_;
 }
 
-inline std::vector<Thread_t>& Simulator::GetThreadsOutstanding() {
-    return threadsOutstanding_;
+inline ConfigSummary& Simulator::GetSummary(uint64_t index) {
+    return summaries_[index];
 }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+constexpr uint64_t kCacheLineSizeInBytes = 64;
+
+// Storage unit of the tag stores, so that every array carved from it starts on its own cache line
+struct alignas(kCacheLineSizeInBytes) CacheLine {
+    uint8_t bytes[kCacheLineSizeInBytes];
+};
+
+/**
+ * @brief           Compares up to 64 tags at once
+ *
+ * @param pTags     Tags of the ways of a set
+ * @param tag       Tag to look for
+ * @param numWays   Number of tags to compare, at most 64
+ * @return          Bit i is set iff pTags[i] == tag
+ */
+inline uint64_t MatchTags(const uint64_t* pTags, uint64_t tag, uint64_t numWays) {
+    uint64_t matches = 0;
+    uint64_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi64x(static_cast<int64_t>(tag));
+    for (; i + 4 <= numWays; i += 4) {
+        __m256i ways = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pTags + i));
+        __m256i equal = _mm256_cmpeq_epi64(ways, needle);
+        matches |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(equal))) << i;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i needle = _mm_set1_epi64x(static_cast<int64_t>(tag));
+    for (; i + 2 <= numWays; i += 2) {
+        __m128i ways = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pTags + i));
+        // SSE2 only compares 32-bit lanes, a 64-bit lane is equal if both its halves are
+        __m128i equal = _mm_cmpeq_epi32(ways, needle);
+        equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        matches |= static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << i;
+    }
+#endif
+    for (; i < numWays; i++) {
+        matches |= static_cast<uint64_t>(pTags[i] == tag) << i;
+    }
+    return matches;
+}
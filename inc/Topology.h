@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// A NUMA node & the CPUs of it this process is allowed to run on
+struct NumaNode {
+    uint32_t nodeId;
+    std::vector<uint32_t> cpus;
+};
+
+/**
+ * CPU & NUMA topology of the machine, read from sysfs once by each owner, e.g. a sweep of ./cache. When the workers
+ * span more than one node they are spread round-robin over the nodes & pinned to all CPUs of theirs, so memory they
+ * touch first is allocated node-locally while the scheduler still balances them within the node. On a single node they
+ * are not pinned, so that processes sharing the host are not piled onto the same CPUs. On platforms without sysfs the
+ * machine is a single node with unknown CPUs
+ */
+class Topology {
+  public:
+    /**
+     * @brief Reads the topology
+     */
+    Topology();
+
+    /**
+     * @brief   Get the NUMA nodes that have at least one CPU this process may run on, in node order
+     *
+     * @return  At least one node
+     */
+    inline const std::vector<NumaNode>& GetNumaNodes() const {
+        return nodes_;
+    }
+
+    /**
+     * @brief               Get the index into GetNumaNodes() of the node a worker is placed on
+     *
+     * @param workerIndex   Index of the worker
+     * @return              Node index
+     */
+    uint64_t GetNodeIndexOfWorker(uint64_t workerIndex) const;
+
+    /**
+     * @brief               Tells whether workers get pinned, which is only when they span more than one node
+     *
+     * @param numWorkers    Number of workers that will run
+     * @return true         if the workers should be pinned with PinWorker
+     */
+    bool ShouldPinWorkers(uint64_t numWorkers) const;
+
+    /**
+     * @brief               Pins the calling thread to all CPUs of the node a worker is placed on
+     *
+     * @param workerIndex   Index of the worker
+     * @return true         if the thread was pinned
+     */
+    bool PinWorker(uint64_t workerIndex) const;
+
+    /**
+     * @brief               Pins the calling thread to all CPUs of a node
+     *
+     * @param nodeIndex     Index into GetNumaNodes() of the node
+     * @return true         if the thread was pinned
+     */
+    bool PinToNode(uint64_t nodeIndex) const;
+
+    /**
+     * @brief               Prints the nodes & their CPUs, and where the workers go
+     *
+     * @param numWorkers    Number of workers that will run
+     * @param isPinned      Whether the workers are pinned to their nodes
+     * @param stream        Output stream to print to
+     */
+    void PrintSummary(uint64_t numWorkers, bool isPinned, FILE* stream) const;
+
+  private:
+    std::vector<NumaNode> nodes_;
+};
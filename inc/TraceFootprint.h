@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+#include "Instruction.h"
+
+/**
+ * Statistics of the set of blocks a trace touches, used to find configs whose results are known without simulating
+ * them. Only data accesses are considered since only the data cache hierarchy is swept
+ */
+class TraceFootprint {
+  public:
+    TraceFootprint() = delete;
+
+    /**
+     * @brief               Construct a new Trace Footprint object. Statistics are computed on first use
+     *
+     * @param dataAccesses  Data accesses of the trace, must outlive this object
+     */
+    TraceFootprint(const InstructionSpan_t& dataAccesses);
+
+    /**
+     * @brief               Get the number of distinct blocks the trace touches
+     *
+     * @param blockSize     Block size in bytes
+     * @return              Number of distinct blocks
+     */
+    uint64_t GetNumberOfBlocks(uint64_t blockSize);
+
+    /**
+     * @brief               Get the highest number of distinct blocks of the trace that map to any single set. A cache
+     * with at least this many ways never has to replace a valid block
+     *
+     * @param blockSize     Block size in bytes
+     * @param numSets       Number of sets, power of 2
+     * @return              Highest number of distinct blocks in a set
+     */
+    uint64_t GetMaxBlocksPerSet(uint64_t blockSize, uint64_t numSets);
+
+    /**
+     * @brief           Prints the footprint for every block size looked at so far
+     *
+     * @param stream    Output stream to print to
+     */
+    void PrintSummary(FILE* stream) const;
+
+  private:
+    /**
+     * @brief               Get the sorted, distinct block addresses the trace touches
+     *
+     * @param blockSize     Block size in bytes
+     * @return              Block addresses
+     */
+    const std::vector<uint64_t>& getBlockAddresses(uint64_t blockSize);
+
+    const InstructionSpan_t& dataAccesses_;
+    std::map<uint64_t, std::vector<uint64_t>> blockAddresses_;
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> maxBlocksPerSet_;
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * C ABI of the library API of Simulation.h, for tools not written in C++. Traces, simulations & pools are opaque
+ * handles, the hierarchies & their statistics plain structs. Every function may be called from any thread
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHESIM_MAX_CACHE_LEVELS (3)
+
+typedef struct cachesim_trace cachesim_trace;
+typedef struct cachesim_simulation cachesim_simulation;
+typedef struct cachesim_pool cachesim_pool;
+
+typedef enum cachesim_replacement_policy {
+    CACHESIM_LRU,
+    CACHESIM_OPT, // Belady's MIN, needs the future of the trace. Only usable as a bound, & at L1 only
+} cachesim_replacement_policy;
+
+typedef struct cachesim_level_timing {
+    uint64_t access_time_in_cycles;
+    uint64_t max_outstanding_requests;
+} cachesim_level_timing;
+
+typedef struct cachesim_cache_config {
+    uint64_t cache_size;
+    uint64_t block_size;
+    uint64_t associativity;
+    cachesim_replacement_policy replacement_policy;
+    cachesim_level_timing timing;
+} cachesim_cache_config;
+
+// A data cache hierarchy, simulated alongside the instruction cache of ./cache
+typedef struct cachesim_hierarchy {
+    uint8_t number_of_cache_levels;
+    cachesim_cache_config levels[CACHESIM_MAX_CACHE_LEVELS];
+    cachesim_level_timing main_memory_timing;
+} cachesim_hierarchy;
+
+typedef struct cachesim_statistics {
+    uint64_t read_hits;
+    uint64_t read_misses;
+    uint64_t write_hits;
+    uint64_t write_misses;
+    uint64_t writebacks;
+    // Cycles from issue to completion of the requests of the level, set conflict retries included
+    uint64_t latency_p50;
+    uint64_t latency_p90;
+    uint64_t latency_p99;
+    uint64_t latency_max;
+} cachesim_statistics;
+
+typedef struct cachesim_result {
+    cachesim_statistics levels[CACHESIM_MAX_CACHE_LEVELS];
+    uint64_t number_of_instructions;
+    uint64_t cycles;
+    double cpi;
+} cachesim_result;
+
+/**
+ * @brief           Parses a trace file into memory
+ *
+ * @param filename  Trace file
+ * @return          The trace, NULL if the file cannot be read or has a malformed line
+ */
+cachesim_trace* cachesim_trace_load(const char* filename);
+
+/**
+ * @brief           Get the number of instructions in a trace
+ */
+uint64_t cachesim_trace_get_num_instructions(const cachesim_trace* trace);
+
+/**
+ * @brief           Releases a trace. The simulations of it keep it in memory until they are freed
+ */
+void cachesim_trace_free(cachesim_trace* trace);
+
+/**
+ * @brief                           Fills in a hierarchy with the default timings of ./cache & LRU replacement
+ *
+ * @param hierarchy                 Out. Hierarchy to fill in the cache sizes of
+ * @param number_of_cache_levels    Number of data cache levels
+ */
+void cachesim_hierarchy_init(cachesim_hierarchy* hierarchy, uint8_t number_of_cache_levels);
+
+/**
+ * @brief               Checks that a hierarchy can be simulated
+ *
+ * @param hierarchy     Hierarchy to check
+ * @param error         Out. Reason the hierarchy is invalid, may be NULL
+ * @param error_size    Size of error
+ * @return              1 if the hierarchy is valid, 0 otherwise
+ */
+int cachesim_hierarchy_validate(const cachesim_hierarchy* hierarchy, char* error, size_t error_size);
+
+/**
+ * @brief                   Sets up the simulation of hierarchies over a trace, nothing is simulated yet
+ *
+ * @param trace             Trace to simulate
+ * @param hierarchies       Hierarchies to simulate
+ * @param num_hierarchies   Number of hierarchies
+ * @param error             Out. Reason the simulation could not be set up, may be NULL
+ * @param error_size        Size of error
+ * @return                  The simulation, NULL if a hierarchy is invalid
+ */
+cachesim_simulation* cachesim_simulation_create(cachesim_trace* trace, const cachesim_hierarchy* hierarchies,
+                                                size_t num_hierarchies, char* error, size_t error_size);
+
+/**
+ * @brief               Simulates every hierarchy on the calling thread, returns once all are done
+ */
+void cachesim_simulation_run(cachesim_simulation* simulation);
+
+/**
+ * @brief               Simulates one hierarchy on the calling thread, for callers running them on a thread pool of
+ * their own. Hierarchies may run concurrently on any threads, each once
+ *
+ * @param simulation    Simulation
+ * @param index         Hierarchy to simulate
+ */
+void cachesim_simulation_run_one(cachesim_simulation* simulation, size_t index);
+
+/**
+ * @brief               Waits for every hierarchy of a simulation to complete
+ */
+void cachesim_simulation_wait(cachesim_simulation* simulation);
+
+/**
+ * @brief               Get the results of a hierarchy, once it completed
+ *
+ * @param simulation    Simulation
+ * @param index         Hierarchy
+ * @param result        Out. Statistics of every level, cycles & CPI
+ */
+void cachesim_simulation_get_result(const cachesim_simulation* simulation, size_t index, cachesim_result* result);
+
+/**
+ * @brief               Frees a simulation, once every hierarchy of it completed
+ */
+void cachesim_simulation_free(cachesim_simulation* simulation);
+
+/**
+ * @brief               Starts a pool of workers simulations can be submitted to
+ *
+ * @param num_workers   Number of workers
+ * @return              The pool
+ */
+cachesim_pool* cachesim_pool_create(uint64_t num_workers);
+
+/**
+ * @brief               Queues every hierarchy of a simulation on a pool, wait for them with cachesim_simulation_wait
+ */
+void cachesim_pool_submit(cachesim_pool* pool, cachesim_simulation* simulation);
+
+/**
+ * @brief               Runs the simulations submitted to a pool to completion, then frees it
+ */
+void cachesim_pool_free(cachesim_pool* pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,3 +8,5 @@
 #define MIN_ASSOCIATIVITY   (1)
 #define MAX_ASSOCIATIVITY   (2)
 #define MAX_NUM_THREADS     (12) // -1 for no limit
+#define REPLACEMENT_POLICY  "LRU" // LRU, OPT or BOTH. OPT is at L1 only. BOTH reports how far LRU is from OPT
+#define MEMORY_BUDGET_MB    (0) // 0 for 3/4 of the memory available to the process
@@ -2,84 +2,101 @@
 
 #include <stdint.h>
 
-struct DoubleListElement {
-    DoubleListElement* pPrevious_;
-    DoubleListElement* pNext_;
-    uint64_t poolIndex_;
+// Links of one slot of a pool. A slot is in at most one IndexList at a time, so one node per slot serves every list
+// over the pool
+struct IndexListNode {
+    uint32_t previous;
+    uint32_t next;
 };
 
-class DoubleList {
+// Doubly linked list of pool slots, threaded through the pool's IndexListNodes. Does not own the nodes. Every operation
+// is O(1)
+class IndexList {
   public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
     /**
-     * @brief Construct a new Double List object
+     * @brief Construct a new empty Index List object
      *
-     * @param capacity Maximum capacity of this list
+     * @param pNodes    Nodes of the pool, indexed by slot
+     * @param capacity  Maximum capacity of this list
      */
-    DoubleList(uint64_t capacity);
-
-    DoubleList(const DoubleList&) = delete;
-
-    DoubleList operator=(const DoubleList&) = delete;
+    IndexList(IndexListNode* pNodes, uint64_t capacity);
 
     /**
-     * @brief Destroy the Double List object
+     * @brief           Removes a slot from the list
      *
+     * @param index     Slot to remove, must be in this list
      */
-    ~DoubleList();
+    void Remove(uint64_t index);
 
     /**
-     * @brief           Looks for a specific element in a list and removes it if extant
+     * @brief           Adds slot to the end of a list if it has room
      *
-     * @param pElement  Element to search for
-     * @return true     if element was found & removed
+     * @param index     Slot to add, must not be in any list
+     * @return true     if there was room & slot was added
      */
-    bool RemoveElement(DoubleListElement* pElement);
+    bool PushBack(uint64_t index);
 
     /**
-     * @brief           Adds element to the end of a list if it has room
+     * @brief           Adds slot to head of a list if it has room
      *
-     * @param pElement  Element to add
-     * @return true     if there was room & element was added
+     * @param index     Slot to add, must not be in any list
+     * @return true     if there was room & slot was added
      */
-    bool AddElementToTail(DoubleListElement* pElement);
+    bool PushFront(uint64_t index);
 
     /**
-     * @brief           Adds element to head of a list if it has room
+     * @brief           Inserts a slot right after another slot of the list
      *
-     * @param pElement  Element to add
-     * @return true     if there was room & element was added
+     * @param index     Slot to insert, must not be in any list. The list must have room for it
+     * @param previous  Slot of this list to insert after, kNone to insert at the head
      */
-    bool PushElement(DoubleListElement* pElement);
+    void InsertAfter(uint64_t index, uint64_t previous);
 
     /**
-     * @brief       Removes element from head of list and returns it
+     * @brief       Removes slot from head of list and returns it
      *
-     * @return      Pointer to element if there is one, nullptr otherwise
+     * @return      Slot if there is one, kNone otherwise
      */
-    DoubleListElement* PopElement();
+    uint64_t PopFront();
+
+    inline uint64_t PeekFront() const {
+        return head_;
+    }
+
+    inline uint64_t PeekBack() const {
+        return tail_;
+    }
+
+    inline uint64_t GetNext(uint64_t index) const {
+        return pNodes_[index].next;
+    }
 
-    DoubleListElement* PeekHead() {
-        return pHead_;
+    inline uint64_t GetPrevious(uint64_t index) const {
+        return pNodes_[index].previous;
     }
 
-    inline uint64_t GetCount() {
+    inline uint64_t GetCount() const {
         return count_;
     }
 
-    inline uint64_t GetCapacity() {
+    inline uint64_t GetCapacity() const {
         return capacity_;
     }
 
   private:
-    DoubleListElement* pHead_;
-    DoubleListElement* pTail_;
+    IndexListNode* pNodes_;
+    uint32_t head_;
+    uint32_t tail_;
     uint64_t count_;
     uint64_t capacity_;
 };
 
-#define for_each_in_double_list(list)                                                                                  \
-    DoubleListElement* elementIterator = list->PeekHead();                                                             \
-    DoubleListElement* nextElement = elementIterator ? elementIterator->pNext_ : nullptr;                              \
-    for (uint64_t poolIndex = elementIterator ? elementIterator->poolIndex_ : 0; elementIterator != nullptr;           \
-         elementIterator = nextElement, nextElement = elementIterator ? elementIterator->pNext_ : nullptr,             \
-                  poolIndex = elementIterator ? elementIterator->poolIndex_ : 0)
+// The body may move the current slot to another list, the next slot is read before the body runs
+#define for_each_in_index_list(list)                                                                                   \
+    for (uint64_t poolIndex = (list)->PeekFront(),                                                                     \
+                  nextPoolIndex = poolIndex == IndexList::kNone ? IndexList::kNone : (list)->GetNext(poolIndex);       \
+         poolIndex != IndexList::kNone;                                                                                \
+         poolIndex = nextPoolIndex,                                                                                    \
+                  nextPoolIndex = poolIndex == IndexList::kNone ? IndexList::kNone : (list)->GetNext(poolIndex))
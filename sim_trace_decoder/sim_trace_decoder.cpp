@@ -102,6 +102,9 @@ int main(int argc, char* argv[]) {
                                        pConfigs[j].cacheSize, pConfigs[j].blockSize, pConfigs[j].associativity);
             pOutputFilenameBegin += bytesWritten;
         }
+        if (pConfigs[0].replacementPolicy == kOPT) {
+            pOutputFilenameBegin += sprintf(pOutputFilenameBegin, "_OPT");
+        }
         sprintf(pOutputFilenameBegin, ".txt");
         pOutputFile = fopen(outputFilenameBuffer, "w");
         assert(pOutputFile);
@@ -0,0 +1,16 @@
+#include "Arena.h"
+
+void Arena::Resize(uint64_t capacityInBytes) {
+    const uint64_t numLines = (capacityInBytes + kCacheLineSizeInBytes - 1) / kCacheLineSizeInBytes;
+    if (numLines != storage_.size()) {
+        // Free the old memory first, the two together may not fit in the memory budget
+        Release();
+        storage_ = std::vector<CacheLine, HugePageAllocator<CacheLine>>(numLines, storage_.get_allocator());
+    }
+    usedLines_ = 0;
+}
+
+void Arena::Release() {
+    std::vector<CacheLine, HugePageAllocator<CacheLine>>(storage_.get_allocator()).swap(storage_);
+    usedLines_ = 0;
+}
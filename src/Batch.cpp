@@ -0,0 +1,318 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <tuple>
+
+#include "Batch.h"
+#include "IOUtilities.h"
+#include "Simulator.h"
+#include "TraceFootprint.h"
+#include "debug.h"
+
+Batch::Batch(const TestParamaters& params) : params_(params) {
+    descriptors_ = Simulator::EnumerateConfigs(params_);
+}
+
+bool Batch::AddTrace(const char* pArgument) {
+    BatchTrace trace;
+    trace.filename = pArgument;
+    trace.weight = 1;
+    // A suffix that is not a number is part of the file name
+    const char* pWeight = strrchr(pArgument, '@');
+    if (pWeight) {
+        char* pEnd = nullptr;
+        const double weight = strtod(pWeight + 1, &pEnd);
+        if (pEnd != pWeight + 1 && *pEnd == '\0') {
+            if (!(weight > 0) || !isfinite(weight)) {
+                return false;
+            }
+            trace.filename.resize(pWeight - pArgument);
+            trace.weight = weight;
+        }
+    }
+    traces_.push_back(std::move(trace));
+    return true;
+}
+
+/**
+ * @brief               Get the size of a file
+ *
+ * @param pFilename     File
+ * @return              Size in bytes, 0 if it cannot be opened
+ */
+static uint64_t getFileSize(const char* pFilename) {
+    FILE* pFile = fopen(pFilename, "r");
+    if (pFile == nullptr) {
+        return 0;
+    }
+    long size = -1;
+    if (fseek(pFile, 0, SEEK_END) == 0) {
+        size = ftell(pFile);
+    }
+    fclose(pFile);
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
+#ifdef _MSC_VER
+DWORD WINAPI Batch::LoadTraces(void* pBatch) {
+#else
+void* Batch::LoadTraces(void* pBatch) {
+#endif
+    Batch& batch = *static_cast<Batch*>(pBatch);
+    Multithreading::Lock(&batch.loadLock_);
+    while (batch.nextTraceToLoad_ < batch.traces_.size()) {
+        BatchTrace& trace = batch.traces_[batch.nextTraceToLoad_++];
+        // Charged with the file contents & at most two arrays entries per line while parsed, with its arrays after
+        const uint64_t fileBytes = getFileSize(trace.filename.c_str());
+        const uint64_t loadBytes = fileBytes + fileBytes / kFileLineLengthInBytes * 2 * sizeof(Instruction);
+        // A trace over the budget on its own is parsed once nothing else is
+        while (batch.numLoadsInFlight_ && batch.chargedBytes_ + loadBytes > batch.memoryBudget_) {
+            Multithreading::WaitForCondition(&batch.loadCompleted_, &batch.loadLock_);
+        }
+        batch.chargedBytes_ += loadBytes;
+        batch.numLoadsInFlight_++;
+        Multithreading::Unlock(&batch.loadLock_);
+
+        batch.loadTrace(trace);
+
+        Multithreading::Lock(&batch.loadLock_);
+        batch.chargedBytes_ -= loadBytes;
+        if (trace.pTrace) {
+            const MemoryAccessesView accesses = trace.pTrace->GetAccesses();
+            batch.chargedBytes_ +=
+                (accesses.dataAccesses_.size() + accesses.instructionAccesses_.size()) * sizeof(Instruction);
+        }
+        batch.numLoadsInFlight_--;
+        Multithreading::WakeAll(&batch.loadCompleted_);
+    }
+    Multithreading::Unlock(&batch.loadLock_);
+#ifdef _MSC_VER
+    return 0;
+#else
+    pthread_exit(NULL);
+    return nullptr;
+#endif
+}
+
+void Batch::loadTrace(BatchTrace& trace) const {
+    trace.pTrace = Trace::Load(trace.filename.c_str());
+    if (trace.pTrace) {
+        // Configs with the same results on this trace are simulated once, as in a single-trace run
+        const MemoryAccessesView accesses = trace.pTrace->GetAccesses();
+        TraceFootprint footprint(accesses.dataAccesses_);
+        std::map<std::vector<uint64_t>, uint64_t> simulatedConfigs;
+        std::vector<ConfigDescriptor> simulatedDescriptors;
+        for (const ConfigDescriptor& descriptor : descriptors_) {
+            const std::vector<uint64_t> resultKey = Simulator::GetResultKey(descriptor, footprint);
+            auto simulatedConfig = simulatedConfigs.try_emplace(resultKey, simulatedDescriptors.size());
+            if (simulatedConfig.second) {
+                simulatedDescriptors.push_back(descriptor);
+            }
+            trace.simulatedIndexOf.push_back(simulatedConfig.first->second);
+        }
+        trace.pSimulation = std::make_unique<Simulation>(trace.pTrace, std::move(simulatedDescriptors));
+    }
+}
+
+int Batch::Run(const char* pOutputFilename) {
+    FILE* pTextStream = fopen(pOutputFilename, "w");
+    if (pTextStream == nullptr) {
+        fprintf(stderr, "Unable to open output file %s\n", pOutputFilename);
+        return 1;
+    }
+
+    int64_t numWorkers = params_.maxNumberOfThreads;
+    if (numWorkers < 0) {
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The traces are parsed by up to one loader per worker, each taking the next trace left
+    Multithreading::InitializeLock(&loadLock_);
+    Multithreading::InitializeCondition(&loadCompleted_);
+    nextTraceToLoad_ = 0;
+    numLoadsInFlight_ = 0;
+    memoryBudget_ = Simulator::GetMemoryBudget(params_);
+    chargedBytes_ = 0;
+    std::vector<Thread_t> loaders(std::min(static_cast<uint64_t>(numWorkers), traces_.size()));
+    for (Thread_t& loader : loaders) {
+        Multithreading::StartThread(Batch::LoadTraces, static_cast<void*>(this), &loader);
+    }
+    Multithreading::WaitForThreads(loaders);
+    int status = 0;
+    for (const BatchTrace& trace : traces_) {
+        if (trace.pTrace == nullptr) {
+            fprintf(stderr, "Unable to open trace %s\n", trace.filename.c_str());
+            status = 1;
+            continue;
+        }
+        if (trace.pTrace->GetNumInstructions() == 0) {
+            // It would have no CPI to weigh into the suite's
+            fprintf(stderr, "Trace %s has no instructions\n", trace.filename.c_str());
+            status = 1;
+            continue;
+        }
+        printf("Parsed %s: %" PRIu64 " instructions, %" PRIu64 " of %zu configs to simulate, weight %g\n",
+               trace.filename.c_str(), trace.pTrace->GetNumInstructions(), trace.pSimulation->GetNumConfigs(),
+               descriptors_.size(), trace.weight);
+    }
+    if (status != 0) {
+        fclose(pTextStream);
+        return status;
+    }
+    // The configs running at once take up what the parsed traces leave of the budget
+    const uint64_t configsMemoryBudget = memoryBudget_ > chargedBytes_ ? memoryBudget_ - chargedBytes_ : 0;
+    if (memoryBudget_ != UINT64_MAX) {
+        constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+        printf("Memory budget %.1f MiB, %.1f MiB of it for the traces, %.1f MiB for the configs running at once\n",
+               memoryBudget_ / kBytesPerMegabyte, chargedBytes_ / kBytesPerMegabyte,
+               configsMemoryBudget / kBytesPerMegabyte);
+        if (chargedBytes_ > memoryBudget_) {
+            printf("WARNING: The traces do not fit in the memory budget together, each config will run on its own\n");
+        }
+    }
+    {
+        // The whole matrix is queued longest first, so that the long configs of every trace start early and the pool
+        // does not drain on them at the end
+        std::vector<std::tuple<double, uint64_t, uint64_t>> workItems;
+        for (uint64_t traceIndex = 0; traceIndex < traces_.size(); traceIndex++) {
+            const Simulation& simulation = *traces_[traceIndex].pSimulation;
+            for (uint64_t configIndex = 0; configIndex < simulation.GetNumConfigs(); configIndex++) {
+                const double cost = Simulator::EstimateCost(simulation.GetDescriptor(configIndex),
+                                                            traces_[traceIndex].pTrace->GetNumInstructions());
+                workItems.emplace_back(cost, traceIndex, configIndex);
+            }
+        }
+        std::stable_sort(workItems.begin(), workItems.end(),
+                         [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+        printf("Simulating %zu configs over %zu traces on %" PRId64 " workers\n", workItems.size(), traces_.size(),
+               numWorkers);
+        fflush(stdout);
+        WorkerPool pool(numWorkers, configsMemoryBudget);
+        for (const auto& workItem : workItems) {
+            pool.Submit(*traces_[std::get<1>(workItem)].pSimulation, std::get<2>(workItem));
+        }
+        for (const BatchTrace& trace : traces_) {
+            trace.pSimulation->Wait();
+            printf("Simulated %s\n", trace.filename.c_str());
+            fflush(stdout);
+        }
+    }
+
+    for (uint64_t traceIndex = 0; traceIndex < traces_.size(); traceIndex++) {
+        const BatchTrace& trace = traces_[traceIndex];
+        std::vector<ConfigSummary> summaries;
+        for (uint64_t configIndex = 0; configIndex < descriptors_.size(); configIndex++) {
+            summaries.push_back(trace.pSimulation->GetSummary(trace.simulatedIndexOf[configIndex]));
+        }
+        std::string csvOutputFilename(pOutputFilename);
+        csvOutputFilename.append(".trace" + std::to_string(traceIndex) + ".csv");
+        FILE* pCSVStream = fopen(csvOutputFilename.c_str(), "w");
+        fprintf(pTextStream, "#########################\n");
+        fprintf(pTextStream, "TRACE %" PRIu64 ": %s, weight %g\n", traceIndex, trace.filename.c_str(), trace.weight);
+        fprintf(pTextStream, "#########################\n\n");
+        IOUtilities::PrintResults(descriptors_, summaries, params_.compareToOptimal, pTextStream, pCSVStream);
+        fprintf(pTextStream, "\n");
+        if (pCSVStream) {
+            fclose(pCSVStream);
+        }
+    }
+
+    std::string csvOutputFilename(pOutputFilename);
+    csvOutputFilename.append(".csv");
+    FILE* pCSVStream = fopen(csvOutputFilename.c_str(), "w");
+    printSuiteResults(pTextStream, pCSVStream);
+    if (pCSVStream) {
+        fclose(pCSVStream);
+    }
+    fclose(pTextStream);
+    return 0;
+}
+
+void Batch::printSuiteResults(FILE* pTextStream, FILE* pCSVStream) const {
+    const uint8_t numberOfCacheLevels = params_.numberOfCacheLevels;
+    double totalWeight = 0;
+    for (const BatchTrace& trace : traces_) {
+        totalWeight += trace.weight;
+    }
+    if (pCSVStream) {
+        fprintf(pCSVStream, "Config,");
+        // Levels numbered from 1 as in the csv of a single run
+        for (int i = 1; i <= numberOfCacheLevels; i++) {
+            fprintf(pCSVStream, "L%d cache size,L%d block size,L%d associativity,L%d replacement policy,L%d access "
+                                "time,L%d max outstanding requests,L%d weighted miss rate,", i, i, i, i, i, i, i);
+        }
+        fprintf(pCSVStream, "Main memory access time,Main memory max outstanding requests,Weighted CPI\n");
+    }
+    fprintf(pTextStream, "#########################\n");
+    fprintf(pTextStream, "SUITE OF %zu TRACES, WEIGHTED MEAN OVER THE TRACES\n", traces_.size());
+    fprintf(pTextStream, "#########################\n\n");
+
+    double minCpi = INFINITY;
+    uint64_t min_i = 0;
+    for (uint64_t configIndex = 0; configIndex < descriptors_.size(); configIndex++) {
+        const ConfigDescriptor& descriptor = descriptors_[configIndex];
+        // Each trace counts by its weight whatever its length, like the phases of a SimPoint suite
+        double cpi = 0;
+        double missRates[kMaxNumberOfCacheLevels] = {};
+        // Weight of the traces that reach each level, a trace no access of which gets to a level has no miss rate
+        // there & does not count towards its mean
+        double levelWeights[kMaxNumberOfCacheLevels] = {};
+        for (const BatchTrace& trace : traces_) {
+            const ConfigSummary& summary = trace.pSimulation->GetSummary(trace.simulatedIndexOf[configIndex]);
+            cpi += trace.weight * static_cast<double>(summary.cycles) / summary.stats[kL1].numInstructions;
+            for (uint8_t i = 0; i < numberOfCacheLevels; i++) {
+                const Statistics& stats = summary.stats[i];
+                const uint64_t numberOfAccesses =
+                    stats.readHits + stats.readMisses + stats.writeHits + stats.writeMisses;
+                if (numberOfAccesses) {
+                    missRates[i] += trace.weight * static_cast<double>(stats.readMisses + stats.writeMisses) /
+                                    static_cast<double>(numberOfAccesses);
+                    levelWeights[i] += trace.weight;
+                }
+            }
+        }
+        cpi /= totalWeight;
+
+        fprintf(pTextStream, "CONFIG %" PRIu64 "\n", configIndex);
+        IOUtilities::PrintConfiguration(descriptor, pTextStream);
+        if (pCSVStream) {
+            fprintf(pCSVStream, "%" PRIu64 ",", configIndex);
+        }
+        for (uint8_t i = 0; i < numberOfCacheLevels; i++) {
+            const Configuration& config = descriptor.configs[i];
+            if (levelWeights[i] > 0) {
+                missRates[i] /= levelWeights[i];
+            }
+            fprintf(pTextStream, "Weighted miss rate of level %d: %7.3f%%\n", i, 100.0 * missRates[i]);
+            if (pCSVStream) {
+                fprintf(pCSVStream, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s,%" PRIu64 ",%" PRIu64 ",%7.3f%%,",
+                        config.cacheSize, config.blockSize, config.associativity,
+                        kReplacementPolicyNames[config.replacementPolicy], config.timing.accessTimeInCycles,
+                        config.timing.maxOutstandingRequests, 100.0 * missRates[i]);
+            }
+        }
+        fprintf(pTextStream, "Weighted CPI: %.4f\n\n", cpi);
+        if (pCSVStream) {
+            fprintf(pCSVStream, "%" PRIu64 ",%" PRIu64 ",%.4f\n", descriptor.mainMemoryTiming.accessTimeInCycles,
+                    descriptor.mainMemoryTiming.maxOutstandingRequests, cpi);
+        }
+        // The kOPT twins are bounds rather than buildable configs, as in PrintResults
+        if (params_.compareToOptimal && (configIndex & 1)) {
+            continue;
+        }
+        if (cpi < minCpi) {
+            minCpi = cpi;
+            min_i = configIndex;
+        }
+    }
+    fprintf(pTextStream, "The config with the lowest weighted CPI over the suite, %.4f:\n", minCpi);
+    IOUtilities::PrintConfiguration(descriptors_[min_i], pTextStream);
+    printf("The config with the lowest weighted CPI over the suite is config %" PRIu64 ", %.4f\n", min_i, minCpi);
+}
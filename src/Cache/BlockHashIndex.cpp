@@ -0,0 +1,46 @@
+#include "BlockHashIndex.h"
+
+#include <assert.h>
+#include <bit>
+
+void BlockHashIndex::Reset(uint64_t numBlocks, Arena& arena) {
+    const uint64_t numEntries = std::bit_ceil(2 * numBlocks);
+    entries_ = arena.Allocate<Entry>(numEntries);
+    for (uint64_t i = 0; i < numEntries; i++) {
+        entries_[i].way = kNotFound;
+    }
+    mask_ = numEntries - 1;
+    shift_ = 64 - static_cast<uint64_t>(std::countr_zero(numEntries));
+}
+
+void BlockHashIndex::Clear() {
+    entries_ = nullptr;
+}
+
+uint64_t BlockHashIndex::GetArenaSize(uint64_t numBlocks) {
+    return Arena::GetAllocationSize<Entry>(std::bit_ceil(2 * numBlocks));
+}
+
+void BlockHashIndex::Insert(uint64_t blockAddress, uint32_t way) {
+    uint64_t i = hash(blockAddress);
+    for (; entries_[i].way != kNotFound; i = (i + 1) & mask_) {
+        assert(entries_[i].blockAddress != blockAddress);
+    }
+    entries_[i] = Entry{blockAddress, way};
+}
+
+void BlockHashIndex::Erase(uint64_t blockAddress) {
+    uint64_t hole = hash(blockAddress);
+    for (; entries_[hole].blockAddress != blockAddress || entries_[hole].way == kNotFound; hole = (hole + 1) & mask_) {
+        assert(entries_[hole].way != kNotFound);
+    }
+    // Shift back every following entry of the run that would no longer be reachable across the hole
+    for (uint64_t i = (hole + 1) & mask_; entries_[i].way != kNotFound; i = (i + 1) & mask_) {
+        const uint64_t home = hash(entries_[i].blockAddress);
+        if (((i - home) & mask_) >= ((i - hole) & mask_)) {
+            entries_[hole] = entries_[i];
+            hole = i;
+        }
+    }
+    entries_[hole].way = kNotFound;
+}
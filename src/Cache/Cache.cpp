@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <inttypes.h>
-#include <memory>
+#include <algorithm>
+#include <bit>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -12,13 +13,6 @@
 #include "debug.h"
 #include "list.h"
 
-#if (SIM_TRACE == 1)
-extern SimTracer* gSimTracer;
-#else
-extern SimTracer dummySimTracer;
-extern SimTracer* gSimTracer;
-#endif
-
 #if (CONSOLE_PRINT == 1)
 #define DEBUG_TRACE printf
 #else
@@ -29,9 +23,8 @@ extern SimTracer* gSimTracer;
 //          Public Functions
 // =====================================
 
-Cache::Cache(Cache* pUpperCache, CacheLevel cacheLevel, uint8_t numCacheLevels, Configuration* pCacheConfigs)
-    : Memory(pUpperCache, cacheLevel), config_(pCacheConfigs[cacheLevel]) {
-    Configuration cacheConfig = pCacheConfigs[cacheLevel];
+Cache::Cache(CacheLevel cacheLevel, const Configuration& cacheConfig)
+    : Memory(cacheLevel, cacheConfig.timing), config_(cacheConfig) {
     blockSizeBits_ = 0;
     uint64_t tmp = config_.blockSize;
     for (; (tmp & 1) == 0; tmp >>= 1) {
@@ -47,42 +40,97 @@ Cache::Cache(Cache* pUpperCache, CacheLevel cacheLevel, uint8_t numCacheLevels,
     numSets_ = numBlocks / config_.associativity;
     assert_release(isPowerOfTwo(numSets_) && "Number of sets must be a power of 2");
     blockAddressToSetIndexMask_ = numSets_ - 1;
+    pHandleAccess_ = &Cache::handleAccess<kGenericAssociativity>;
+    pResolveHit_ = &Cache::resolveHit<kGenericAssociativity>;
+    for (uint64_t i = 0; i < kNumberOfSpecializedAssociativities; i++) {
+        if (config_.associativity == (1ULL << i)) {
+            pHandleAccess_ = kSpecializedHandleAccessFunctions[i];
+            pResolveHit_ = kSpecializedResolveHitFunctions[i];
+        }
+    }
     earliestNextUsefulCycle_ = UINT64_MAX;
-    if (cacheLevel < numCacheLevels - 1) {
-        pLowerCache_ =
-            std::make_unique<Cache>(this, static_cast<CacheLevel>(cacheLevel + 1), numCacheLevels, pCacheConfigs);
-    } else {
-        pLowerCache_ = std::make_unique<Memory>(this, kMainMemory);
+}
+
+void Cache::AllocateMemory(Arena& arena) {
+    const uint64_t numBlocks = numSets_ * config_.associativity;
+    const bool isLRUPacked = config_.associativity <= kMaxPackedLRUAssociativity;
+    maskWordsPerSet_ = (config_.associativity + 63) / 64;
+    // Value-initialized, so every block starts out invalid, clean & with a tag of 0, and every set not busy
+    tags_ = arena.Allocate<uint64_t>(numBlocks);
+    validMasks_ = arena.Allocate<uint64_t>(numSets_ * maskWordsPerSet_);
+    dirtyMasks_ = arena.Allocate<uint64_t>(numSets_ * maskWordsPerSet_);
+    packedLRUs_ = isLRUPacked ? arena.Allocate<PackedLRU_t>(numSets_) : nullptr;
+    lruNodes_ = isLRUPacked ? nullptr : arena.Allocate<IntrusiveLRUNode>(numBlocks);
+    lruEnds_ = isLRUPacked ? nullptr : arena.Allocate<IntrusiveLRUEnds>(numSets_);
+    busySets_ = arena.Allocate<bool>(numSets_);
+    busyRequestsPerSet_ = arena.Allocate<uint16_t>(numSets_);
+    wakeableBusyRequests_ = 0;
+    nextUses_ = config_.replacementPolicy == kOPT ? arena.Allocate<uint32_t>(numBlocks) : nullptr;
+    const PackedLRU_t initialPackedLRU = PackedLRUInit(config_.associativity);
+    for (uint64_t i = 0; packedLRUs_ && i < numSets_; i++) {
+        packedLRUs_[i] = initialPackedLRU;
+    }
+    for (uint64_t i = 0; lruNodes_ && i < numSets_; i++) {
+        IntrusiveLRUInit(getLRUNodes(i), lruEnds_[i], config_.associativity);
+    }
+    if (config_.associativity > kMaxScannedAssociativity) {
+        blockHashIndex_.Reset(numBlocks, arena);
+    }
+    for (uint64_t i = 0; nextUses_ && i < numBlocks; i++) {
+        nextUses_[i] = NextUseIndex::kNoNextUse;
     }
-    pMainMemory_ = pLowerCache_.get();
-    for (; pMainMemory_->GetCacheLevel() != kMainMemory; pMainMemory_ = &pMainMemory_->GetLowerCache())
-        ;
+    pRequestManager_ = arena.New<RequestManager>(timing_.maxOutstandingRequests, arena);
 }
 
-void Cache::AllocateMemory() {
-    sets_ = std::vector<Set>(numSets_);
-    for (uint64_t i = 0; i < numSets_; i++) {
-        sets_[i].ways = std::vector<Block>(config_.associativity);
-        sets_[i].lruList = std::vector<uint8_t>(config_.associativity);
-        for (uint8_t j = 0; j < config_.associativity; j++) {
-            sets_[i].lruList[j] = j;
-        }
+uint64_t Cache::GetArenaSize(uint8_t numCacheLevels, const Configuration* pCacheConfigs,
+                             const LevelTiming& mainMemoryTiming) {
+    uint64_t size = RequestManager::GetArenaSize(mainMemoryTiming.maxOutstandingRequests);
+    for (uint8_t cacheLevel = 0; cacheLevel < numCacheLevels; cacheLevel++) {
+        size += getLevelArenaSize(pCacheConfigs[cacheLevel]);
     }
-    pRequestManager_ = std::make_unique<RequestManager>(cacheLevel_);
-    if (pLowerCache_->GetCacheLevel() != kMainMemory) {
-        static_cast<Cache*>(pLowerCache_.get())->AllocateMemory();
+    return size;
+}
+
+uint64_t Cache::getLevelArenaSize(const Configuration& config) {
+    const uint64_t numBlocks = config.cacheSize / config.blockSize;
+    const uint64_t numSets = numBlocks / config.associativity;
+    const bool isLRUPacked = config.associativity <= kMaxPackedLRUAssociativity;
+    const uint64_t maskWordsPerSet = (config.associativity + 63) / 64;
+    uint64_t size = Arena::GetAllocationSize<uint64_t>(numBlocks) +
+                    2 * Arena::GetAllocationSize<uint64_t>(numSets * maskWordsPerSet) +
+                    Arena::GetAllocationSize<bool>(numSets) + Arena::GetAllocationSize<uint16_t>(numSets) +
+                    RequestManager::GetArenaSize(config.timing.maxOutstandingRequests);
+    if (isLRUPacked) {
+        size += Arena::GetAllocationSize<PackedLRU_t>(numSets);
     } else {
-        pLowerCache_->AllocateMemory();
+        size += Arena::GetAllocationSize<IntrusiveLRUNode>(numBlocks) +
+                Arena::GetAllocationSize<IntrusiveLRUEnds>(numSets);
     }
+    if (config.associativity > kMaxScannedAssociativity) {
+        size += BlockHashIndex::GetArenaSize(numBlocks);
+    }
+    if (config.replacementPolicy == kOPT) {
+        size += Arena::GetAllocationSize<uint32_t>(numBlocks);
+    }
+    return size;
 }
 
-void Cache::SetThreadId(uint64_t threadId) {
-    threadId_ = threadId;
-    if (cacheLevel_ != kMainMemory) {
-        static_cast<Cache*>(pLowerCache_.get())->SetThreadId(threadId);
+void Cache::SetNextUseIndices(const std::vector<NextUseIndex>& nextUseIndices) {
+    if (config_.replacementPolicy == kOPT) {
+        for (const NextUseIndex& nextUseIndex : nextUseIndices) {
+            if (nextUseIndex.GetBlockSize() == config_.blockSize) {
+                pNextUseIndex_ = &nextUseIndex;
+            }
+        }
+        assert_release(pNextUseIndex_ && "No next-use index was built for this block size");
     }
 }
 
+void Cache::Summarize(ConfigSummary& summary) const {
+    summary.stats[cacheLevel_] = stats_;
+    summary.latencies[cacheLevel_] = latencies_.Summarize();
+}
+
 bool Cache::IsCacheConfigValid(Configuration config) {
     assert_release((config.cacheSize % config.blockSize == 0) && "Block size must be a factor of cache size!");
     uint64_t numBlocks = config.cacheSize / config.blockSize;
@@ -90,139 +138,203 @@ bool Cache::IsCacheConfigValid(Configuration config) {
 }
 
 void Cache::FreeMemory() {
-    for (uint64_t i = 0; i < numSets_; i++) {
-        sets_[i].ways.clear();
-        sets_[i].ways.shrink_to_fit();
-        sets_[i].lruList.clear();
-        sets_[i].lruList.shrink_to_fit();
-    }
-    sets_.clear();
-    sets_.shrink_to_fit();
-    pRequestManager_.reset(nullptr);
-    if (pLowerCache_->GetCacheLevel() != kMainMemory) {
-        static_cast<Cache*>(pLowerCache_.get())->FreeMemory();
-    } else {
-        pLowerCache_->FreeMemory();
-    }
-}
-
-void Cache::ProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests) {
-    pMainMemory_->InternalProcessCache(cycle, completedRequests);
+    tags_ = validMasks_ = dirtyMasks_ = nullptr;
+    packedLRUs_ = nullptr;
+    lruNodes_ = nullptr;
+    lruEnds_ = nullptr;
+    blockHashIndex_.Clear();
+    busySets_ = nullptr;
+    busyRequestsPerSet_ = nullptr;
+    nextUses_ = nullptr;
+    pRequestManager_ = nullptr;
 }
 
 // =====================================
 //          Private Functions
 // =====================================
 
-void Cache::updateLRUList(uint64_t setIndex, uint8_t mruIndex) {
-    if (config_.associativity == 1) {
+template <uint64_t kAssociativity>
+void Cache::updateLRUList(uint64_t setIndex, uint32_t mruIndex) {
+    const uint64_t associativity = getAssociativity<kAssociativity>();
+    if (associativity == 1) {
         return;
     }
-    std::vector<uint8_t>& lruList = sets_[setIndex].lruList;
-    uint8_t previousValue = mruIndex;
-    // find MRU index in the lruList
-    for (uint8_t i = 0; i < config_.associativity; i++) {
-        uint8_t tmp = lruList[i];
-        lruList[i] = previousValue;
-        if (tmp == mruIndex) {
-            break;
+    if (associativity <= kMaxPackedLRUAssociativity) {
+        packedLRUs_[setIndex] = PackedLRUPromote(packedLRUs_[setIndex], mruIndex);
+        SIM_TRACE_PRINT(this, SIM_TRACE__LRU_UPDATE, static_cast<uint32_t>(setIndex), mruIndex,
+                        getLRUBlockIndex<kAssociativity>(setIndex));
+        return;
+    }
+    IntrusiveLRUEnds& ends = lruEnds_[setIndex];
+    IntrusiveLRUPromote(getLRUNodes<kAssociativity>(setIndex), ends, mruIndex);
+    SIM_TRACE_PRINT(this, SIM_TRACE__LRU_UPDATE, static_cast<uint32_t>(setIndex), ends.mru, ends.lru);
+}
+
+template <uint64_t kAssociativity>
+uint32_t Cache::selectVictim(uint64_t setIndex) const {
+    if (config_.replacementPolicy == kLRU) {
+        return getLRUBlockIndex<kAssociativity>(setIndex);
+    }
+    // kOPT: an invalid block if there is one, otherwise the block used furthest in the future
+    const uint64_t associativity = getAssociativity<kAssociativity>();
+    const uint32_t* nextUses = nextUses_ + setIndex * associativity;
+    uint32_t victim = 0;
+    for (uint32_t i = 0; i < associativity; i++) {
+        if (!testBlockBit<kAssociativity>(validMasks_, setIndex, i)) {
+            return i;
+        }
+        if (nextUses[i] > nextUses[victim]) {
+            victim = i;
         }
-        previousValue = tmp;
     }
-    gSimTracer->Print(SIM_TRACE__LRU_UPDATE, static_cast<Memory*>(this), static_cast<uint32_t>(setIndex), lruList[0],
-                      lruList[config_.associativity - 1]);
+    return victim;
+}
+
+uint32_t Cache::lookUpNextUse(const Instruction& access) const {
+    // Eviction traffic from the upper cache does not originate from a trace position
+    if (access.dataAccessIndex == Instruction::invalidIndex) {
+        return NextUseIndex::kNoNextUse;
+    }
+    return pNextUseIndex_->GetNextUse(access.dataAccessIndex);
 }
 
-int16_t Cache::evictBlock(uint64_t setIndex) {
-    int16_t lruBlockIndex = sets_[setIndex].lruList[config_.associativity - 1];
-    if (!sets_[setIndex].ways[lruBlockIndex].valid) {
+template <uint64_t kAssociativity>
+int64_t Cache::evictBlock(uint64_t setIndex) {
+    int64_t victimBlockIndex = selectVictim<kAssociativity>(setIndex);
+    if (!testBlockBit<kAssociativity>(validMasks_, setIndex, victimBlockIndex)) {
         DEBUG_TRACE("Cache[%hhu] not evicting invalid block from set %" PRIu64 "\n", cacheLevel_, setIndex);
-        return lruBlockIndex;
+        return victimBlockIndex;
     }
-    uint64_t oldBlockAddress = sets_[setIndex].ways[lruBlockIndex].blockAddress;
+    uint64_t oldBlockAddress = getSetTags<kAssociativity>(setIndex)[victimBlockIndex];
     Instruction lowerCacheAccess = Instruction(oldBlockAddress << blockSizeBits_, READ);
-    if (sets_[setIndex].ways[lruBlockIndex].dirty) {
+    if (testBlockBit<kAssociativity>(dirtyMasks_, setIndex, victimBlockIndex)) {
         lowerCacheAccess.rw = WRITE;
         ++stats_.writebacks;
-        sets_[setIndex].ways[lruBlockIndex].dirty = false;
+        writeBlockBit<kAssociativity>(dirtyMasks_, setIndex, victimBlockIndex, false);
     }
     if (pLowerCache_->AddAccessRequest(lowerCacheAccess, cycle_) == RequestManager::kInvalidRequestIndex) {
-        gSimTracer->Print(SIM_TRACE__EVICT_FAILED, static_cast<Memory*>(this));
+        SIM_TRACE_PRINT(this, SIM_TRACE__EVICT_FAILED);
         DEBUG_TRACE("Cache[%hhu] could not make request to lower cache in evictBlock, returning\n", cacheLevel_);
         return -1;
     }
-    sets_[setIndex].ways[lruBlockIndex].valid = false;
-    return lruBlockIndex;
+    writeBlockBit<kAssociativity>(validMasks_, setIndex, victimBlockIndex, false);
+    if (getAssociativity<kAssociativity>() > kMaxScannedAssociativity) {
+        blockHashIndex_.Erase(oldBlockAddress);
+    }
+    return victimBlockIndex;
 }
 
-bool Cache::findBlockInSet(uint64_t setIndex, uint64_t blockAddress, uint8_t& pBlockIndex) {
-    for (uint64_t i = 0; i < config_.associativity; i++) {
-        if (sets_[setIndex].ways[i].valid && (sets_[setIndex].ways[i].blockAddress == blockAddress)) {
-            pBlockIndex = i;
-            updateLRUList(setIndex, i);
+template <uint64_t kAssociativity>
+bool Cache::findBlockInSet(uint64_t setIndex, uint64_t blockAddress, uint32_t& pBlockIndex) {
+    const uint64_t* tags = getSetTags<kAssociativity>(setIndex);
+    if constexpr (kAssociativity == 1) {
+        // Direct-mapped, no search & no LRU to update
+        pBlockIndex = 0;
+        return (tags[0] == blockAddress) & (validMasks_[setIndex] & 1);
+    }
+    const uint64_t associativity = getAssociativity<kAssociativity>();
+    if (associativity > kMaxScannedAssociativity) {
+        pBlockIndex = blockHashIndex_.Find(blockAddress);
+        if (pBlockIndex == BlockHashIndex::kNotFound) {
+            return false;
+        }
+        updateLRUList<kAssociativity>(setIndex, pBlockIndex);
+        return true;
+    }
+    const uint64_t maskWordsPerSet = getMaskWordsPerSet<kAssociativity>();
+    const uint64_t* validMasks = validMasks_ + setIndex * maskWordsPerSet;
+    for (uint64_t word = 0; word < maskWordsPerSet; word++) {
+        const uint64_t firstWay = word * 64;
+        const uint64_t numWays = std::min<uint64_t>(associativity - firstWay, 64);
+        const uint64_t hits = MatchTags(tags + firstWay, blockAddress, numWays) & validMasks[word];
+        if (hits) {
+            pBlockIndex = static_cast<uint32_t>(firstWay + std::countr_zero(hits));
+            updateLRUList<kAssociativity>(setIndex, pBlockIndex);
             return true;
         }
     }
     return false;
 }
 
-int16_t Cache::requestBlock(uint64_t setIndex, uint64_t blockAddress) {
-    int16_t blockIndex = evictBlock(setIndex);
+template <uint64_t kAssociativity>
+int64_t Cache::requestBlock(uint64_t setIndex, uint64_t blockAddress, const Instruction& access) {
+    int64_t blockIndex = evictBlock<kAssociativity>(setIndex);
     if (blockIndex == -1) {
         return -1;
     }
-    gSimTracer->Print(SIM_TRACE__EVICT, static_cast<Memory*>(this), setIndex, blockIndex);
+    SIM_TRACE_PRINT(this, SIM_TRACE__EVICT, setIndex, blockIndex);
     Instruction readRequestToLowerCache = Instruction(blockAddress << blockSizeBits_, READ);
+    readRequestToLowerCache.dataAccessIndex = access.dataAccessIndex;
     if (pLowerCache_->AddAccessRequest(readRequestToLowerCache, cycle_) == -1) {
-        gSimTracer->Print(SIM_TRACE__REQUEST_FAILED, static_cast<Memory*>(this), NULL);
+        SIM_TRACE_PRINT(this, SIM_TRACE__REQUEST_FAILED, NULL);
         DEBUG_TRACE("Cache[%hhu] could not make request to lower cache in requestBlock, returning\n", cacheLevel_);
         return -1;
     }
-    sets_[setIndex].ways[blockIndex].blockAddress = blockAddress;
-    sets_[setIndex].ways[blockIndex].valid = true;
-    assert(sets_[setIndex].ways[blockIndex].dirty == false);
+    getSetTags<kAssociativity>(setIndex)[blockIndex] = blockAddress;
+    writeBlockBit<kAssociativity>(validMasks_, setIndex, blockIndex, true);
+    if (getAssociativity<kAssociativity>() > kMaxScannedAssociativity) {
+        blockHashIndex_.Insert(blockAddress, static_cast<uint32_t>(blockIndex));
+    }
+    if (config_.replacementPolicy == kOPT) {
+        nextUses_[setIndex * getAssociativity<kAssociativity>() + blockIndex] = lookUpNextUse(access);
+    }
+    assert(!testBlockBit<kAssociativity>(dirtyMasks_, setIndex, blockIndex));
     return blockIndex;
 }
 
+template <uint64_t kAssociativity>
+void Cache::accountHit(const Instruction& access, uint64_t setIndex, uint32_t blockIndex, bool isFirstAttempt) {
+    if (access.rw == READ) {
+        if (isFirstAttempt) {
+            ++stats_.readHits;
+        }
+    } else {
+        if (isFirstAttempt) {
+            ++stats_.writeHits;
+        }
+        writeBlockBit<kAssociativity>(dirtyMasks_, setIndex, blockIndex, true);
+    }
+    // Eviction traffic is not a use, so it keeps the block's next use as it was
+    if (config_.replacementPolicy == kOPT && access.dataAccessIndex != Instruction::invalidIndex) {
+        nextUses_[setIndex * getAssociativity<kAssociativity>() + blockIndex] = lookUpNextUse(access);
+    }
+}
+
+template <uint64_t kAssociativity>
+bool Cache::resolveHit(const Instruction& access, uint64_t setIndex) {
+    uint32_t blockIndex;
+    if (!findBlockInSet<kAssociativity>(setIndex, addressToBlockAddress(access.ptr), blockIndex)) {
+        return false;
+    }
+    accountHit<kAssociativity>(access, setIndex, blockIndex, true);
+    return true;
+}
+
+template <uint64_t kAssociativity>
 Status Cache::handleAccess(Request& request) {
     if (cycle_ < request.cycleToCallBack) {
         DEBUG_TRACE("%" PRIu64 "/%" PRIu64 " cycles for this operation in cacheLevel=%hhu\n", cycle_ - request.cycle,
-                    kAccessTimeInCycles[cacheLevel_], cacheLevel_);
-        if (earliestNextUsefulCycle_ > request.cycleToCallBack) {
-            DEBUG_TRACE("Cache[%hhu] next useful cycle set to %" PRIu64 "\n", cacheLevel_, request.cycleToCallBack);
-            earliestNextUsefulCycle_ = request.cycleToCallBack;
-        }
+                    timing_.accessTimeInCycles, cacheLevel_);
         return kWaiting;
     }
-    earliestNextUsefulCycle_ = UINT64_MAX;
 
     const Instruction& access = request.instruction;
     const uint64_t blockAddress = addressToBlockAddress(access.ptr);
     const uint64_t setIndex = addressToSetIndex(access.ptr);
-    if (sets_[setIndex].busy) {
+    if (busySets_[setIndex]) {
         DEBUG_TRACE("Cache[%hhu] set %" PRIu64 " is busy\n", cacheLevel_, setIndex);
         return kBusy;
     }
     wasWorkDoneThisCycle_ = true;
-    uint8_t blockIndex;
-    bool hit = findBlockInSet(setIndex, blockAddress, blockIndex);
+    uint32_t blockIndex;
+    bool hit = findBlockInSet<kAssociativity>(setIndex, blockAddress, blockIndex);
     request.attemptCount++;
     if (hit) {
-        gSimTracer->Print(SIM_TRACE__HIT, static_cast<Memory*>(this), pRequestManager_->GetPoolIndex(&request),
-                          blockAddress >> 32, blockAddress & UINT32_MAX, setIndex);
-        if (access.rw == READ) {
-            if (request.attemptCount == 1) {
-                ++stats_.readHits;
-            }
-        } else {
-            if (request.attemptCount == 1) {
-                ++stats_.writeHits;
-            }
-            sets_[setIndex].ways[blockIndex].dirty = true;
-        }
+        SIM_TRACE_PRINT(this, SIM_TRACE__HIT, pRequestManager_->GetPoolIndex(&request), blockAddress >> 32,
+                        blockAddress & UINT32_MAX, setIndex);
+        accountHit<kAssociativity>(access, setIndex, blockIndex, request.attemptCount == 1);
     } else {
-        gSimTracer->Print(SIM_TRACE__MISS, static_cast<Memory*>(this), pRequestManager_->GetPoolIndex(&request),
-                          setIndex);
+        SIM_TRACE_PRINT(this, SIM_TRACE__MISS, pRequestManager_->GetPoolIndex(&request), setIndex);
         if (access.rw == READ) {
             if (request.attemptCount == 1) {
                 ++stats_.readMisses;
@@ -233,82 +345,182 @@ Status Cache::handleAccess(Request& request) {
             }
         }
 
-        int16_t requestedBlock = requestBlock(setIndex, blockAddress);
+        int64_t requestedBlock = requestBlock<kAssociativity>(setIndex, blockAddress, access);
         if (requestedBlock < 0) {
             return kMiss;
         }
         // Cast is OK after check above
-        blockIndex = static_cast<uint8_t>(requestedBlock);
-        sets_[setIndex].busy = true;
+        blockIndex = static_cast<uint32_t>(requestedBlock);
+        setCacheSetBusy(setIndex);
         DEBUG_TRACE("Cache[%hhu] set %" PRIu64 " marked as busy due to miss\n", cacheLevel_, setIndex);
         if (access.rw == WRITE) {
-            sets_[setIndex].ways[blockIndex].dirty = true;
+            writeBlockBit<kAssociativity>(dirtyMasks_, setIndex, blockIndex, true);
         }
     }
     return hit ? kHit : kMiss;
 }
 
+const Cache::HandleAccessFunction_t Cache::kSpecializedHandleAccessFunctions[kNumberOfSpecializedAssociativities] = {
+    &Cache::handleAccess<1>, &Cache::handleAccess<2>, &Cache::handleAccess<4>, &Cache::handleAccess<8>,
+    &Cache::handleAccess<16>,
+};
+
+const Cache::ResolveHitFunction_t Cache::kSpecializedResolveHitFunctions[kNumberOfSpecializedAssociativities] = {
+    &Cache::resolveHit<1>, &Cache::resolveHit<2>, &Cache::resolveHit<4>, &Cache::resolveHit<8>, &Cache::resolveHit<16>,
+};
+
+int16_t Cache::IssueAccessRequest(Instruction access, uint64_t cycle) {
+    assert(cacheLevel_ == kL1);
+    if constexpr (kResolveHitsOnIssue) {
+        const uint64_t setIndex = addressToSetIndex(access.ptr);
+        if (pRequestManager_->HasFreeRequests() && !busySets_[setIndex] && !busyRequestsPerSet_[setIndex] &&
+            !isSetWaitedOn(setIndex) && (this->*pResolveHit_)(access, setIndex)) {
+            // The request only holds its slot until it would have been handled, then completes like any other hit
+            const uint64_t poolIndex = pRequestManager_->PopRequestFromFreeList();
+            pRequestManager_->NewInstruction(poolIndex, access, cycle, timing_.accessTimeInCycles);
+            pRequestManager_->AddRequestToResolvedList(poolIndex);
+            DEBUG_TRACE("Cache[%hhu] request %" PRIu64 " resolved as a hit on issue, completes at tick %" PRIu64 "\n",
+                        cacheLevel_, poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack);
+            return static_cast<int16_t>(poolIndex);
+        }
+    }
+    return AddAccessRequest(access, cycle);
+}
+
+void Cache::CompleteResolvedRequests(uint64_t cycle, std::vector<int16_t>& completedRequests) {
+    updateEarliestNextUsefulCycle();
+    for_each_in_index_list(pRequestManager_->GetResolvedRequests()) {
+        if (cycle < pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack) {
+            earliestNextUsefulCycle_ =
+                std::min(earliestNextUsefulCycle_, pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack);
+            break;
+        }
+        DEBUG_TRACE("Cache[%hhu] request %" PRIu64 " resolved on issue completes\n", cacheLevel_, poolIndex);
+        latencies_.Record(cycle - pRequestManager_->GetRequestAtIndex(poolIndex).cycle);
+        completedRequests.push_back(poolIndex);
+        pRequestManager_->RemoveRequestFromResolvedList(poolIndex);
+        pRequestManager_->PushRequestToFreeList(poolIndex);
+    }
+}
+
+bool Cache::isSetWaitedOn(uint64_t setIndex) {
+    for_each_in_index_list(pRequestManager_->GetWaitingRequests()) {
+        if (addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr) == setIndex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void Cache::setCacheSetBusy(uint64_t setIndex) {
+    assert(!busySets_[setIndex]);
+    busySets_[setIndex] = true;
+    wakeableBusyRequests_ -= busyRequestsPerSet_[setIndex];
+}
+
 void Cache::ResetCacheSetBusy(uint64_t setIndex) {
-    sets_[setIndex].busy = false;
+    // Completed writebacks also land here, for sets that may not be busy
+    if (busySets_[setIndex]) {
+        busySets_[setIndex] = false;
+        wakeableBusyRequests_ += busyRequestsPerSet_[setIndex];
+    }
+}
+
+void Cache::moveRequestToBusyList(uint64_t poolIndex) {
+    pRequestManager_->RemoveRequestFromWaitingList(poolIndex);
+    parkRequest(poolIndex);
+}
+
+void Cache::retireBusyRequest(uint64_t poolIndex) {
+    unparkRequest(poolIndex);
+    pRequestManager_->PushRequestToFreeList(poolIndex);
+}
+
+void Cache::parkRequest(uint64_t poolIndex) {
+    const uint64_t setIndex = addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
+    pRequestManager_->AddRequestToBusyList(poolIndex);
+    busyRequestsPerSet_[setIndex]++;
+    wakeableBusyRequests_ += !busySets_[setIndex];
+}
+
+void Cache::unparkRequest(uint64_t poolIndex) {
+    const uint64_t setIndex = addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
+    // Only requests of a set that is not busy can hit
+    assert(!busySets_[setIndex]);
+    pRequestManager_->RemoveRequestFromBusyList(poolIndex);
+    busyRequestsPerSet_[setIndex]--;
+    wakeableBusyRequests_--;
+}
+
+void Cache::completeRequest(uint64_t poolIndex, std::vector<int16_t>& completedRequests) {
+    const Request& request = pRequestManager_->GetRequestAtIndex(poolIndex);
+    const uint64_t address = request.instruction.ptr;
+    DEBUG_TRACE("Cache[%hhu] hit, set=%" PRIu64 "\n", cacheLevel_, addressToSetIndex(address));
+    // From its issue, so the cycles its set was busy & the fill it missed on are part of its latency
+    latencies_.Record(cycle_ - request.cycle);
+    if (pUpperCache_) {
+        Cache* const upperCache = static_cast<Cache*>(pUpperCache_);
+        uint64_t setIndex = upperCache->addressToSetIndex(address);
+        DEBUG_TRACE("Cache[%hhu] marking set %" PRIu64 " as no longer busy\n",
+                    static_cast<uint8_t>(pUpperCache_->GetCacheLevel()), setIndex);
+        upperCache->ResetCacheSetBusy(setIndex);
+    } else {
+        assert(cacheLevel_ == kL1);
+        completedRequests.push_back(poolIndex);
+    }
+}
+
+RequestCoroutine Cache::runRequest(uint64_t poolIndex) {
+    Request& request = pRequestManager_->GetRequestAtIndex(poolIndex);
+    co_await WaitForCycle{*this, poolIndex, request.cycleToCallBack};
+    if ((this->*pHandleAccess_)(request) != kHit) {
+        // Either its set is being filled or the level below had no room for the requests of a fill, so it can only go
+        // on once a fill lands in its set or the level below does work
+        parkRequest(poolIndex);
+        do {
+            co_await WaitForWakeUp{*this, poolIndex};
+        } while ((this->*pHandleAccess_)(request) != kHit);
+        unparkRequest(poolIndex);
+    }
+    completeRequest(poolIndex, *pCompletedRequests_);
 }
 
 void Cache::InternalProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests) {
     wasWorkDoneThisCycle_ = false;
     cycle_ = cycle;
-    if (pLowerCache_->GetWasWorkDoneThisCycle()) {
-        for_each_in_double_list(pRequestManager_->GetBusyRequests()) {
+    // Busy requests of busy sets would only bounce off their set again, so they are skipped until it is woken
+    if (pLowerCache_->GetWasWorkDoneThisCycle() && wakeableBusyRequests_) {
+        for_each_in_index_list(pRequestManager_->GetBusyRequests()) {
+            if (busySets_[addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr)]) {
+                continue;
+            }
             DEBUG_TRACE("Cache[%hhu] trying request %" PRIu64 " from busy requests list, address=0x%012" PRIx64 "\n",
                         cacheLevel_, poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
-            Status status = handleAccess(pRequestManager_->GetRequestAtIndex(poolIndex));
+            Status status = (this->*pHandleAccess_)(pRequestManager_->GetRequestAtIndex(poolIndex));
             if (status == kHit) {
-                DEBUG_TRACE("Cache[%hhu] hit, set=%" PRIu64 "\n", cacheLevel_,
-                            addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr));
-                if (pUpperCache_) {
-                    Cache* upperCache = static_cast<Cache*>(pUpperCache_);
-                    uint64_t setIndex =
-                        upperCache->addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
-                    DEBUG_TRACE("Cache[%hhu] marking set %" PRIu64 " as no longer busy\n",
-                                static_cast<uint8_t>(pUpperCache_->GetCacheLevel()), setIndex);
-                    static_cast<Cache*>(pUpperCache_)->ResetCacheSetBusy(setIndex);
-                }
-                if (cacheLevel_ == kL1) {
-                    completedRequests.push_back(poolIndex);
-                }
-                pRequestManager_->RemoveRequestFromBusyList(elementIterator);
-                pRequestManager_->PushRequestToFreeList(elementIterator);
+                completeRequest(poolIndex, completedRequests);
+                retireBusyRequest(poolIndex);
             }
         }
     } else {
-        if (pLowerCache_ && pRequestManager_->PeekHeadOfBusyList()) {
-            DEBUG_TRACE("Cache[%hhu] no work was done in lower cache, not checking busy list\n", cacheLevel_);
+        if (pLowerCache_ && pRequestManager_->HasBusyRequests()) {
+            DEBUG_TRACE("Cache[%hhu] no work was done in lower cache or no busy set was woken, not checking busy list\n",
+                        cacheLevel_);
         }
     }
-    for_each_in_double_list(pRequestManager_->GetWaitingRequests()) {
+    for_each_in_index_list(pRequestManager_->GetWaitingRequests()) {
         DEBUG_TRACE("Cache[%hhu] trying request %" PRIu64 " from waiting list, address=0x%012" PRIx64 "\n", cacheLevel_,
                     poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
-        Status status = handleAccess(pRequestManager_->GetRequestAtIndex(poolIndex));
+        Status status = (this->*pHandleAccess_)(pRequestManager_->GetRequestAtIndex(poolIndex));
         switch (status) {
         case kHit:
-            DEBUG_TRACE("Cache[%hhu] hit, set=%" PRIu64 "\n", cacheLevel_,
-                        addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr));
-            if (pUpperCache_) {
-                Cache* const upperCache = static_cast<Cache*>(pUpperCache_);
-                uint64_t setIndex =
-                    upperCache->addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
-                DEBUG_TRACE("Cache[%hhu] marking set %" PRIu64 " as no longer busy\n",
-                            static_cast<uint8_t>(pUpperCache_->GetCacheLevel()), setIndex);
-                upperCache->sets_[setIndex].busy = false;
-            } else {
-                assert(cacheLevel_ == kL1);
-                completedRequests.push_back(poolIndex);
-            }
-            pRequestManager_->RemoveRequestFromWaitingList(elementIterator);
-            pRequestManager_->PushRequestToFreeList(elementIterator);
+            completeRequest(poolIndex, completedRequests);
+            pRequestManager_->RemoveRequestFromWaitingList(poolIndex);
+            pRequestManager_->PushRequestToFreeList(poolIndex);
             break;
         case kMiss:
         case kBusy:
-            pRequestManager_->RemoveRequestFromWaitingList(elementIterator);
-            pRequestManager_->AddRequestToBusyList(elementIterator);
+            moveRequestToBusyList(poolIndex);
             break;
         case kWaiting:
             DEBUG_TRACE("Cache[%hhu] request %" PRIu64 " is still waiting, breaking out of loop\n", cacheLevel_,
@@ -321,11 +533,26 @@ void Cache::InternalProcessCache(uint64_t cycle, std::vector<int16_t>& completed
         }
     }
 out_of_loop:
+    updateEarliestNextUsefulCycle();
     DEBUG_TRACE("\n");
+}
 
-    if (pUpperCache_) {
-        Cache* upperCache = static_cast<Cache*>(pUpperCache_);
-        upperCache->InternalProcessCache(cycle, completedRequests);
-        upperCache->SetWasWorkDoneThisCycle(wasWorkDoneThisCycle_);
+void Cache::ResumeRequests(uint64_t cycle, std::vector<int16_t>& completedRequests) {
+    wasWorkDoneThisCycle_ = false;
+    cycle_ = cycle;
+    pCompletedRequests_ = &completedRequests;
+    // Same as the sweep, busy requests of busy sets stay suspended until their set is woken
+    if (pLowerCache_->GetWasWorkDoneThisCycle() && wakeableBusyRequests_) {
+        for_each_in_index_list(pRequestManager_->GetBusyRequests()) {
+            if (busySets_[addressToSetIndex(pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr)]) {
+                continue;
+            }
+            DEBUG_TRACE("Cache[%hhu] resuming request %" PRIu64 " from busy requests list, address=0x%012" PRIx64 "\n",
+                        cacheLevel_, poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
+            resumeRequest(poolIndex);
+        }
     }
+    resumeDueRequests();
+    updateEarliestNextUsefulCycle();
+    DEBUG_TRACE("\n");
 }
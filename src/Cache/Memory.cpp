@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "Cache.h"
 #include "Memory.h"
 #include "SimTracer.h"
 #include "debug.h"
@@ -14,47 +15,47 @@
 #define DEBUG_TRACE(...)
 #endif
 
-#if (SIM_TRACE == 1)
-extern SimTracer* gSimTracer;
-#else
-SimTracer dummySimTracer = SimTracer();
-SimTracer* gSimTracer = &dummySimTracer;
-#endif
-
-Memory::Memory(Memory* pLowestCache, CacheLevel cacheLevel) : pUpperCache_(pLowestCache), pMainMemory_(this), cacheLevel_(cacheLevel) {
+Memory::Memory(CacheLevel cacheLevel, const LevelTiming& timing) : cacheLevel_(cacheLevel), timing_(timing) {
     earliestNextUsefulCycle_ = UINT64_MAX;
-    pLowerCache_ = nullptr;
 }
 
-void Memory::AllocateMemory() {
-    pRequestManager_ = std::make_unique<RequestManager>(cacheLevel_);
+void Memory::SetAdjacentLevels(Memory* pUpperCache, Memory* pLowerCache) {
+    pUpperCache_ = pUpperCache;
+    pLowerCache_ = pLowerCache;
+}
+
+void Memory::AllocateMemory(Arena& arena) {
+    pRequestManager_ = arena.New<RequestManager>(timing_.maxOutstandingRequests, arena);
 }
 
 void Memory::FreeMemory() {
-    pRequestManager_.reset(nullptr);
+    pRequestManager_ = nullptr;
 }
 
 int16_t Memory::AddAccessRequest(Instruction access, uint64_t cycle) {
-    DoubleListElement* element = pRequestManager_->PopRequestFromFreeList();
-    if (element) {
-        pRequestManager_->AddRequestToWaitingList(element);
-        uint64_t poolIndex = element->poolIndex_;
-        pRequestManager_->NewInstruction(poolIndex, access, cycle, kAccessTimeInCycles[cacheLevel_]);
+    uint64_t poolIndex = pRequestManager_->PopRequestFromFreeList();
+    if (poolIndex != IndexList::kNone) {
+        pRequestManager_->NewInstruction(poolIndex, access, cycle, timing_.accessTimeInCycles);
+        if constexpr (kUseCoroutineEngine) {
+            startRequest(poolIndex);
+        } else {
+            pRequestManager_->AddRequestToWaitingList(poolIndex);
+        }
         DEBUG_TRACE("Cache[%hhu] New request type %d added at index %" PRIu64 ", call back at tick %" PRIu64 "\n",
                     cacheLevel_, access.rw, poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack);
-        gSimTracer->Print(SIM_TRACE__REQUEST_ADDED, this, poolIndex, access.rw, (access.ptr >> 32),
-                          access.ptr & UINT32_MAX, kAccessTimeInCycles[cacheLevel_]);
+        SIM_TRACE_PRINT(this, SIM_TRACE__REQUEST_ADDED, poolIndex, access.rw, (access.ptr >> 32),
+                        access.ptr & UINT32_MAX, timing_.accessTimeInCycles);
 
         return static_cast<int16_t>(poolIndex);
     }
     return RequestManager::kInvalidRequestIndex;
 }
 
-void Memory::InternalProcessCache(uint64_t cycle, std::vector<int16_t>& completedRequests) {
+void Memory::InternalProcessCache(uint64_t cycle) {
     Cache* const upperCache = static_cast<Cache*>(pUpperCache_);
     wasWorkDoneThisCycle_ = false;
     cycle_ = cycle;
-    for_each_in_double_list(pRequestManager_->GetWaitingRequests()) {
+    for_each_in_index_list(pRequestManager_->GetWaitingRequests()) {
         DEBUG_TRACE("Cache[%hhu] trying request %" PRIu64 " from waiting list, address=0x%012" PRIx64 "\n", cacheLevel_,
                     poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
         if (handleAccess(pRequestManager_->GetRequestAtIndex(poolIndex)) == kWaiting) {
@@ -70,37 +71,76 @@ void Memory::InternalProcessCache(uint64_t cycle, std::vector<int16_t>& complete
                     setIndex);
         upperCache->ResetCacheSetBusy(setIndex);
 
-        pRequestManager_->RemoveRequestFromWaitingList(elementIterator);
-        pRequestManager_->PushRequestToFreeList(elementIterator);
+        pRequestManager_->RemoveRequestFromWaitingList(poolIndex);
+        pRequestManager_->PushRequestToFreeList(poolIndex);
     }
+    updateEarliestNextUsefulCycle();
     DEBUG_TRACE("\n");
-    upperCache->InternalProcessCache(cycle, completedRequests);
-    pUpperCache_->wasWorkDoneThisCycle_ = wasWorkDoneThisCycle_;
+}
+
+void Memory::ResumeRequests(uint64_t cycle) {
+    wasWorkDoneThisCycle_ = false;
+    cycle_ = cycle;
+    resumeDueRequests();
+    updateEarliestNextUsefulCycle();
+    DEBUG_TRACE("\n");
+}
+
+void Memory::startRequest(uint64_t poolIndex) {
+    gNextCoroutineFrame = &pRequestManager_->GetCoroutineFrameAtIndex(poolIndex);
+    if (cacheLevel_ == kMainMemory) {
+        runRequest(poolIndex);
+    } else {
+        static_cast<Cache*>(this)->runRequest(poolIndex);
+    }
+}
 
+RequestCoroutine Memory::runRequest(uint64_t poolIndex) {
+    Request& request = pRequestManager_->GetRequestAtIndex(poolIndex);
+    co_await WaitForCycle{*this, poolIndex, request.cycleToCallBack};
+    handleAccess(request);
+    Cache* const upperCache = static_cast<Cache*>(pUpperCache_);
+    uint64_t setIndex = upperCache->addressToSetIndex(request.instruction.ptr);
+    DEBUG_TRACE("Cache[%hhu] marking set %" PRIu64 " as no longer busy\n", static_cast<uint8_t>(cacheLevel_ - 1),
+                setIndex);
+    upperCache->ResetCacheSetBusy(setIndex);
+}
+
+void Memory::resumeDueRequests() {
+    IndexList* const pWaitingRequests = pRequestManager_->GetWaitingRequests();
+    for (uint64_t poolIndex = pWaitingRequests->PeekFront();
+         poolIndex != IndexList::kNone && pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack <= cycle_;
+         poolIndex = pWaitingRequests->PeekFront()) {
+        DEBUG_TRACE("Cache[%hhu] resuming request %" PRIu64 " from waiting list, address=0x%012" PRIx64 "\n",
+                    cacheLevel_, poolIndex, pRequestManager_->GetRequestAtIndex(poolIndex).instruction.ptr);
+        pRequestManager_->RemoveRequestFromWaitingList(poolIndex);
+        resumeRequest(poolIndex);
+    }
+}
+
+void Memory::resumeRequest(uint64_t poolIndex) {
+    std::coroutine_handle<>& coroutine = pRequestManager_->GetCoroutineAtIndex(poolIndex);
+    coroutine.resume();
+    if (coroutine.done()) {
+        coroutine.destroy();
+        pRequestManager_->PushRequestToFreeList(poolIndex);
+    }
 }
 
 Status Memory::handleAccess(Request& request) {
     if (cycle_ < request.cycleToCallBack) {
         DEBUG_TRACE("%" PRIu64 "/%" PRIu64 " cycles for this operation in cacheLevel=%hhu\n", cycle_ - request.cycle,
-                    kAccessTimeInCycles[cacheLevel_], cacheLevel_);
-        if (earliestNextUsefulCycle_ > request.cycleToCallBack) {
-            DEBUG_TRACE("Cache[%hhu] next useful cycle set to %" PRIu64 "\n", cacheLevel_, request.cycleToCallBack);
-            earliestNextUsefulCycle_ = request.cycleToCallBack;
-        }
+                    timing_.accessTimeInCycles, cacheLevel_);
         return kWaiting;
     }
-    earliestNextUsefulCycle_ = UINT64_MAX;
     // Main memory always hits
     wasWorkDoneThisCycle_ = true;
     return kHit;
 }
 
-uint64_t Memory::CalculateEarliestNextUsefulCycle() const {
-    uint64_t earliestNextUsefulCycle = UINT64_MAX;
-    for (auto cacheIterator = this; cacheIterator != nullptr; cacheIterator = &cacheIterator->GetLowerCache()) {
-        if (cacheIterator->GetEarliestNextUsefulCycle() < earliestNextUsefulCycle) {
-            earliestNextUsefulCycle = cacheIterator->GetEarliestNextUsefulCycle();
-        }
-    }
-    return earliestNextUsefulCycle;
+void Memory::updateEarliestNextUsefulCycle() {
+    const uint64_t poolIndex = pRequestManager_->GetWaitingRequests()->PeekFront();
+    earliestNextUsefulCycle_ =
+        poolIndex == IndexList::kNone ? UINT64_MAX : pRequestManager_->GetRequestAtIndex(poolIndex).cycleToCallBack;
+    DEBUG_TRACE("Cache[%hhu] next useful cycle set to %" PRIu64 "\n", cacheLevel_, earliestNextUsefulCycle_);
 }
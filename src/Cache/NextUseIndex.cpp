@@ -0,0 +1,25 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "NextUseIndex.h"
+#include "debug.h"
+
+NextUseIndex::NextUseIndex(InstructionSpan_t dataAccesses, uint64_t blockSize, HugePageUsage* pHugePageUsage)
+    : nextUse_(HugePageAllocator<uint32_t>(pHugePageUsage)), blockSize_(blockSize) {
+    assert_release(dataAccesses.size() < kNoNextUse && "Trace is too long for 32-bit next-use indices");
+    uint64_t blockSizeBits = 0;
+    for (uint64_t tmp = blockSize; tmp > 1; tmp >>= 1) {
+        blockSizeBits++;
+    }
+    nextUse_.resize(dataAccesses.size());
+    // Block address -> index of its most recently seen (i.e. next in trace order) access
+    std::unordered_map<uint64_t, uint32_t> nextSeen;
+    for (uint64_t i = dataAccesses.size(); i-- > 0;) {
+        const uint64_t blockAddress = dataAccesses[i].ptr >> blockSizeBits;
+        auto [iterator, inserted] = nextSeen.try_emplace(blockAddress, static_cast<uint32_t>(i));
+        nextUse_[i] = inserted ? kNoNextUse : iterator->second;
+        iterator->second = static_cast<uint32_t>(i);
+    }
+}
@@ -6,52 +6,28 @@
 #include "debug.h"
 #include "list.h"
 
-RequestManager::RequestManager(CacheLevel pCacheLevel) {
-    maxOutstandingRequests_ = RequestManager::kMaxNumberOfRequests << pCacheLevel;
-    pRequestPool_ = new Request[maxOutstandingRequests_];
-    pWaitingRequests_ = new DoubleList(maxOutstandingRequests_);
-    pBusyRequests_ = new DoubleList(maxOutstandingRequests_);
-    pFreeRequests_ = new DoubleList(maxOutstandingRequests_);
+RequestManager::RequestManager(uint64_t maxOutstandingRequests, Arena& arena)
+    : maxOutstandingRequests_(maxOutstandingRequests),
+      pRequestPool_(arena.Allocate<Request>(maxOutstandingRequests_)),
+      pRequestNodes_(arena.Allocate<IndexListNode>(maxOutstandingRequests_)),
+      waitingRequests_(pRequestNodes_, maxOutstandingRequests_), freeRequests_(pRequestNodes_, maxOutstandingRequests_),
+      busyRequests_(pRequestNodes_, maxOutstandingRequests_), resolvedRequests_(pRequestNodes_, maxOutstandingRequests_),
+      pCoroutineFrames_(kUseCoroutineEngine ? arena.Allocate<CoroutineFrame>(maxOutstandingRequests_) : nullptr),
+      pCoroutines_(kUseCoroutineEngine ? arena.Allocate<std::coroutine_handle<>>(maxOutstandingRequests_) : nullptr) {
     for (uint64_t i = 0; i < maxOutstandingRequests_; i++) {
-        DoubleListElement* element = new DoubleListElement;
-        element->poolIndex_ = i;
-        pFreeRequests_->PushElement(element);
+        freeRequests_.PushFront(i);
     }
 }
 
-RequestManager::~RequestManager() {
-    delete[] pRequestPool_;
-    delete pWaitingRequests_;
-    delete pFreeRequests_;
-    delete pBusyRequests_;
-}
-
-void RequestManager::AddRequestToBusyList(DoubleListElement* pElement) {
-    pBusyRequests_->AddElementToTail(pElement);
-}
-
-void RequestManager::RemoveRequestFromBusyList(DoubleListElement* pElement) {
-    CODE_FOR_ASSERT(bool ret =) pBusyRequests_->RemoveElement(pElement);
-    assert(ret);
-}
-
-void RequestManager::RemoveRequestFromWaitingList(DoubleListElement* pElement) {
-    CODE_FOR_ASSERT(bool ret =) pWaitingRequests_->RemoveElement(pElement);
-    assert(ret);
-}
-
-void RequestManager::AddRequestToWaitingList(DoubleListElement* pElement) {
-    CODE_FOR_ASSERT(bool ret =) pWaitingRequests_->AddElementToTail(pElement);
-    assert(ret);
-}
-
-void RequestManager::PushRequestToFreeList(DoubleListElement* pElement) {
-    CODE_FOR_ASSERT(bool ret =) pFreeRequests_->PushElement(pElement);
-    assert(ret);
-}
-
-DoubleListElement* RequestManager::PopRequestFromFreeList() {
-    return pFreeRequests_->PopElement();
+uint64_t RequestManager::GetArenaSize(uint64_t maxOutstandingRequests) {
+    uint64_t size = Arena::GetAllocationSize<RequestManager>(1) +
+                    Arena::GetAllocationSize<Request>(maxOutstandingRequests) +
+                    Arena::GetAllocationSize<IndexListNode>(maxOutstandingRequests);
+    if (kUseCoroutineEngine) {
+        size += Arena::GetAllocationSize<CoroutineFrame>(maxOutstandingRequests) +
+                Arena::GetAllocationSize<std::coroutine_handle<>>(maxOutstandingRequests);
+    }
+    return size;
 }
 
 void RequestManager::NewInstruction(uint64_t poolIndex, Instruction access, uint64_t cycle,
@@ -62,3 +38,13 @@ void RequestManager::NewInstruction(uint64_t poolIndex, Instruction access, uint
     pRequest->cycleToCallBack = cycle + accessTimeInCycles;
     pRequest->attemptCount = 0;
 }
+
+void RequestManager::ScheduleRequest(uint64_t poolIndex, uint64_t cycle) {
+    pRequestPool_[poolIndex].cycleToCallBack = cycle;
+    // Every level has a single access time so this is almost always the tail
+    uint64_t previous = waitingRequests_.PeekBack();
+    while (previous != IndexList::kNone && pRequestPool_[previous].cycleToCallBack > cycle) {
+        previous = waitingRequests_.GetPrevious(previous);
+    }
+    waitingRequests_.InsertAfter(poolIndex, previous);
+}
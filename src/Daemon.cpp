@@ -0,0 +1,342 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Daemon.h"
+#include "IOUtilities.h"
+#include "debug.h"
+
+// Longer lines are rejected, configs take up less than a tenth of it
+constexpr size_t kMaxRequestLineLength = 1024;
+
+Daemon::Daemon(uint64_t numWorkers) : pool_(numWorkers), nextJobId_(0), isStopping_(false), listenSocket_(-1) {
+    Multithreading::InitializeLock(&lock_);
+    Multithreading::InitializeLock(&tracesLock_);
+}
+
+bool Daemon::loadTrace(const char* pFilename, uint64_t& traceId) {
+    std::string filename(pFilename);
+#ifdef __linux__
+    // The same trace through another path is not parsed again
+    char* pCanonicalFilename = realpath(pFilename, nullptr);
+    if (pCanonicalFilename) {
+        filename = pCanonicalFilename;
+        free(pCanonicalFilename);
+    }
+#endif
+    auto findTrace = [this, &filename]() {
+        return std::find_if(traces_.begin(), traces_.end(), [&filename](const std::shared_ptr<Trace>& pTrace) {
+            return pTrace->GetFilename() == filename;
+        });
+    };
+    Multithreading::Lock(&tracesLock_);
+    auto trace = findTrace();
+    traceId = trace - traces_.begin();
+    const bool isLoaded = trace != traces_.end();
+    Multithreading::Unlock(&tracesLock_);
+    if (isLoaded) {
+        return true;
+    }
+    // Parsed unlocked, the other clients keep looking traces up for their jobs meanwhile
+    std::shared_ptr<Trace> pTrace = Trace::Load(filename.c_str());
+    if (!pTrace) {
+        return false;
+    }
+    Multithreading::Lock(&tracesLock_);
+    // Another client may have loaded the same trace meanwhile, its copy is kept & this one dropped
+    trace = findTrace();
+    traceId = trace - traces_.begin();
+    if (trace == traces_.end()) {
+        traces_.push_back(pTrace);
+    }
+    Multithreading::Unlock(&tracesLock_);
+    return true;
+}
+
+bool Daemon::parseConfig(char* pLine, ConfigDescriptor& descriptor, char* pError, size_t errorSize) {
+    // Sized by the levels given
+    descriptor = Simulation::GetDefaultDescriptor(0);
+    char* pSavePointer = nullptr;
+    for (char* pToken = strtok_r(pLine, " \t\r\n", &pSavePointer); pToken;
+         pToken = strtok_r(nullptr, " \t\r\n", &pSavePointer)) {
+        int level;
+        char field[32];
+        uint64_t value;
+        LevelTiming* pTiming;
+        if (sscanf(pToken, "L%d_%31[A-Z_]=%" SCNu64, &level, field, &value) == 3) {
+            if (level < 1 || level > kMaxNumberOfCacheLevels) {
+                snprintf(pError, errorSize, "No cache level %d in %s", level, pToken);
+                return false;
+            }
+            descriptor.numberOfCacheLevels = std::max<uint8_t>(descriptor.numberOfCacheLevels, level);
+            Configuration& config = descriptor.configs[level - 1];
+            pTiming = &config.timing;
+            if (strcmp(field, "CACHE_SIZE") == 0) {
+                config.cacheSize = value;
+                continue;
+            } else if (strcmp(field, "BLOCK_SIZE") == 0) {
+                config.blockSize = value;
+                continue;
+            } else if (strcmp(field, "ASSOCIATIVITY") == 0) {
+                config.associativity = value;
+                continue;
+            }
+        } else if (sscanf(pToken, "MEMORY_%31[A-Z_]=%" SCNu64, field, &value) == 2) {
+            pTiming = &descriptor.mainMemoryTiming;
+        } else {
+            snprintf(pError, errorSize, "Expected <key>=<value>, got %s", pToken);
+            return false;
+        }
+        if (strcmp(field, "ACCESS_TIME") == 0) {
+            pTiming->accessTimeInCycles = value;
+        } else if (strcmp(field, "QUEUE_DEPTH") == 0) {
+            pTiming->maxOutstandingRequests = value;
+        } else {
+            snprintf(pError, errorSize, "Unknown key or invalid value in %s", pToken);
+            return false;
+        }
+    }
+    if (descriptor.numberOfCacheLevels == 0) {
+        snprintf(pError, errorSize, "Config has no cache levels");
+        return false;
+    }
+    return Simulation::IsDescriptorValid(descriptor, pError, errorSize);
+}
+
+void Daemon::runJob(const char* pRequest, FILE* pInStream, FILE* pOutStream) {
+    uint64_t traceId;
+    char mode[8];
+    // Errors quote the token at fault, which may be as long as a line
+    char error[kMaxRequestLineLength + 64] = "";
+    if (sscanf(pRequest, "JOB %" SCNu64 " %7s", &traceId, mode) != 2) {
+        snprintf(error, sizeof(error), "Expected JOB <trace id> <LRU|OPT|BOTH>");
+    }
+    std::vector<ReplacementPolicy> replacementPolicies;
+    for (int i = 0; i < kNumberOfReplacementPolicies && !error[0]; i++) {
+        if (strcmp(mode, kReplacementPolicyNames[i]) == 0 || strcmp(mode, kCompareToOptimalName) == 0) {
+            replacementPolicies.push_back(static_cast<ReplacementPolicy>(i));
+        }
+    }
+    if (replacementPolicies.empty() && !error[0]) {
+        snprintf(error, sizeof(error), "Unknown replacement policy %s", mode);
+    }
+    // Read the whole request even if it is invalid, so that the next one is read from its start
+    std::vector<ConfigDescriptor> configs;
+    char line[kMaxRequestLineLength];
+    bool isEnded = false;
+    while (fgets(line, sizeof(line), pInStream)) {
+        if (strncmp(line, "END", 3) == 0 && strspn(line + 3, " \t\r\n") == strlen(line + 3)) {
+            isEnded = true;
+            break;
+        }
+        ConfigDescriptor descriptor;
+        char configError[kMaxRequestLineLength + 32];
+        if (parseConfig(line, descriptor, configError, sizeof(configError))) {
+            configs.push_back(descriptor);
+        } else if (!error[0]) {
+            snprintf(error, sizeof(error), "Config %zu: %s", configs.size(), configError);
+        }
+    }
+    if (!isEnded) {
+        return;
+    }
+    if (configs.empty() && !error[0]) {
+        snprintf(error, sizeof(error), "Job has no configs");
+    }
+
+    std::shared_ptr<Trace> pTrace;
+    Multithreading::Lock(&tracesLock_);
+    if (!error[0] && traceId >= traces_.size()) {
+        snprintf(error, sizeof(error), "No trace with id %" PRIu64, traceId);
+    } else if (!error[0]) {
+        pTrace = traces_[traceId];
+    }
+    Multithreading::Unlock(&tracesLock_);
+    if (error[0]) {
+        fprintf(pOutStream, "ERROR %s\n", error);
+        fflush(pOutStream);
+        return;
+    }
+
+    std::vector<ConfigDescriptor> descriptors;
+    for (const ConfigDescriptor& config : configs) {
+        for (ReplacementPolicy replacementPolicy : replacementPolicies) {
+            ConfigDescriptor descriptor = config;
+            // kOPT at L1 only, as in the sweeps of the ini
+            descriptor.configs[kL1].replacementPolicy = replacementPolicy;
+            for (uint8_t i = 1; i < descriptor.numberOfCacheLevels; i++) {
+                descriptor.configs[i].replacementPolicy = kLRU;
+            }
+            descriptors.push_back(descriptor);
+        }
+    }
+    // Builds the next-use indices its kOPT configs need
+    Simulation simulation(pTrace, descriptors);
+    Multithreading::Lock(&lock_);
+    const uint64_t jobId = nextJobId_++;
+    Multithreading::Unlock(&lock_);
+    fprintf(pOutStream, "ACCEPTED %" PRIu64 " %" PRIu64 "\n", jobId, simulation.GetNumConfigs());
+    fflush(pOutStream);
+    pool_.Submit(simulation);
+
+    // Stream the results back as the workers complete them. The job is waited out even if the client is gone, the
+    // workers still use it
+    std::vector<uint64_t> completedConfigs;
+    while (simulation.WaitForCompleted(completedConfigs)) {
+        for (uint64_t configIndex : completedConfigs) {
+            fprintf(pOutStream, "RESULT %" PRIu64 " ", configIndex);
+            IOUtilities::PrintStatisticsCSV(simulation.GetDescriptor(configIndex), simulation.GetSummary(configIndex),
+                                            pOutStream);
+        }
+        fflush(pOutStream);
+    }
+    fprintf(pOutStream, "DONE %" PRIu64 "\n", jobId);
+    fflush(pOutStream);
+}
+
+#ifdef __linux__
+
+void* Daemon::ServeConnection(void* pConnectionPointer) {
+    DaemonConnection& connection = *static_cast<DaemonConnection*>(pConnectionPointer);
+    Daemon* pDaemon = connection.pDaemon;
+    FILE* pInStream = fdopen(connection.socket, "r");
+    FILE* pOutStream = fdopen(dup(connection.socket), "w");
+    char line[kMaxRequestLineLength];
+    while (pInStream && pOutStream && fgets(line, sizeof(line), pInStream)) {
+        char argument[kMaxRequestLineLength];
+        uint64_t traceId;
+        if (sscanf(line, "LOAD %1023[^\r\n]", argument) == 1) {
+            if (pDaemon->loadTrace(argument, traceId)) {
+                Multithreading::Lock(&pDaemon->tracesLock_);
+                const uint64_t numInstructions = pDaemon->traces_[traceId]->GetNumInstructions();
+                Multithreading::Unlock(&pDaemon->tracesLock_);
+                fprintf(pOutStream, "TRACE %" PRIu64 " %" PRIu64 "\n", traceId, numInstructions);
+            } else {
+                fprintf(pOutStream, "ERROR Unable to read trace file %s\n", argument);
+            }
+        } else if (strncmp(line, "JOB", 3) == 0) {
+            pDaemon->runJob(line, pInStream, pOutStream);
+        } else if (strncmp(line, "SHUTDOWN", 8) == 0) {
+            fprintf(pOutStream, "BYE\n");
+            pDaemon->isStopping_ = true;
+            // Wakes up the accept of Run
+            shutdown(pDaemon->listenSocket_, SHUT_RDWR);
+        } else {
+            fprintf(pOutStream, "ERROR Unknown request, expected LOAD, JOB or SHUTDOWN\n");
+        }
+        fflush(pOutStream);
+    }
+    Multithreading::Lock(&pDaemon->lock_);
+    if (pInStream) {
+        fclose(pInStream);
+    } else {
+        close(connection.socket);
+    }
+    if (pOutStream) {
+        fclose(pOutStream);
+    }
+    connection.isDone = true;
+    Multithreading::Unlock(&pDaemon->lock_);
+    pthread_exit(NULL);
+    return nullptr;
+}
+
+int Daemon::Run(const char* pSocketPath) {
+    int status = 0;
+    // A client that disconnects mid-job must not take the daemon down with it
+    signal(SIGPIPE, SIG_IGN);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    listenSocket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (strlen(pSocketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", pSocketPath);
+        status = 1;
+    } else {
+        strcpy(address.sun_path, pSocketPath);
+        unlink(pSocketPath);
+        if (listenSocket_ < 0 || bind(listenSocket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listenSocket_, SOMAXCONN) != 0) {
+            fprintf(stderr, "Unable to listen on %s: %s\n", pSocketPath, strerror(errno));
+            status = 1;
+        }
+    }
+    if (status == 0) {
+        printf("Serving on %s with %" PRIu64 " workers\n", pSocketPath, pool_.GetNumWorkers());
+        fflush(stdout);
+    }
+    while (status == 0 && !isStopping_) {
+        const int connectionSocket = accept(listenSocket_, nullptr, nullptr);
+        if (connectionSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        // Join the threads of the clients that are gone
+        Multithreading::Lock(&lock_);
+        for (auto connection = connections_.begin(); connection != connections_.end();) {
+            if ((*connection)->isDone) {
+                Multithreading::WaitForThreads(std::vector<Thread_t>(1, (*connection)->thread));
+                connection = connections_.erase(connection);
+            } else {
+                connection++;
+            }
+        }
+        connections_.push_back(std::make_unique<DaemonConnection>(DaemonConnection{this, connectionSocket, {}, false}));
+        DaemonConnection* pConnection = connections_.back().get();
+        Multithreading::StartThread(Daemon::ServeConnection, static_cast<void*>(pConnection), &pConnection->thread);
+        Multithreading::Unlock(&lock_);
+    }
+
+    // Stop reading from the clients left, the jobs they are running still get their results
+    Multithreading::Lock(&lock_);
+    std::vector<Thread_t> connectionThreads;
+    for (const std::unique_ptr<DaemonConnection>& pConnection : connections_) {
+        if (!pConnection->isDone) {
+            shutdown(pConnection->socket, SHUT_RD);
+        }
+        connectionThreads.push_back(pConnection->thread);
+    }
+    Multithreading::Unlock(&lock_);
+    Multithreading::WaitForThreads(connectionThreads);
+    connections_.clear();
+    if (listenSocket_ >= 0) {
+        close(listenSocket_);
+    }
+    if (status == 0) {
+        unlink(pSocketPath);
+    }
+    return status;
+}
+
+#else
+
+#ifdef _MSC_VER
+DWORD WINAPI Daemon::ServeConnection(void*) {
+    return 0;
+}
+#else
+void* Daemon::ServeConnection(void*) {
+    return nullptr;
+}
+#endif
+
+int Daemon::Run(const char*) {
+    fprintf(stderr, "Daemon mode is only supported on Linux\n");
+    return 1;
+}
+
+#endif
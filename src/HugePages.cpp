@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <inttypes.h>
+#include <new>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "HugePages.h"
+#include "TagMatch.h"
+
+static const char* kHugePageBackingDescriptions[] = {"with hugetlbfs huge pages", "advised for transparent huge pages",
+                                                     "from the heap"};
+
+HugePageUsage::HugePageUsage() {
+    Multithreading::InitializeLock(&lock_);
+}
+
+void HugePageUsage::RecordAllocation(const void* pBuffer, uint64_t sizeInBytes, HugePageBacking backing) {
+    Multithreading::Lock(&lock_);
+    if (sizeInBytes >= kHugePageSizeInBytes) {
+        largeBufferBackings_[pBuffer] = backing;
+    }
+    liveBytes_[backing] += sizeInBytes;
+    peakBytes_[backing] = std::max(peakBytes_[backing], liveBytes_[backing]);
+    Multithreading::Unlock(&lock_);
+}
+
+void HugePageUsage::RecordFree(const void* pBuffer, uint64_t sizeInBytes) {
+    Multithreading::Lock(&lock_);
+    HugePageBacking backing = kHeap;
+    auto largeBuffer = largeBufferBackings_.find(pBuffer);
+    if (largeBuffer != largeBufferBackings_.end()) {
+        backing = largeBuffer->second;
+        largeBufferBackings_.erase(largeBuffer);
+    }
+    liveBytes_[backing] -= sizeInBytes;
+    Multithreading::Unlock(&lock_);
+}
+
+void HugePageUsage::PrintSummary(FILE* stream) {
+    constexpr uint64_t kBytesPerMB = 1024 * 1024;
+    Multithreading::Lock(&lock_);
+    fprintf(stream, "Large buffers at their peak:");
+    for (uint8_t backing = 0; backing < kNumberOfHugePageBackings; backing++) {
+        fprintf(stream, "%s %" PRIu64 " MB %s", backing ? "," : "", peakBytes_[backing] / kBytesPerMB,
+                kHugePageBackingDescriptions[backing]);
+    }
+    fprintf(stream, "\n");
+    Multithreading::Unlock(&lock_);
+#ifdef __linux__
+    // Whether transparent huge pages were granted is up to the kernel, read back how much memory they back now
+    FILE* pSmaps = fopen("/proc/self/smaps_rollup", "r");
+    if (pSmaps == nullptr) {
+        return;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), pSmaps)) {
+        uint64_t anonHugePagesInKB;
+        if (sscanf(line, "AnonHugePages: %" SCNu64 " kB", &anonHugePagesInKB) == 1) {
+            fprintf(stream, "Memory currently backed by transparent huge pages: %" PRIu64 " MB\n",
+                    anonHugePagesInKB / 1024);
+            break;
+        }
+    }
+    fclose(pSmaps);
+#endif
+}
+
+static uint64_t roundUpToHugePage(uint64_t sizeInBytes) {
+    return (sizeInBytes + kHugePageSizeInBytes - 1) / kHugePageSizeInBytes * kHugePageSizeInBytes;
+}
+
+void* HugePages::Allocate(uint64_t sizeInBytes, HugePageUsage* pUsage) {
+#ifdef __linux__
+    if (sizeInBytes >= kHugePageSizeInBytes) {
+        const uint64_t mappedSize = roundUpToHugePage(sizeInBytes);
+        void* pBuffer =
+            mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pBuffer != MAP_FAILED) {
+            if (pUsage) {
+                pUsage->RecordAllocation(pBuffer, sizeInBytes, kHugetlbfs);
+            }
+            return pBuffer;
+        }
+        // No hugetlbfs pool, or not enough free pages in it. Over-map by a huge page so the buffer can start on a huge
+        // page boundary, otherwise the kernel could not back its first & last few MB with huge pages
+        void* pMapping =
+            mmap(nullptr, mappedSize + kHugePageSizeInBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pMapping != MAP_FAILED) {
+            const uint64_t mappingAddress = reinterpret_cast<uint64_t>(pMapping);
+            const uint64_t headSize = roundUpToHugePage(mappingAddress) - mappingAddress;
+            uint8_t* pAligned = static_cast<uint8_t*>(pMapping) + headSize;
+            if (headSize) {
+                munmap(pMapping, headSize);
+            }
+            munmap(pAligned + mappedSize, kHugePageSizeInBytes - headSize);
+            // Fails harmlessly when transparent huge pages are disabled
+            madvise(pAligned, mappedSize, MADV_HUGEPAGE);
+            if (pUsage) {
+                pUsage->RecordAllocation(pAligned, sizeInBytes, kTransparentHugePages);
+            }
+            return pAligned;
+        }
+        // Not falling back to the heap, as Free tells a mapped buffer from a heap one by its size alone
+        throw std::bad_alloc();
+    }
+#endif
+    void* pBuffer = ::operator new(sizeInBytes, std::align_val_t(kCacheLineSizeInBytes));
+    if (pUsage) {
+        pUsage->RecordAllocation(pBuffer, sizeInBytes, kHeap);
+    }
+    return pBuffer;
+}
+
+void HugePages::Free(void* pBuffer, uint64_t sizeInBytes, HugePageUsage* pUsage) {
+    if (pUsage) {
+        pUsage->RecordFree(pBuffer, sizeInBytes);
+    }
+#ifdef __linux__
+    if (sizeInBytes >= kHugePageSizeInBytes) {
+        munmap(pBuffer, roundUpToHugePage(sizeInBytes));
+        return;
+    }
+#endif
+    ::operator delete(pBuffer, std::align_val_t(kCacheLineSizeInBytes));
+}
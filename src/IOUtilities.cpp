@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <new>
 #include <vector>
 
 #include "Cache.h"
@@ -12,142 +13,347 @@
 #include "debug.h"
 #include "default_test_params.h"
 
-extern TestParamaters gTestParams;
 const char kParametersFilename[] = "./test_params.ini";
 
-void IOUtilities::PrintStatistics(Memory& memory, uint64_t cycle, FILE* stream) {
+// Prefix of the per-level keys of the ini, main memory included
+static void getLevelParameterPrefix(int cacheLevel, char (&prefix)[16]) {
+    if (cacheLevel == kMainMemory) {
+        snprintf(prefix, sizeof(prefix), "MEMORY");
+    } else {
+        snprintf(prefix, sizeof(prefix), "L%d", cacheLevel + 1);
+    }
+}
+const char* kReplacementPolicyNames[] = {"LRU", "OPT"};
+const char kCompareToOptimalName[] = "BOTH";
+const char kPartialResultsMagic[] = "CACHE_PARTIAL_RESULTS_3";
 
-    const Statistics& stats = memory.ViewStats();
-    CacheLevel cache_level = memory.GetCacheLevel();
-    if (cache_level == kMainMemory) {
-        return;
+void IOUtilities::PrintResults(const std::vector<ConfigDescriptor>& descriptors,
+                               const std::vector<ConfigSummary>& summaries, bool compareToOptimal, FILE* pTextStream,
+                               FILE* pCSVStream) {
+    PrintCSVHeader(descriptors[0].numberOfCacheLevels, pCSVStream);
+    LowestCpi lowestCpi;
+    for (uint64_t i = 0; i < descriptors.size(); i++) {
+        PrintResult(descriptors, summaries, compareToOptimal, i, lowestCpi, pTextStream, pCSVStream);
     }
-    Cache& cache = static_cast<Cache&>(memory);
-    Configuration& config = cache.GetConfig();
-    if (cache_level == kL1) {
-        fprintf(stream, "=========================\n");
-    } else {
-        fprintf(stream, "-------------------------\n");
+    PrintLowestCpi(descriptors, lowestCpi, pTextStream);
+}
+
+void IOUtilities::PrintResult(const std::vector<ConfigDescriptor>& descriptors,
+                              const std::vector<ConfigSummary>& summaries, bool compareToOptimal, uint64_t configIndex,
+                              LowestCpi& lowestCpi, FILE* pTextStream, FILE* pCSVStream) {
+    const uint64_t i = configIndex;
+    PrintStatistics(descriptors[i], summaries[i], pTextStream);
+    PrintStatisticsCSV(descriptors[i], summaries[i], pCSVStream);
+    // When comparing to optimal, every odd config is the kOPT twin of the one before it. It is a bound rather than a
+    // buildable config, so it does not compete for the lowest CPI
+    if (compareToOptimal && (i & 1)) {
+        PrintOptimalGap(summaries[i - 1], summaries[i], pTextStream);
+        return;
     }
-    fprintf(stream, "CACHE LEVEL %d\n", cache_level);
-    fprintf(stream, "size=%" PRIu64 "B, block_size=%" PRIu64 "B, associativity=%" PRIu64 "\n", config.cacheSize,
-            config.blockSize, config.associativity);
-    uint64_t numberOfReads = stats.readHits + stats.readMisses;
-    uint64_t numberOfWrites = stats.writeHits + stats.writeMisses;
-    float read_miss_rate = static_cast<float>(stats.readMisses) / numberOfReads;
-    float write_miss_rate = static_cast<float>(stats.writeMisses) / numberOfWrites;
-    float total_miss_rate = static_cast<float>(stats.readMisses + stats.writeMisses) / (numberOfWrites + numberOfReads);
-    fprintf(stream, "Number of reads:    %08" PRIu64 "\n", stats.readHits + stats.readMisses);
-    fprintf(stream, "Read miss rate:     %7.3f%%\n", 100.f * read_miss_rate);
-    fprintf(stream, "Number of writes:   %08" PRIu64 "\n", stats.writeHits + stats.writeMisses);
-    fprintf(stream, "Write miss rate:    %7.3f%%\n", 100.0f * write_miss_rate);
-    fprintf(stream, "Total miss rate:    %7.3f%%\n", 100.0f * total_miss_rate);
-    if (cache_level == gTestParams.numberOfCacheLevels - 1) {
-        fprintf(stream, "-------------------------\n");
-        fprintf(stream, "Main memory reads:  %08" PRIu64 "\n", stats.readMisses + stats.writeMisses);
-        fprintf(stream, "Main memory writes: %08" PRIu64 "\n\n", stats.writebacks);
-        fprintf(stream, "Total number of cycles: %010" PRIu64 "\n", cycle);
-        const Statistics& topLevelStats = cache.GetTopLevelCache()->ViewStats();
-        float cpi = static_cast<float>(cycle) / (topLevelStats.numInstructions);
-        fprintf(stream, "CPI: %.4f\n", cpi);
-        fprintf(stream, "=========================\n\n");
-    } else {
-        PrintStatistics(memory.GetLowerCache(), cycle, stream);
+    float cpi = static_cast<float>(summaries[i].cycles) / (summaries[i].stats[kL1].numInstructions);
+    if (cpi < lowestCpi.cpi) {
+        lowestCpi.cpi = cpi;
+        lowestCpi.configIndex = i;
     }
 }
 
-void IOUtilities::PrintStatisticsCSV(Memory& memory, uint64_t cycle, FILE* stream) {
-    const Statistics& stats = memory.ViewStats();
-    CacheLevel cache_level = memory.GetCacheLevel();
-    if (cache_level == kMainMemory) {
+void IOUtilities::PrintLowestCpi(const std::vector<ConfigDescriptor>& descriptors, const LowestCpi& lowestCpi,
+                                 FILE* pTextStream) {
+    fprintf(pTextStream, "The config with the lowest CPI of %.4f:\n", lowestCpi.cpi);
+    PrintConfiguration(descriptors[lowestCpi.configIndex], pTextStream);
+}
+
+void IOUtilities::PrintCSVHeader(uint8_t numberOfCacheLevels, FILE* pCSVStream) {
+    if (pCSVStream == nullptr) {
         return;
     }
-    Cache& cache = static_cast<Cache&>(memory);
-    Configuration& config = cache.GetConfig();
+    for (int i = 1; i <= numberOfCacheLevels; i++) {
+        fprintf(pCSVStream, "L%d cache size,L%d block size,L%d associativity,L%d replacement policy,L%d access "
+                            "time,L%d max outstanding requests,L%d reads,L%d read miss rate,L%d writes,L%d write "
+                            "miss rate,L%d total miss rate,", i, i, i, i, i, i, i, i, i, i, i);
+        fprintf(pCSVStream, "L%d latency p50,L%d latency p90,L%d latency p99,L%d max latency,", i, i, i, i);
+    }
+    fprintf(pCSVStream, "Main memory access time,Main memory max outstanding requests,Main memory reads,Main memory "
+                        "writes,Total number of cycles,CPI\n");
+}
+
+void IOUtilities::PrintStatistics(const ConfigDescriptor& descriptor, const ConfigSummary& summary, FILE* stream) {
+    for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+        const Configuration& config = descriptor.configs[cacheLevel];
+        const Statistics& stats = summary.stats[cacheLevel];
+        if (cacheLevel == kL1) {
+            fprintf(stream, "=========================\n");
+        } else {
+            fprintf(stream, "-------------------------\n");
+        }
+        fprintf(stream, "CACHE LEVEL %d\n", cacheLevel);
+        fprintf(stream, "size=%" PRIu64 "B, block_size=%" PRIu64 "B, associativity=%" PRIu64 ", replacement=%s\n",
+                config.cacheSize, config.blockSize, config.associativity,
+                kReplacementPolicyNames[config.replacementPolicy]);
+        fprintf(stream, "access_time=%" PRIu64 " cycles, max_outstanding_requests=%" PRIu64 "\n",
+                config.timing.accessTimeInCycles, config.timing.maxOutstandingRequests);
+        uint64_t numberOfReads = stats.readHits + stats.readMisses;
+        uint64_t numberOfWrites = stats.writeHits + stats.writeMisses;
+        float read_miss_rate = static_cast<float>(stats.readMisses) / numberOfReads;
+        float write_miss_rate = static_cast<float>(stats.writeMisses) / numberOfWrites;
+        float total_miss_rate =
+            static_cast<float>(stats.readMisses + stats.writeMisses) / (numberOfWrites + numberOfReads);
+        fprintf(stream, "Number of reads:    %08" PRIu64 "\n", stats.readHits + stats.readMisses);
+        fprintf(stream, "Read miss rate:     %7.3f%%\n", 100.f * read_miss_rate);
+        fprintf(stream, "Number of writes:   %08" PRIu64 "\n", stats.writeHits + stats.writeMisses);
+        fprintf(stream, "Write miss rate:    %7.3f%%\n", 100.0f * write_miss_rate);
+        fprintf(stream, "Total miss rate:    %7.3f%%\n", 100.0f * total_miss_rate);
+        const LatencySummary& latency = summary.latencies[cacheLevel];
+        fprintf(stream, "Latency (cycles):   p50 %" PRIu64 ", p90 %" PRIu64 ", p99 %" PRIu64 ", max %" PRIu64 "\n",
+                latency.p50, latency.p90, latency.p99, latency.max);
+    }
+    const Statistics& lastLevelStats = summary.stats[descriptor.numberOfCacheLevels - 1];
+    fprintf(stream, "-------------------------\n");
+    fprintf(stream, "MAIN MEMORY\n");
+    fprintf(stream, "access_time=%" PRIu64 " cycles, max_outstanding_requests=%" PRIu64 "\n",
+            descriptor.mainMemoryTiming.accessTimeInCycles, descriptor.mainMemoryTiming.maxOutstandingRequests);
+    fprintf(stream, "Main memory reads:  %08" PRIu64 "\n", lastLevelStats.readMisses + lastLevelStats.writeMisses);
+    fprintf(stream, "Main memory writes: %08" PRIu64 "\n\n", lastLevelStats.writebacks);
+    fprintf(stream, "Total number of cycles: %010" PRIu64 "\n", summary.cycles);
+    float cpi = static_cast<float>(summary.cycles) / (summary.stats[kL1].numInstructions);
+    fprintf(stream, "CPI: %.4f\n", cpi);
+    fprintf(stream, "=========================\n\n");
+}
+
+void IOUtilities::PrintStatisticsCSV(const ConfigDescriptor& descriptor, const ConfigSummary& summary, FILE* stream) {
     if (stream == nullptr) {
         return;
     }
-    fprintf(stream, "%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",", cache_level, config.cacheSize, config.blockSize,
-            config.associativity);
-    uint64_t numberOfReads = stats.readHits + stats.readMisses;
-    uint64_t numberOfWrites = stats.writeHits + stats.writeMisses;
-    float read_miss_rate = static_cast<float>(stats.readMisses) / numberOfReads;
-    float write_miss_rate = static_cast<float>(stats.writeMisses) / numberOfWrites;
-    float total_miss_rate = static_cast<float>(stats.readMisses + stats.writeMisses) / (numberOfReads + numberOfWrites);
-    fprintf(stream, "%08" PRIu64 ",%7.3f%%,%08" PRIu64 ",%7.3f%%,%7.3f%%,", numberOfWrites, 100.f * read_miss_rate,
-            numberOfWrites, 100.0f * write_miss_rate, 100.0f * total_miss_rate);
-    if (cache_level == gTestParams.numberOfCacheLevels - 1) {
-        fprintf(stream, "%08" PRIu64 ",%08" PRIu64 ",%010" PRIu64 ",", stats.readMisses + stats.writeMisses,
-                stats.writebacks, cycle);
-        const Statistics& topLevelStats = cache.GetTopLevelCache()->ViewStats();
-        float cpi = static_cast<float>(cycle) / (topLevelStats.numInstructions);
-        fprintf(stream, "%.4f\n", cpi);
-    } else {
-        PrintStatisticsCSV(memory.GetLowerCache(), cycle, stream);
+    for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+        const Configuration& config = descriptor.configs[cacheLevel];
+        const Statistics& stats = summary.stats[cacheLevel];
+        fprintf(stream, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s,%" PRIu64 ",%" PRIu64 ",", config.cacheSize,
+                config.blockSize, config.associativity,
+                kReplacementPolicyNames[config.replacementPolicy], config.timing.accessTimeInCycles,
+                config.timing.maxOutstandingRequests);
+        uint64_t numberOfReads = stats.readHits + stats.readMisses;
+        uint64_t numberOfWrites = stats.writeHits + stats.writeMisses;
+        float read_miss_rate = static_cast<float>(stats.readMisses) / numberOfReads;
+        float write_miss_rate = static_cast<float>(stats.writeMisses) / numberOfWrites;
+        float total_miss_rate =
+            static_cast<float>(stats.readMisses + stats.writeMisses) / (numberOfReads + numberOfWrites);
+        fprintf(stream, "%08" PRIu64 ",%7.3f%%,%08" PRIu64 ",%7.3f%%,%7.3f%%,", numberOfReads, 100.f * read_miss_rate,
+                numberOfWrites, 100.0f * write_miss_rate, 100.0f * total_miss_rate);
+        const LatencySummary& latency = summary.latencies[cacheLevel];
+        fprintf(stream, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",", latency.p50, latency.p90, latency.p99,
+                latency.max);
     }
+    const Statistics& lastLevelStats = summary.stats[descriptor.numberOfCacheLevels - 1];
+    fprintf(stream, "%" PRIu64 ",%" PRIu64 ",", descriptor.mainMemoryTiming.accessTimeInCycles,
+            descriptor.mainMemoryTiming.maxOutstandingRequests);
+    fprintf(stream, "%08" PRIu64 ",%08" PRIu64 ",%010" PRIu64 ",", lastLevelStats.readMisses + lastLevelStats.writeMisses,
+            lastLevelStats.writebacks, summary.cycles);
+    float cpi = static_cast<float>(summary.cycles) / (summary.stats[kL1].numInstructions);
+    fprintf(stream, "%.4f\n", cpi);
 }
 
-void IOUtilities::PrintConfiguration(Memory& memory, FILE* stream) {
-    CacheLevel cache_level = memory.GetCacheLevel();
-    if (cache_level == kMainMemory) {
-        fprintf(stream, "=========================\n\n");
-        return;
+void IOUtilities::PrintStatisticsJSON(const ConfigDescriptor& descriptor, const ConfigSummary& summary,
+                                      uint64_t configIndex, FILE* stream) {
+    fprintf(stream, "{\"config\":%" PRIu64 ",\"levels\":[", configIndex);
+    for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+        const Configuration& config = descriptor.configs[cacheLevel];
+        const Statistics& stats = summary.stats[cacheLevel];
+        const LatencySummary& latency = summary.latencies[cacheLevel];
+        fprintf(stream, "%s{\"cache_size\":%" PRIu64 ",\"block_size\":%" PRIu64 ",\"associativity\":%" PRIu64
+                        ",\"replacement_policy\":\"%s\",\"access_time\":%" PRIu64
+                        ",\"max_outstanding_requests\":%" PRIu64,
+                cacheLevel ? "," : "", config.cacheSize, config.blockSize, config.associativity,
+                kReplacementPolicyNames[config.replacementPolicy], config.timing.accessTimeInCycles,
+                config.timing.maxOutstandingRequests);
+        fprintf(stream, ",\"read_hits\":%" PRIu64 ",\"read_misses\":%" PRIu64 ",\"write_hits\":%" PRIu64
+                        ",\"write_misses\":%" PRIu64 ",\"writebacks\":%" PRIu64,
+                stats.readHits, stats.readMisses, stats.writeHits, stats.writeMisses, stats.writebacks);
+        fprintf(stream, ",\"latency\":{\"count\":%" PRIu64 ",\"p50\":%" PRIu64 ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64
+                        ",\"max\":%" PRIu64 "}}",
+                latency.count, latency.p50, latency.p90, latency.p99, latency.max);
     }
-    Cache& cache = static_cast<Cache&>(memory);
-    Configuration& config = cache.GetConfig();
-    if (cache_level == 0) {
-        fprintf(stream, "=========================\n");
-    } else {
-        fprintf(stream, "-------------------------\n");
+    const uint64_t numInstructions = summary.stats[kL1].numInstructions;
+    fprintf(stream, "],\"main_memory\":{\"access_time\":%" PRIu64 ",\"max_outstanding_requests\":%" PRIu64
+                    "},\"instructions\":%" PRIu64 ",\"cycles\":%" PRIu64 ",\"cpi\":%.6f}\n",
+            descriptor.mainMemoryTiming.accessTimeInCycles, descriptor.mainMemoryTiming.maxOutstandingRequests,
+            numInstructions, summary.cycles,
+            numInstructions ? static_cast<double>(summary.cycles) / static_cast<double>(numInstructions) : 0.0);
+}
+
+void IOUtilities::PrintOptimalGap(const ConfigSummary& summary, const ConfigSummary& optimal, FILE* stream) {
+    fprintf(stream, "=========================\n");
+    fprintf(stream, "GAP TO OPTIMAL REPLACEMENT\n");
+    // L1 only, the twins differ in its replacement alone. The levels below run kLRU in both & see different streams
+    const Statistics& stats = summary.stats[kL1];
+    const Statistics& optimalStats = optimal.stats[kL1];
+    uint64_t numberOfAccesses = stats.readHits + stats.readMisses + stats.writeHits + stats.writeMisses;
+    uint64_t optimalNumberOfAccesses =
+        optimalStats.readHits + optimalStats.readMisses + optimalStats.writeHits + optimalStats.writeMisses;
+    float total_miss_rate = static_cast<float>(stats.readMisses + stats.writeMisses) / numberOfAccesses;
+    float optimal_total_miss_rate =
+        static_cast<float>(optimalStats.readMisses + optimalStats.writeMisses) / optimalNumberOfAccesses;
+    fprintf(stream, "L1 miss rate:   LRU %7.3f%%, OPT %7.3f%%, gap %7.3f%%\n", 100.0f * total_miss_rate,
+            100.0f * optimal_total_miss_rate, 100.0f * (total_miss_rate - optimal_total_miss_rate));
+    const uint64_t numInstructions = summary.stats[kL1].numInstructions;
+    float cpi = static_cast<float>(summary.cycles) / numInstructions;
+    float optimalCpi = static_cast<float>(optimal.cycles) / numInstructions;
+    fprintf(stream, "CPI:            LRU %.4f, OPT %.4f, gap %.4f\n", cpi, optimalCpi, cpi - optimalCpi);
+    fprintf(stream, "=========================\n\n");
+}
+
+void IOUtilities::PrintConfiguration(const ConfigDescriptor& descriptor, FILE* stream) {
+    for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+        const Configuration& config = descriptor.configs[cacheLevel];
+        if (cacheLevel == 0) {
+            fprintf(stream, "=========================\n");
+        } else {
+            fprintf(stream, "-------------------------\n");
+        }
+        fprintf(stream, "CACHE LEVEL %d\n", cacheLevel);
+        fprintf(stream, "size=%" PRIu64 "B, block_size=%" PRIu64 "B, associativity=%" PRIu64 ", replacement=%s\n",
+                config.cacheSize, config.blockSize, config.associativity,
+                kReplacementPolicyNames[config.replacementPolicy]);
+        fprintf(stream, "access_time=%" PRIu64 " cycles, max_outstanding_requests=%" PRIu64 "\n",
+                config.timing.accessTimeInCycles, config.timing.maxOutstandingRequests);
+    }
+    fprintf(stream, "-------------------------\n");
+    fprintf(stream, "MAIN MEMORY\n");
+    fprintf(stream, "access_time=%" PRIu64 " cycles, max_outstanding_requests=%" PRIu64 "\n",
+            descriptor.mainMemoryTiming.accessTimeInCycles, descriptor.mainMemoryTiming.maxOutstandingRequests);
+    fprintf(stream, "=========================\n\n");
+}
+
+void IOUtilities::WritePartialResults(const PartialResults& results, FILE* stream) {
+    fprintf(stream, "%s %" PRIu64 " %" PRIu64 " %" PRIu64 " %d %016" PRIx64 " %zu\n", kPartialResultsMagic,
+            results.shardIndex, results.numShards, results.numConfigs, results.compareToOptimal ? 1 : 0,
+            results.sweepFingerprint, results.configIndices.size());
+    for (uint64_t i = 0; i < results.configIndices.size(); i++) {
+        const ConfigDescriptor& descriptor = results.descriptors[i];
+        const ConfigSummary& summary = results.summaries[i];
+        // One line per config: index, levels, then per level its config, statistics & latency percentiles, then main
+        // memory & cycles
+        fprintf(stream, "%" PRIu64 " %d", results.configIndices[i], descriptor.numberOfCacheLevels);
+        for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+            const Configuration& config = descriptor.configs[cacheLevel];
+            const Statistics& stats = summary.stats[cacheLevel];
+            const LatencySummary& latency = summary.latencies[cacheLevel];
+            fprintf(stream,
+                    " %" PRIu64 " %" PRIu64 " %" PRIu64 " %d %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+                    " %" PRIu64 " %" PRIu64 " %" PRIu64,
+                    config.cacheSize, config.blockSize, config.associativity, config.replacementPolicy,
+                    config.timing.accessTimeInCycles, config.timing.maxOutstandingRequests, stats.writeHits,
+                    stats.readHits, stats.writeMisses, stats.readMisses, stats.writebacks, stats.numInstructions);
+            fprintf(stream, " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64, latency.count, latency.p50,
+                    latency.p90, latency.p99, latency.max);
+        }
+        fprintf(stream, " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", descriptor.mainMemoryTiming.accessTimeInCycles,
+                descriptor.mainMemoryTiming.maxOutstandingRequests, summary.cycles);
+    }
+}
+
+bool IOUtilities::ReadPartialResults(FILE* stream, PartialResults& results) {
+    char magic[sizeof(kPartialResultsMagic)];
+    int compareToOptimal;
+    uint64_t numResults;
+    if (fscanf(stream, "%23s %" SCNu64 " %" SCNu64 " %" SCNu64 " %d %" SCNx64 " %" SCNu64, magic, &results.shardIndex,
+               &results.numShards, &results.numConfigs, &compareToOptimal, &results.sweepFingerprint,
+               &numResults) != 7 ||
+        strcmp(magic, kPartialResultsMagic) != 0 || results.shardIndex >= results.numShards) {
+        return false;
+    }
+    results.compareToOptimal = compareToOptimal != 0;
+    results.configIndices = std::vector<uint64_t>(numResults);
+    results.descriptors = std::vector<ConfigDescriptor>(numResults);
+    results.summaries = std::vector<ConfigSummary>(numResults);
+    for (uint64_t i = 0; i < numResults; i++) {
+        ConfigDescriptor& descriptor = results.descriptors[i];
+        ConfigSummary& summary = results.summaries[i];
+        int numberOfCacheLevels;
+        if (fscanf(stream, "%" SCNu64 " %d", &results.configIndices[i], &numberOfCacheLevels) != 2 ||
+            numberOfCacheLevels < 1 || numberOfCacheLevels > kMaxNumberOfCacheLevels) {
+            return false;
+        }
+        descriptor.numberOfCacheLevels = static_cast<uint8_t>(numberOfCacheLevels);
+        for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+            Configuration& config = descriptor.configs[cacheLevel];
+            Statistics& stats = summary.stats[cacheLevel];
+            LatencySummary& latency = summary.latencies[cacheLevel];
+            int replacementPolicy;
+            if (fscanf(stream,
+                       "%" SCNu64 " %" SCNu64 " %" SCNu64 " %d %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+                       " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                       &config.cacheSize, &config.blockSize, &config.associativity, &replacementPolicy,
+                       &config.timing.accessTimeInCycles, &config.timing.maxOutstandingRequests, &stats.writeHits,
+                       &stats.readHits, &stats.writeMisses, &stats.readMisses, &stats.writebacks,
+                       &stats.numInstructions) != 12 ||
+                replacementPolicy < 0 || replacementPolicy >= kNumberOfReplacementPolicies) {
+                return false;
+            }
+            if (fscanf(stream, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, &latency.count,
+                       &latency.p50, &latency.p90, &latency.p99, &latency.max) != 5) {
+                return false;
+            }
+            config.replacementPolicy = static_cast<ReplacementPolicy>(replacementPolicy);
+        }
+        if (fscanf(stream, "%" SCNu64 " %" SCNu64 " %" SCNu64, &descriptor.mainMemoryTiming.accessTimeInCycles,
+                   &descriptor.mainMemoryTiming.maxOutstandingRequests, &summary.cycles) != 3) {
+            return false;
+        }
     }
-    fprintf(stream, "CACHE LEVEL %d\n", cache_level);
-    fprintf(stream, "size=%" PRIu64 "B, block_size=%" PRIu64 "B, associativity=%" PRIu64 "\n", config.cacheSize,
-            config.blockSize, config.associativity);
-    PrintConfiguration(memory.GetLowerCache(), stream);
+    return true;
 }
 
-void IOUtilities::verify_test_params(void) {
+void IOUtilities::verify_test_params(const TestParamaters& params) {
     // Check that all values were read in correctly
     int line_number = 1;
-    if (!gTestParams.numberOfCacheLevels)
+    if (!params.numberOfCacheLevels)
         goto verify_fail;
     line_number++;
-    if (!gTestParams.minBlockSize[0])
+    if (!params.minBlockSize[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.maxBlockSize[0])
+    if (!params.maxBlockSize[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.minCacheSize[0])
+    if (!params.minCacheSize[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.maxCacheSize[0])
+    if (!params.maxCacheSize[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.minBlocksPerSet[0])
+    if (!params.minBlocksPerSet[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.maxBlocksPerSet[0])
+    if (!params.maxBlocksPerSet[0])
         goto verify_fail;
     line_number++;
-    if (!gTestParams.maxNumberOfThreads)
+    if (!params.maxNumberOfThreads)
+        goto verify_fail;
+    line_number++;
+    if (params.replacementPolicy == kNumberOfReplacementPolicies)
         goto verify_fail;
 
     // Check that values make sense. May help in understanding why a parameter config
     // will be found to have 0 possible cache configs
-    assert_release(gTestParams.numberOfCacheLevels <= kMaxNumberOfCacheLevels);
+    assert_release(params.numberOfCacheLevels <= kMaxNumberOfCacheLevels);
     for (int i = 0; i < kMaxNumberOfCacheLevels; i++) {
-        assert_release(gTestParams.minBlockSize[i] <= gTestParams.maxBlockSize[i]);
-        assert_release(gTestParams.minCacheSize[i] <= gTestParams.maxCacheSize[i]);
-        assert_release(gTestParams.minCacheSize[i] >= gTestParams.minBlockSize[i]);
-        assert_release(gTestParams.minBlocksPerSet[i]);
-        assert_release(gTestParams.maxBlocksPerSet[i]);
-        assert_release(gTestParams.maxBlocksPerSet[i] >= gTestParams.minBlocksPerSet[i]);
+        assert_release(params.minBlockSize[i] <= params.maxBlockSize[i]);
+        assert_release(params.minCacheSize[i] <= params.maxCacheSize[i]);
+        assert_release(params.minCacheSize[i] >= params.minBlockSize[i]);
+        assert_release(params.minBlocksPerSet[i]);
+        assert_release(params.maxBlocksPerSet[i]);
+        assert_release(params.maxBlocksPerSet[i] >= params.minBlocksPerSet[i]);
+    }
+    for (int i = 0; i <= kMaxNumberOfCacheLevels; i++) {
+        assert_release(params.minAccessTimeInCycles[i]);
+        assert_release(params.maxAccessTimeInCycles[i] >= params.minAccessTimeInCycles[i]);
+        assert_release(params.minOutstandingRequests[i]);
+        assert_release(params.maxOutstandingRequests[i] >= params.minOutstandingRequests[i]);
     }
-    assert_release(gTestParams.numberOfCacheLevels <= kMaxNumberOfCacheLevels &&
-                   "Update kAccessTimeInCycles & enum cache_levels");
+    assert_release(params.numberOfCacheLevels <= kMaxNumberOfCacheLevels &&
+                   "Update kDefaultAccessTimeInCycles, kDefaultMaxOutstandingRequests & enum cache_levels");
 #if (CONSOLE_PRINT == 1)
-    if (gTestParams.maxNumberOfThreads > 1) {
+    if (params.maxNumberOfThreads > 1) {
         printf("WARNING: Console printing with multiple threads is not recommended. Do you wish to continue? [Y/n]\n");
         char ret = 'n';
         assert_release(scanf("%c", &ret) == 1);
@@ -163,7 +369,8 @@ verify_fail:
     exit(1);
 }
 
-void IOUtilities::LoadTestParameters(void) {
+void IOUtilities::LoadTestParameters(TestParamaters& params) {
+    params = TestParamaters();
     FILE* params_f = fopen(kParametersFilename, "r");
     // If file does not exist, generate a default
     if (params_f == NULL) {
@@ -179,77 +386,145 @@ void IOUtilities::LoadTestParameters(void) {
             fprintf(params_f, "L%d_MAX_ASSOCIATIVITY=%d\n", i + 1, MAX_ASSOCIATIVITY);
         }
         fprintf(params_f, "MAX_NUM_THREADS=%d\n", MAX_NUM_THREADS);
+        fprintf(params_f, "REPLACEMENT_POLICY=%s\n", REPLACEMENT_POLICY);
+        for (int i = 0; i <= kMaxNumberOfCacheLevels; i++) {
+            char level[16];
+            getLevelParameterPrefix(i, level);
+            fprintf(params_f, "%s_MIN_ACCESS_TIME=%" PRIu64 "\n", level, kDefaultAccessTimeInCycles[i]);
+            fprintf(params_f, "%s_MAX_ACCESS_TIME=%" PRIu64 "\n", level, kDefaultAccessTimeInCycles[i]);
+            fprintf(params_f, "%s_MIN_QUEUE_DEPTH=%" PRIu64 "\n", level, kDefaultMaxOutstandingRequests[i]);
+            fprintf(params_f, "%s_MAX_QUEUE_DEPTH=%" PRIu64 "\n", level, kDefaultMaxOutstandingRequests[i]);
+        }
+        fprintf(params_f, "MEMORY_BUDGET_MB=%d\n", MEMORY_BUDGET_MB);
         assert_release(fseek(params_f, 0, SEEK_SET) == 0);
     }
     // File exists, read it in
     assert_release(
-        fscanf(params_f, "NUM_CACHE_LEVELS=%u\n", reinterpret_cast<uint32_t*>(&gTestParams.numberOfCacheLevels)));
+        fscanf(params_f, "NUM_CACHE_LEVELS=%u\n", reinterpret_cast<uint32_t*>(&params.numberOfCacheLevels)));
     for (uint64_t i = 0; i < kMaxNumberOfCacheLevels; i++) {
         int cacheLevel;
         int expectedCacheLevel = static_cast<int>(i) + 1;
-        assert_release(fscanf(params_f, "L%d_MIN_BLOCK_SIZE=%" PRIu64 "\n", &cacheLevel, &gTestParams.minBlockSize[i]));
-        assert_release(fscanf(params_f, "L%d_MAX_BLOCK_SIZE=%" PRIu64 "\n", &cacheLevel, &gTestParams.maxBlockSize[i]));
-        assert_release(fscanf(params_f, "L%d_MIN_CACHE_SIZE=%" PRIu64 "\n", &cacheLevel, &gTestParams.minCacheSize[i]));
-        assert_release(fscanf(params_f, "L%d_MAX_CACHE_SIZE=%" PRIu64 "\n", &cacheLevel, &gTestParams.maxCacheSize[i]));
-        uint32_t associativity;
-        assert_release(fscanf(params_f, "L%d_MIN_ASSOCIATIVITY=%u\n", &cacheLevel, &associativity));
-        gTestParams.minBlocksPerSet[i] = static_cast<uint8_t>(associativity);
-        assert_release(fscanf(params_f, "L%d_MAX_ASSOCIATIVITY=%u\n", &cacheLevel, &associativity));
-        gTestParams.maxBlocksPerSet[i] = static_cast<uint8_t>(associativity);
+        assert_release(fscanf(params_f, "L%d_MIN_BLOCK_SIZE=%" PRIu64 "\n", &cacheLevel, &params.minBlockSize[i]));
+        assert_release(fscanf(params_f, "L%d_MAX_BLOCK_SIZE=%" PRIu64 "\n", &cacheLevel, &params.maxBlockSize[i]));
+        assert_release(fscanf(params_f, "L%d_MIN_CACHE_SIZE=%" PRIu64 "\n", &cacheLevel, &params.minCacheSize[i]));
+        assert_release(fscanf(params_f, "L%d_MAX_CACHE_SIZE=%" PRIu64 "\n", &cacheLevel, &params.maxCacheSize[i]));
+        assert_release(
+            fscanf(params_f, "L%d_MIN_ASSOCIATIVITY=%" PRIu64 "\n", &cacheLevel, &params.minBlocksPerSet[i]));
+        assert_release(
+            fscanf(params_f, "L%d_MAX_ASSOCIATIVITY=%" PRIu64 "\n", &cacheLevel, &params.maxBlocksPerSet[i]));
         assert_release(cacheLevel == expectedCacheLevel);
     }
-    assert_release(fscanf(params_f, "MAX_NUM_THREADS=%" PRId64 "\n", &gTestParams.maxNumberOfThreads));
+    assert_release(fscanf(params_f, "MAX_NUM_THREADS=%" PRId64 "\n", &params.maxNumberOfThreads));
+    // Parameters below were added later, fall back to the defaults when reading an older file
+    char replacementPolicy[8] = REPLACEMENT_POLICY;
+    if (fscanf(params_f, "REPLACEMENT_POLICY=%7s\n", replacementPolicy) != 1) {
+        strcpy(replacementPolicy, REPLACEMENT_POLICY);
+    }
+    params.replacementPolicy = kNumberOfReplacementPolicies;
+    params.compareToOptimal = strcmp(replacementPolicy, kCompareToOptimalName) == 0;
+    if (params.compareToOptimal) {
+        params.replacementPolicy = kLRU;
+    }
+    for (int i = 0; i < kNumberOfReplacementPolicies; i++) {
+        if (strcmp(replacementPolicy, kReplacementPolicyNames[i]) == 0) {
+            params.replacementPolicy = static_cast<ReplacementPolicy>(i);
+        }
+    }
+    for (int i = 0; i <= kMaxNumberOfCacheLevels; i++) {
+        params.minAccessTimeInCycles[i] = kDefaultAccessTimeInCycles[i];
+        params.maxAccessTimeInCycles[i] = kDefaultAccessTimeInCycles[i];
+        params.minOutstandingRequests[i] = kDefaultMaxOutstandingRequests[i];
+        params.maxOutstandingRequests[i] = kDefaultMaxOutstandingRequests[i];
+    }
+    params.memoryBudgetInMegabytes = MEMORY_BUDGET_MB;
+    // Timing & memory parameters, every one optional and in any order
+    char key[32];
+    uint64_t value;
+    while (fscanf(params_f, "%31[^=]=%" PRIu64 "\n", key, &value) == 2) {
+        bool isKnownKey = false;
+        if (strcmp(key, "MEMORY_BUDGET_MB") == 0) {
+            params.memoryBudgetInMegabytes = value;
+            isKnownKey = true;
+        }
+        for (int i = 0; i <= kMaxNumberOfCacheLevels; i++) {
+            char level[16];
+            getLevelParameterPrefix(i, level);
+            uint64_t* pParameters[] = {&params.minAccessTimeInCycles[i], &params.maxAccessTimeInCycles[i],
+                                       &params.minOutstandingRequests[i], &params.maxOutstandingRequests[i]};
+            const char* pSuffixes[] = {"_MIN_ACCESS_TIME", "_MAX_ACCESS_TIME", "_MIN_QUEUE_DEPTH", "_MAX_QUEUE_DEPTH"};
+            for (int j = 0; j < 4; j++) {
+                char levelKey[48];
+                snprintf(levelKey, sizeof(levelKey), "%s%s", level, pSuffixes[j]);
+                if (strcmp(levelKey, key) == 0) {
+                    *pParameters[j] = value;
+                    isKnownKey = true;
+                }
+            }
+        }
+        if (!isKnownKey) {
+            fprintf(stderr, "Unknown parameter %s in %s\n", key, kParametersFilename);
+            exit(1);
+        }
+    }
     fclose(params_f);
-    verify_test_params();
+    verify_test_params(params);
 }
 
 uint8_t* IOUtilities::ReadInFile(const char* filename, uint64_t& length) {
+    uint8_t* buffer = TryReadInFile(filename, length);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error in reading file %s\n", filename);
+        exit(1);
+    }
+    return buffer;
+}
+
+uint8_t* IOUtilities::TryReadInFile(const char* filename, uint64_t& length) {
 
     uint8_t* buffer = NULL;
     long m;
 
     FILE* f = fopen(filename, "r");
-    if (f == NULL) {
-        fprintf(stderr, "Unable to open file %s\n", filename);
-        goto error;
-    }
+    if (f == NULL)
+        return NULL;
 
-    if (fseek(f, 0, SEEK_END)) {
-        fprintf(stderr, "Error in file seek of %s\n", filename);
+    if (fseek(f, 0, SEEK_END))
         goto error;
-    }
     m = ftell(f);
     if (m < 0)
         goto error;
-    buffer = new uint8_t[m];
+    // Terminated, so that strtoull stops within the buffer on a last line missing its newline
+    buffer = new (std::nothrow) uint8_t[m + 1];
     if (buffer == NULL)
         goto error;
     if (fseek(f, 0, SEEK_SET))
         goto error;
     if (fread(buffer, 1, m, f) != static_cast<size_t>(m))
         goto error;
+    buffer[m] = '\0';
     fclose(f);
 
     length = m;
     return buffer;
 
 error:
-    if (f)
-        fclose(f);
+    fclose(f);
     delete[] buffer;
-    fprintf(stderr, "Error in reading file %s\n", filename);
-    exit(1);
+    return NULL;
 }
 
-void IOUtilities::parseLine(uint8_t* line, std::vector<Instruction>& dataAccesses,
-                            std::vector<Instruction>& instructionAccesses) {
+bool IOUtilities::parseLine(const uint8_t* line, Instruction& instructionAccess, Instruction* pDataAccesses,
+                            uint64_t& numDataAccesses) {
+    // Addresses not of the length assumed here would shift every field after them
+    if (line[0] != '0' || line[1] != 'x') {
+        return false;
+    }
     line += kPaddingLengthInBytes;
     char* end_ptr;
-    instructionAccesses.push_back(Instruction(strtoull(reinterpret_cast<char*>(line), &end_ptr, 16), READ));
-    /*
-    pInstructionAccess->rw = READ;
-    pInstructionAccess->ptr = strtoull(reinterpret_cast<char*> (line), &end_ptr, 16);
-    */
+    instructionAccess = Instruction(strtoull(reinterpret_cast<const char*>(line), &end_ptr, 16), READ);
+    if (end_ptr != reinterpret_cast<const char*>(line + kAddressLengthInBytes) || *end_ptr != ':') {
+        return false;
+    }
     line += kPaddingLengthInBytes + kAddressLengthInBytes;
     char rw_c = *line;
     line += kRwLengthInBytes + kPaddingAfterRwLengthInBytes;
@@ -259,21 +534,56 @@ void IOUtilities::parseLine(uint8_t* line, std::vector<Instruction>& dataAccesse
     else if (rw_c == 'W')
         dataAccess.rw = WRITE;
     else
-        return;
-    dataAccess.ptr = strtoll(reinterpret_cast<char*>(line), &end_ptr, 16);
-    instructionAccesses.back().dataAccessIndex = dataAccesses.size();
-    dataAccesses.push_back(dataAccess);
-    // If this assert fails, it is likely that the addresses in the trace are not uniform
-    // and do not match the length assumptions made here
-    assert(*end_ptr == '\n');
+        return true;
+    dataAccess.ptr = strtoll(reinterpret_cast<const char*>(line), &end_ptr, 16);
+    instructionAccess.dataAccessIndex = numDataAccesses;
+    pDataAccesses[numDataAccesses++] = dataAccess;
+    return end_ptr == reinterpret_cast<const char*>(line + kAddressLengthInBytes) && *end_ptr == '\n';
 }
 
 void IOUtilities::ParseBuffer(uint8_t* buffer, uint64_t length, MemoryAccesses& accesses) {
+    if (!TryParseBuffer(buffer, length, accesses)) {
+        fprintf(stderr, "Malformed line in the trace, its addresses are not of %" PRIu64 " hex digits\n",
+                kAddressLengthInBytes);
+        exit(1);
+    }
+}
+
+bool IOUtilities::TryParseBuffer(uint8_t* buffer, uint64_t length, MemoryAccesses& accesses) {
+    assert(buffer);
+    assert(accesses.dataAccesses_.empty() && accesses.instructionAccesses_.empty());
+    // Sized exactly up front, regrowing would map each array several times over
+    uint64_t numDataAccesses = 0;
+    uint64_t numInstructionAccesses = 0;
+    CountAccesses(buffer, length, numDataAccesses, numInstructionAccesses);
+    accesses.dataAccesses_.resize(numDataAccesses);
+    accesses.instructionAccesses_.resize(numInstructionAccesses);
+    const bool isWellFormed =
+        TryParseBufferInto(buffer, length, accesses.dataAccesses_.data(), accesses.instructionAccesses_.data());
+    delete[] buffer;
+    return isWellFormed;
+}
+
+void IOUtilities::CountAccesses(const uint8_t* buffer, uint64_t length, uint64_t& numDataAccesses,
+                                uint64_t& numInstructionAccesses) {
+    constexpr uint64_t kRwOffsetInBytes = kPaddingLengthInBytes + kAddressLengthInBytes + kPaddingLengthInBytes;
+    numInstructionAccesses = length / kFileLineLengthInBytes;
+    numDataAccesses = 0;
+    for (uint64_t i = 0; i < numInstructionAccesses; i++) {
+        const uint8_t rw = buffer[i * kFileLineLengthInBytes + kRwOffsetInBytes];
+        numDataAccesses += rw == 'R' || rw == 'W';
+    }
+}
+
+bool IOUtilities::TryParseBufferInto(const uint8_t* buffer, uint64_t length, Instruction* pDataAccesses,
+                                     Instruction* pInstructionAccesses) {
     assert(buffer);
-    const uint8_t* buffer_start = buffer;
     uint64_t numberOfLines = length / kFileLineLengthInBytes;
+    uint64_t numDataAccesses = 0;
     for (uint64_t i = 0; i < numberOfLines; i++, buffer += kFileLineLengthInBytes) {
-        IOUtilities::parseLine(buffer, accesses.dataAccesses_, accesses.instructionAccesses_);
+        if (!IOUtilities::parseLine(buffer, pInstructionAccesses[i], pDataAccesses, numDataAccesses)) {
+            return false;
+        }
     }
-    delete[] buffer_start;
+    return true;
 }
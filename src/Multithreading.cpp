@@ -2,6 +2,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -29,6 +30,31 @@ void Multithreading::InitializeLock(Lock_t* pLock) {
     }
 }
 
+void Multithreading::InitializeCondition(Condition_t* pCondition) {
+    if (pthread_cond_init(pCondition, NULL) != 0) {
+        fprintf(stderr, "Condition variable init failed\n");
+        exit(1);
+    }
+}
+
+void Multithreading::WaitForCondition(Condition_t* pCondition, Lock_t* pLock) {
+    pthread_cond_wait(pCondition, pLock);
+}
+
+void Multithreading::WaitForConditionFor(Condition_t* pCondition, Lock_t* pLock, uint64_t timeoutInMilliseconds) {
+    // Condition variables initialized with the default attributes time out on the realtime clock
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    const uint64_t nanoseconds = deadline.tv_nsec + timeoutInMilliseconds % 1000 * 1000000;
+    deadline.tv_sec += timeoutInMilliseconds / 1000 + nanoseconds / 1000000000;
+    deadline.tv_nsec = nanoseconds % 1000000000;
+    pthread_cond_timedwait(pCondition, pLock, &deadline);
+}
+
+void Multithreading::WakeAll(Condition_t* pCondition) {
+    pthread_cond_broadcast(pCondition);
+}
+
 void Multithreading::StartThread(THREAD_FUNCTION_TYPE(threadFunction), void* pThreadData, Thread_t* pThreadOut) {
     if (pthread_create(pThreadOut, NULL, threadFunction, pThreadData)) {
         fprintf(stderr, "Error in creating thread\n");
@@ -55,6 +81,22 @@ void Multithreading::InitializeLock(Lock_t* pLock) {
     InitializeCriticalSection(pLock);
 }
 
+void Multithreading::InitializeCondition(Condition_t* pCondition) {
+    InitializeConditionVariable(pCondition);
+}
+
+void Multithreading::WaitForCondition(Condition_t* pCondition, Lock_t* pLock) {
+    SleepConditionVariableCS(pCondition, pLock, INFINITE);
+}
+
+void Multithreading::WaitForConditionFor(Condition_t* pCondition, Lock_t* pLock, uint64_t timeoutInMilliseconds) {
+    SleepConditionVariableCS(pCondition, pLock, static_cast<DWORD>(timeoutInMilliseconds));
+}
+
+void Multithreading::WakeAll(Condition_t* pCondition) {
+    WakeAllConditionVariable(pCondition);
+}
+
 void Multithreading::StartThread(THREAD_FUNCTION_TYPE(threadFunction), void* pThreadData, Thread_t* pThreadOut) {
     DWORD threadIdentifier; // not used
     *pThreadOut = CreateThread(NULL, 0, threadFunction, pThreadData, 0, &threadIdentifier);
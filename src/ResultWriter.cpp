@@ -0,0 +1,213 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "ResultWriter.h"
+#include "debug.h"
+
+static constexpr char kColumnsMagic[8] = {'C', 'S', 'I', 'M', 'C', 'O', 'L', '1'};
+
+static constexpr uint64_t kNoAlias = UINT64_MAX;
+
+// Columns of every level of the columnar output, in order
+static const char* kLevelColumnNames[] = {"cache_size",  "block_size", "associativity", "replacement_policy",
+                                          "access_time", "max_outstanding_requests",    "read_hits",
+                                          "read_misses", "write_hits", "write_misses",  "writebacks",
+                                          "latency_p50", "latency_p90", "latency_p99",  "latency_max"};
+
+ResultWriter::ResultWriter(const std::vector<ConfigDescriptor>& descriptors, std::vector<ConfigSummary>& summaries,
+                           const std::vector<uint64_t>& aliasOf, bool compareToOptimal, FILE* pTextStream,
+                           FILE* pCSVStream, FILE* pJSONStream, FILE* pColumnsStream)
+    : descriptors_(descriptors), summaries_(summaries), compareToOptimal_(compareToOptimal), pTextStream_(pTextStream),
+      pCSVStream_(pCSVStream), pJSONStream_(pJSONStream), pColumnsStream_(pColumnsStream), nextToPrint_(0),
+      completedConfigs_(kQueueCapacity), isFinishing_(false), isWriterAsleep_(false) {
+    isTextDeferred_ = pTextStream_ == stdout;
+    firstAlias_ = std::vector<uint64_t>(descriptors_.size(), kNoAlias);
+    nextAlias_ = std::vector<uint64_t>(descriptors_.size(), kNoAlias);
+    for (uint64_t i = 0; i < descriptors_.size(); i++) {
+        if (aliasOf[i] != i) {
+            nextAlias_[i] = firstAlias_[aliasOf[i]];
+            firstAlias_[aliasOf[i]] = i;
+        }
+    }
+    isWritten_ = std::vector<bool>(descriptors_.size(), false);
+    Multithreading::InitializeLock(&lock_);
+    Multithreading::InitializeCondition(&workAvailable_);
+}
+
+void ResultWriter::Start() {
+    if (!descriptors_.empty()) {
+        IOUtilities::PrintCSVHeader(descriptors_[0].numberOfCacheLevels, pCSVStream_);
+    }
+    if (pColumnsStream_ && !descriptors_.empty()) {
+        std::vector<std::string> columnNames(1, "config");
+        for (int cacheLevel = 1; cacheLevel <= descriptors_[0].numberOfCacheLevels; cacheLevel++) {
+            for (const char* pColumnName : kLevelColumnNames) {
+                char columnName[64];
+                snprintf(columnName, sizeof(columnName), "l%d_%s", cacheLevel, pColumnName);
+                columnNames.push_back(columnName);
+            }
+        }
+        for (const char* pColumnName :
+             {"memory_access_time", "memory_max_outstanding_requests", "instructions", "cycles"}) {
+            columnNames.push_back(pColumnName);
+        }
+        const uint64_t numColumns = columnNames.size();
+        fwrite(kColumnsMagic, sizeof(kColumnsMagic), 1, pColumnsStream_);
+        fwrite(&numColumns, sizeof(numColumns), 1, pColumnsStream_);
+        for (const std::string& columnName : columnNames) {
+            fwrite(columnName.c_str(), columnName.size() + 1, 1, pColumnsStream_);
+        }
+        columns_ = std::vector<std::vector<uint64_t>>(numColumns);
+        for (std::vector<uint64_t>& column : columns_) {
+            column.reserve(kRowsPerBlock);
+        }
+    }
+    lastColumnsFlush_ = std::chrono::steady_clock::now();
+    Multithreading::StartThread(ResultWriter::Run, static_cast<void*>(this), &thread_);
+}
+
+void ResultWriter::Finish() {
+    isFinishing_.store(true, std::memory_order_release);
+    Multithreading::Lock(&lock_);
+    Multithreading::WakeAll(&workAvailable_);
+    Multithreading::Unlock(&lock_);
+    Multithreading::WaitForThreads(std::vector<Thread_t>(1, thread_));
+    flushColumns();
+    printInOrder();
+    if (pTextStream_ && !descriptors_.empty()) {
+        assert_release(nextToPrint_ == descriptors_.size());
+        IOUtilities::PrintLowestCpi(descriptors_, lowestCpi_, pTextStream_);
+    }
+    flushStreams();
+}
+
+#ifdef _MSC_VER
+DWORD WINAPI ResultWriter::Run(void* pResultWriter) {
+#else
+void* ResultWriter::Run(void* pResultWriter) {
+#endif
+    ResultWriter* pWriter = static_cast<ResultWriter*>(pResultWriter);
+    while (true) {
+        // Read before draining, so that the configs pushed before Finish are all drained
+        const bool isFinishing = pWriter->isFinishing_.load(std::memory_order_acquire);
+        uint64_t configIndex;
+        bool isAnyWritten = false;
+        while (pWriter->completedConfigs_.TryPop(configIndex)) {
+            pWriter->writeCompleted(configIndex);
+            isAnyWritten = true;
+        }
+        if (isFinishing) {
+            break;
+        }
+        const bool isColumnsFlushDue =
+            std::chrono::steady_clock::now() - pWriter->lastColumnsFlush_ >= kColumnsFlushPeriod;
+        if (isColumnsFlushDue) {
+            pWriter->flushColumns();
+        }
+        if (isAnyWritten || isColumnsFlushDue) {
+            pWriter->flushStreams();
+        }
+        // Asleep until a config is pushed or Finish is called, or the rows buffered are due to be flushed
+        Multithreading::Lock(&pWriter->lock_);
+        pWriter->isWriterAsleep_.store(true, std::memory_order_relaxed);
+        // Pairs with the fence of Push between pushing a config & checking isWriterAsleep_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (pWriter->completedConfigs_.IsEmpty() && !pWriter->isFinishing_.load(std::memory_order_acquire)) {
+            if (pWriter->columns_.empty() || pWriter->columns_[0].empty()) {
+                Multithreading::WaitForCondition(&pWriter->workAvailable_, &pWriter->lock_);
+                continue;
+            }
+            const auto untilFlush =
+                pWriter->lastColumnsFlush_ + kColumnsFlushPeriod - std::chrono::steady_clock::now();
+            if (untilFlush <= std::chrono::steady_clock::duration::zero()) {
+                break;
+            }
+            Multithreading::WaitForConditionFor(
+                &pWriter->workAvailable_, &pWriter->lock_,
+                std::chrono::ceil<std::chrono::milliseconds>(untilFlush).count());
+        }
+        pWriter->isWriterAsleep_.store(false, std::memory_order_relaxed);
+        Multithreading::Unlock(&pWriter->lock_);
+    }
+#ifdef _MSC_VER
+    return 0;
+#else
+    pthread_exit(NULL);
+    return nullptr;
+#endif
+}
+
+void ResultWriter::writeCompleted(uint64_t configIndex) {
+    // The config itself, then the configs aliasing it
+    for (uint64_t i = configIndex; i != kNoAlias; i = i == configIndex ? firstAlias_[i] : nextAlias_[i]) {
+        const ConfigDescriptor& descriptor = descriptors_[i];
+        const ConfigSummary& summary = summaries_[i] = summaries_[configIndex];
+        if (pJSONStream_) {
+            IOUtilities::PrintStatisticsJSON(descriptor, summary, i, pJSONStream_);
+        }
+        if (!columns_.empty()) {
+            auto column = columns_.begin();
+            (column++)->push_back(i);
+            for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+                const Configuration& config = descriptor.configs[cacheLevel];
+                const Statistics& stats = summary.stats[cacheLevel];
+                const LatencySummary& latency = summary.latencies[cacheLevel];
+                for (uint64_t value : {config.cacheSize, config.blockSize, config.associativity,
+                                       static_cast<uint64_t>(config.replacementPolicy),
+                                       config.timing.accessTimeInCycles, config.timing.maxOutstandingRequests,
+                                       stats.readHits, stats.readMisses, stats.writeHits, stats.writeMisses,
+                                       stats.writebacks, latency.p50, latency.p90, latency.p99, latency.max}) {
+                    (column++)->push_back(value);
+                }
+            }
+            for (uint64_t value : {descriptor.mainMemoryTiming.accessTimeInCycles,
+                                   descriptor.mainMemoryTiming.maxOutstandingRequests,
+                                   summary.stats[kL1].numInstructions, summary.cycles}) {
+                (column++)->push_back(value);
+            }
+            assert(column == columns_.end());
+            if (columns_[0].size() == kRowsPerBlock) {
+                flushColumns();
+            }
+        }
+        isWritten_[i] = true;
+    }
+    if (!isTextDeferred_) {
+        printInOrder();
+    }
+}
+
+void ResultWriter::printInOrder() {
+    if (pTextStream_ == nullptr) {
+        return;
+    }
+    while (nextToPrint_ < descriptors_.size() && isWritten_[nextToPrint_]) {
+        IOUtilities::PrintResult(descriptors_, summaries_, compareToOptimal_, nextToPrint_, lowestCpi_, pTextStream_,
+                                 pCSVStream_);
+        nextToPrint_++;
+    }
+}
+
+void ResultWriter::flushColumns() {
+    lastColumnsFlush_ = std::chrono::steady_clock::now();
+    if (columns_.empty() || columns_[0].empty()) {
+        return;
+    }
+    const uint64_t numRows = columns_[0].size();
+    fwrite(&numRows, sizeof(numRows), 1, pColumnsStream_);
+    for (std::vector<uint64_t>& column : columns_) {
+        fwrite(column.data(), sizeof(uint64_t), numRows, pColumnsStream_);
+        column.clear();
+    }
+}
+
+void ResultWriter::flushStreams() {
+    for (FILE* pStream : {pTextStream_, pCSVStream_, pJSONStream_, pColumnsStream_}) {
+        if (pStream) {
+            fflush(pStream);
+        }
+    }
+}
@@ -0,0 +1,292 @@
+#include <atomic>
+#include <inttypes.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "IOUtilities.h"
+#include "SharedTrace.h"
+#include "debug.h"
+
+// Arrays start on their own page, so they can be mapped read-only apart from the header
+constexpr uint64_t kSharedTraceHeaderSizeInBytes = 4096;
+constexpr uint64_t kSharedTraceMagic = 0x6361636865747263; // "cachetrc"
+
+enum SharedTraceState : uint32_t {
+    kBeingParsed,
+    kReady,
+    // Unlinked, or about to be, by the process that set it. Whoever opened it meanwhile creates it again
+    kRemoved,
+};
+
+struct SharedTrace::Header {
+    uint64_t magic;
+    int64_t creatorPid;
+    std::atomic<uint32_t> state;
+    uint64_t numDataAccesses;
+    uint64_t numInstructionAccesses;
+};
+
+static_assert(sizeof(SharedTrace::Header) <= kSharedTraceHeaderSizeInBytes, "Header outgrew its page");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Atomics in shared memory must be lock free");
+static_assert(std::is_trivially_copyable_v<Instruction>, "Instructions are shared as raw bytes");
+
+#ifdef __linux__
+
+// Prefix of the segment names, the rest is the identity of the trace file
+static const char kSharedTraceNamePrefix[] = "cache-trace-";
+
+/**
+ * @brief           Removes the name of a segment, unless it was already removed & now names a segment created since
+ *
+ * @param pName     Name of the segment
+ * @param fd        Descriptor of the segment
+ */
+static void unlinkSegment(const char* pName, int fd) {
+    struct stat segmentStat;
+    struct stat namedStat;
+    const int namedFd = shm_open(pName, O_RDONLY, 0);
+    if (namedFd < 0) {
+        return;
+    }
+    if (fstat(fd, &segmentStat) == 0 && fstat(namedFd, &namedStat) == 0 && segmentStat.st_ino == namedStat.st_ino) {
+        shm_unlink(pName);
+    }
+    close(namedFd);
+}
+
+/**
+ * @brief   Removes the segments no process is attached to anymore, left behind by processes that crashed. A process
+ * holds a shared lock on its segment while attached, which the kernel releases when it dies
+ */
+static void removeOrphanedSegments() {
+    DIR* pDirectory = opendir("/dev/shm");
+    if (pDirectory == nullptr) {
+        return;
+    }
+    while (const dirent* pEntry = readdir(pDirectory)) {
+        if (strncmp(pEntry->d_name, kSharedTraceNamePrefix, sizeof(kSharedTraceNamePrefix) - 1) != 0) {
+            continue;
+        }
+        char name[NAME_MAX + 2];
+        snprintf(name, sizeof(name), "/%s", pEntry->d_name);
+        const int fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // A segment still unsized may have been created an instant ago, before its creator could lock it
+        struct stat segmentStat;
+        if (fstat(fd, &segmentStat) == 0 &&
+            static_cast<uint64_t>(segmentStat.st_size) >= kSharedTraceHeaderSizeInBytes &&
+            flock(fd, LOCK_EX | LOCK_NB) == 0) {
+            void* pHeader = mmap(nullptr, kSharedTraceHeaderSizeInBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (pHeader != MAP_FAILED) {
+                static_cast<SharedTrace::Header*>(pHeader)->state.store(kRemoved, std::memory_order_release);
+                munmap(pHeader, kSharedTraceHeaderSizeInBytes);
+            }
+            unlinkSegment(name, fd);
+        }
+        close(fd);
+    }
+    closedir(pDirectory);
+}
+
+SharedTrace::~SharedTrace() {
+    if (pHeader_ == nullptr) {
+        return;
+    }
+    // The last process attached is the only one that can lock the segment exclusively
+    if (flock(fd_, LOCK_EX | LOCK_NB) == 0) {
+        pHeader_->state.store(kRemoved, std::memory_order_release);
+        unlinkSegment(name_, fd_);
+    }
+    detach();
+}
+
+bool SharedTrace::Attach(const char* pTraceFilename) {
+    struct stat traceStat;
+    if (stat(pTraceFilename, &traceStat) != 0) {
+        return false;
+    }
+    removeOrphanedSegments();
+    // A trace that is rewritten gets a new segment
+    snprintf(name_, sizeof(name_), "/%s%" PRIx64 "-%" PRIx64 "-%" PRIx64 "-%" PRIx64, kSharedTraceNamePrefix,
+             static_cast<uint64_t>(traceStat.st_dev), static_cast<uint64_t>(traceStat.st_ino),
+             static_cast<uint64_t>(traceStat.st_size), static_cast<uint64_t>(traceStat.st_mtime));
+    while (true) {
+        fd_ = shm_open(name_, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd_ >= 0) {
+            return create(pTraceFilename);
+        }
+        if (errno != EEXIST) {
+            return false;
+        }
+        fd_ = shm_open(name_, O_RDWR, 0);
+        if (fd_ < 0) {
+            // Removed by its last user in between, create it again
+            continue;
+        }
+        if (open()) {
+            return true;
+        }
+    }
+}
+
+bool SharedTrace::create(const char* pTraceFilename) {
+    // Locked before it is sized, so that a segment of any size is known to have had a process attached
+    assert_release(flock(fd_, LOCK_SH) == 0);
+    assert_release(ftruncate(fd_, kSharedTraceHeaderSizeInBytes) == 0);
+    void* pHeader = mmap(nullptr, kSharedTraceHeaderSizeInBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    assert_release(pHeader != MAP_FAILED);
+    pHeader_ = new (pHeader) Header();
+    pHeader_->magic = kSharedTraceMagic;
+    pHeader_->creatorPid = getpid();
+
+    // Parsed straight into the segment, the trace arrays are never in memory twice
+    uint64_t fileLength = 0;
+    uint8_t* pFileContents = IOUtilities::TryReadInFile(pTraceFilename, fileLength);
+    bool isParsed = pFileContents != nullptr;
+    if (isParsed) {
+        uint64_t numDataAccesses = 0;
+        uint64_t numInstructionAccesses = 0;
+        IOUtilities::CountAccesses(pFileContents, fileLength, numDataAccesses, numInstructionAccesses);
+        pHeader_->numDataAccesses = numDataAccesses;
+        pHeader_->numInstructionAccesses = numInstructionAccesses;
+        arraysSizeInBytes_ = (numDataAccesses + numInstructionAccesses) * sizeof(Instruction);
+        assert_release(ftruncate(fd_, kSharedTraceHeaderSizeInBytes + arraysSizeInBytes_) == 0);
+        if (arraysSizeInBytes_) {
+            void* pArrays = mmap(nullptr, arraysSizeInBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                                 kSharedTraceHeaderSizeInBytes);
+            assert_release(pArrays != MAP_FAILED);
+            Instruction* pInstructions = static_cast<Instruction*>(pArrays);
+            isParsed = IOUtilities::TryParseBufferInto(pFileContents, fileLength, pInstructions,
+                                                       pInstructions + numDataAccesses);
+            mprotect(pArrays, arraysSizeInBytes_, PROT_READ);
+            pArrays_ = pInstructions;
+        }
+        delete[] pFileContents;
+    }
+    if (!isParsed) {
+        // Left for the caller to parse itself & report why it cannot, the processes waiting do the same
+        pHeader_->state.store(kRemoved, std::memory_order_release);
+        unlinkSegment(name_, fd_);
+        detach();
+        return false;
+    }
+    pHeader_->state.store(kReady, std::memory_order_release);
+    return true;
+}
+
+bool SharedTrace::open() {
+    constexpr auto kPollPeriod = std::chrono::milliseconds(1);
+    constexpr auto kUnsizedTimeout = std::chrono::seconds(1);
+    // The creator locks & sizes the header right after creating the segment. Waited for unlocked, so that the
+    // processes waiting on a segment whose creator died first do not keep each other from removing it
+    const auto unsizedDeadline = std::chrono::steady_clock::now() + kUnsizedTimeout;
+    struct stat segmentStat;
+    while (fstat(fd_, &segmentStat) == 0 &&
+           static_cast<uint64_t>(segmentStat.st_size) < kSharedTraceHeaderSizeInBytes) {
+        if (std::chrono::steady_clock::now() >= unsizedDeadline && flock(fd_, LOCK_EX | LOCK_NB) == 0) {
+            // Still unsized & locked by no one, its creator died before sizing it. Created again by the caller
+            unlinkSegment(name_, fd_);
+            close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        std::this_thread::sleep_for(kPollPeriod);
+    }
+    // Held while attached. Taken before the state is read, so that a last user detaching meanwhile has either
+    // marked the segment removed already or sees this process attached & leaves it
+    assert_release(flock(fd_, LOCK_SH) == 0);
+    void* pHeader = mmap(nullptr, kSharedTraceHeaderSizeInBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    assert_release(pHeader != MAP_FAILED);
+    pHeader_ = static_cast<Header*>(pHeader);
+    uint32_t state;
+    while ((state = pHeader_->state.load(std::memory_order_acquire)) == kBeingParsed) {
+        const int64_t creatorPid = pHeader_->creatorPid;
+        if (creatorPid && kill(static_cast<pid_t>(creatorPid), 0) != 0 && errno == ESRCH) {
+            // Its creator died while parsing, it will never be ready
+            pHeader_->state.store(kRemoved, std::memory_order_release);
+            unlinkSegment(name_, fd_);
+            state = kRemoved;
+            break;
+        }
+        std::this_thread::sleep_for(kPollPeriod);
+    }
+    if (state == kRemoved) {
+        detach();
+        return false;
+    }
+    assert_release(pHeader_->magic == kSharedTraceMagic && "Not a trace segment");
+    arraysSizeInBytes_ = (pHeader_->numDataAccesses + pHeader_->numInstructionAccesses) * sizeof(Instruction);
+    mapArrays();
+    return true;
+}
+
+void SharedTrace::mapArrays() {
+    if (arraysSizeInBytes_ == 0) {
+        return;
+    }
+    void* pArrays = mmap(nullptr, arraysSizeInBytes_, PROT_READ, MAP_SHARED, fd_, kSharedTraceHeaderSizeInBytes);
+    assert_release(pArrays != MAP_FAILED);
+    pArrays_ = static_cast<const Instruction*>(pArrays);
+}
+
+void SharedTrace::detach() {
+    if (pArrays_) {
+        munmap(const_cast<Instruction*>(pArrays_), arraysSizeInBytes_);
+        pArrays_ = nullptr;
+    }
+    munmap(pHeader_, kSharedTraceHeaderSizeInBytes);
+    pHeader_ = nullptr;
+    close(fd_);
+    fd_ = -1;
+}
+
+#else
+
+SharedTrace::~SharedTrace() {
+}
+
+bool SharedTrace::Attach(const char*) {
+    return false;
+}
+
+bool SharedTrace::create(const char*) {
+    return false;
+}
+
+bool SharedTrace::open() {
+    return false;
+}
+
+void SharedTrace::mapArrays() {
+}
+
+void SharedTrace::detach() {
+}
+
+#endif
+
+MemoryAccessesView SharedTrace::GetView() const {
+    assert_release(pHeader_ && "Not attached to a trace");
+    return MemoryAccessesView{InstructionSpan_t(pArrays_, pHeader_->numDataAccesses),
+                              InstructionSpan_t(pArrays_ + pHeader_->numDataAccesses, pHeader_->numInstructionAccesses)};
+}
@@ -14,9 +14,9 @@
 
 #include "sim_trace_decoder.h"
 
-extern TestParamaters gTestParams;
-
-SimTracer::SimTracer(const char* filename, uint64_t numberOfConfigs) {
+SimTracer::SimTracer(const char* filename, uint64_t numberOfConfigs, uint8_t numberOfCacheLevels,
+                     int64_t maxNumberOfThreads)
+    : numberOfCacheLevels_(numberOfCacheLevels), maxNumberOfThreads_(maxNumberOfThreads) {
     if (numberOfConfigs > SIM_TRACE_WARNING_THRESHOLD) {
         printf("The number of configs is very high for simulation tracing.\n");
         printf("There is no issue with that, but it will take ~2 times as long\n");
@@ -46,15 +46,15 @@ SimTracer::SimTracer(const char* filename, uint64_t numberOfConfigs) {
     // uint16_t number of configs
     CODE_FOR_ASSERT(ret =) fwrite(&numberOfConfigs, sizeof(uint16_t), 1, pFile_);
     assert(ret == 1);
-    CODE_FOR_ASSERT(ret =) fwrite(&gTestParams.numberOfCacheLevels, sizeof(uint8_t), 1, pFile_);
+    CODE_FOR_ASSERT(ret =) fwrite(&numberOfCacheLevels_, sizeof(uint8_t), 1, pFile_);
     assert(ret == 1);
 
     assert(kSimTraceBufferSizeInBytes <= UINT32_MAX);
-    pBufferAppendPoints_ = new uint8_t*[gTestParams.maxNumberOfThreads];
-    pSimTraceBuffer_ = new uint8_t*[gTestParams.maxNumberOfThreads];
-    pEntryCounters_ = new uint64_t[gTestParams.maxNumberOfThreads]();
-    pPreviousCycleCounter_ = new uint64_t[gTestParams.maxNumberOfThreads]();
-    for (uint64_t i = 0; i < static_cast<uint64_t>(gTestParams.maxNumberOfThreads); i++) {
+    pBufferAppendPoints_ = new uint8_t*[maxNumberOfThreads];
+    pSimTraceBuffer_ = new uint8_t*[maxNumberOfThreads];
+    pEntryCounters_ = new uint64_t[maxNumberOfThreads]();
+    pPreviousCycleCounter_ = new uint64_t[maxNumberOfThreads]();
+    for (uint64_t i = 0; i < static_cast<uint64_t>(maxNumberOfThreads_); i++) {
         pSimTraceBuffer_[i] = new uint8_t[kSimTraceBufferSizeInBytes]();
         pBufferAppendPoints_[i] = pSimTraceBuffer_[i];
         assert(pSimTraceBuffer_[i]);
@@ -63,7 +63,7 @@ SimTracer::SimTracer(const char* filename, uint64_t numberOfConfigs) {
 }
 
 SimTracer::~SimTracer() {
-    for (uint16_t i = 0; i < gTestParams.maxNumberOfThreads; i++) {
+    for (uint16_t i = 0; i < maxNumberOfThreads_; i++) {
         delete[] pSimTraceBuffer_[i];
     }
     delete[] pBufferAppendPoints_;
@@ -75,7 +75,7 @@ SimTracer::~SimTracer() {
 
 void SimTracer::Print(TraceEntryId traceEntryId, Memory* pMemory, ...) {
     uint64_t threadId = pMemory->threadId_;
-    assert(threadId < static_cast<uint64_t>(gTestParams.maxNumberOfThreads));
+    assert(threadId < static_cast<uint64_t>(maxNumberOfThreads_));
     uint64_t cycle = pMemory->GetCycle();
     CacheLevel cacheLevel = pMemory->GetCacheLevel();
     // Roll over when buffer is filled
@@ -131,7 +131,7 @@ void SimTracer::WriteThreadBuffer(Cache* pCache) {
     CODE_FOR_ASSERT(ret =) fwrite(&bufferAppendPointOffset, sizeof(uint32_t), 1, pFile_);
     assert(ret == 1);
     // configs of each cache
-    Configuration* pConfigs = new Configuration[gTestParams.numberOfCacheLevels];
+    Configuration* pConfigs = new Configuration[numberOfCacheLevels_];
     uint8_t i = 0;
     for (Cache* pCacheIterator = pCache; pCacheIterator->GetCacheLevel() != kMainMemory;
          pCacheIterator = static_cast<Cache*>(&pCacheIterator->GetLowerCache()), i++) {
@@ -139,8 +139,8 @@ void SimTracer::WriteThreadBuffer(Cache* pCache) {
         pConfigs[i].blockSize = pCacheIterator->GetConfig().blockSize;
         pConfigs[i].associativity = pCacheIterator->GetConfig().associativity;
     }
-    CODE_FOR_ASSERT(ret =) fwrite(pConfigs, sizeof(Configuration), gTestParams.numberOfCacheLevels, pFile_);
-    assert(ret == gTestParams.numberOfCacheLevels);
+    CODE_FOR_ASSERT(ret =) fwrite(pConfigs, sizeof(Configuration), numberOfCacheLevels_, pFile_);
+    assert(ret == numberOfCacheLevels_);
     delete[] pConfigs;
     CODE_FOR_ASSERT(ret =) fwrite(pSimTraceBuffer_[threadId], sizeof(uint8_t), kSimTraceBufferSizeInBytes, pFile_);
     assert(ret == kSimTraceBufferSizeInBytes);
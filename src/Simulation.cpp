@@ -0,0 +1,275 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "IOUtilities.h"
+#include "Simulation.h"
+#include "Simulator.h"
+#include "debug.h"
+
+std::shared_ptr<Trace> Trace::Load(const char* pFilename) {
+    // Not IOUtilities::ReadInFile & ParseBuffer, they exit on failure and a library must not
+    uint64_t fileLength = 0;
+    uint8_t* pFileContents = IOUtilities::TryReadInFile(pFilename, fileLength);
+    if (pFileContents == nullptr) {
+        return nullptr;
+    }
+    MemoryAccesses accesses;
+    if (!IOUtilities::TryParseBuffer(pFileContents, fileLength, accesses)) {
+        return nullptr;
+    }
+    return std::make_shared<Trace>(pFilename, std::move(accesses));
+}
+
+Trace::Trace(const char* pFilename, MemoryAccesses&& accesses) : filename_(pFilename), accesses_(std::move(accesses)) {
+    Multithreading::InitializeLock(&lock_);
+    pNextUseIndices_ = std::make_shared<const std::vector<NextUseIndex>>();
+}
+
+std::shared_ptr<const std::vector<NextUseIndex>>
+Trace::GetNextUseIndices(const std::vector<ConfigDescriptor>& descriptors) {
+    Multithreading::Lock(&lock_);
+    // Copied on the first block size missing, the snapshot handed out before is never modified
+    std::shared_ptr<std::vector<NextUseIndex>> pNextUseIndices;
+    for (const ConfigDescriptor& descriptor : descriptors) {
+        for (uint8_t i = 0; i < descriptor.numberOfCacheLevels; i++) {
+            if (descriptor.configs[i].replacementPolicy != kOPT) {
+                continue;
+            }
+            const std::vector<NextUseIndex>& nextUseIndices = pNextUseIndices ? *pNextUseIndices : *pNextUseIndices_;
+            const uint64_t blockSize = descriptor.configs[i].blockSize;
+            if (std::none_of(nextUseIndices.begin(), nextUseIndices.end(),
+                             [blockSize](const NextUseIndex& n) { return n.GetBlockSize() == blockSize; })) {
+                if (!pNextUseIndices) {
+                    pNextUseIndices = std::make_shared<std::vector<NextUseIndex>>(*pNextUseIndices_);
+                }
+                pNextUseIndices->emplace_back(accesses_.View().dataAccesses_, blockSize, nullptr);
+            }
+        }
+    }
+    if (pNextUseIndices) {
+        pNextUseIndices_ = pNextUseIndices;
+    }
+    std::shared_ptr<const std::vector<NextUseIndex>> pSnapshot = pNextUseIndices_;
+    Multithreading::Unlock(&lock_);
+    return pSnapshot;
+}
+
+Simulation::Simulation(std::shared_ptr<Trace> pTrace, std::vector<ConfigDescriptor> descriptors)
+    : pTrace_(std::move(pTrace)), descriptors_(std::move(descriptors)) {
+    accesses_ = pTrace_->GetAccesses();
+    pNextUseIndices_ = pTrace_->GetNextUseIndices(descriptors_);
+    summaries_ = std::vector<ConfigSummary>(descriptors_.size());
+    numConfigsLeft_ = descriptors_.size();
+    Multithreading::InitializeLock(&lock_);
+    Multithreading::InitializeCondition(&configCompleted_);
+}
+
+ConfigDescriptor Simulation::GetDefaultDescriptor(uint8_t numberOfCacheLevels) {
+    ConfigDescriptor descriptor = ConfigDescriptor();
+    descriptor.numberOfCacheLevels = numberOfCacheLevels;
+    descriptor.mainMemoryTiming = {kDefaultAccessTimeInCycles[kMainMemory],
+                                   kDefaultMaxOutstandingRequests[kMainMemory]};
+    for (uint8_t i = 0; i < kMaxNumberOfCacheLevels; i++) {
+        descriptor.configs[i].timing = {kDefaultAccessTimeInCycles[i], kDefaultMaxOutstandingRequests[i]};
+    }
+    return descriptor;
+}
+
+bool Simulation::IsDescriptorValid(const ConfigDescriptor& descriptor, char* pError, size_t errorSize) {
+    if (descriptor.numberOfCacheLevels == 0 || descriptor.numberOfCacheLevels > kMaxNumberOfCacheLevels) {
+        snprintf(pError, errorSize, "Config needs 1 to %d cache levels", kMaxNumberOfCacheLevels);
+        return false;
+    }
+    const LevelTiming* pTimings[kMaxNumberOfCacheLevels + 1] = {};
+    for (uint8_t i = 0; i < descriptor.numberOfCacheLevels; i++) {
+        const Configuration& config = descriptor.configs[i];
+        // Same constraints as the sweeps of the ini, where a lower level never has smaller blocks
+        if (!config.cacheSize || !config.blockSize || !config.associativity || !isPowerOfTwo(config.cacheSize) ||
+            !isPowerOfTwo(config.blockSize) || !isPowerOfTwo(config.associativity) ||
+            config.cacheSize < config.blockSize || config.cacheSize / config.blockSize < config.associativity ||
+            (i && config.blockSize < descriptor.configs[i - 1].blockSize)) {
+            snprintf(pError, errorSize, "L%d needs a power of two size, block size & associativity, that fit in each "
+                                        "other & in the lower levels", i + 1);
+            return false;
+        }
+        if (config.replacementPolicy >= kNumberOfReplacementPolicies) {
+            snprintf(pError, errorSize, "L%d has an unknown replacement policy", i + 1);
+            return false;
+        }
+        // The next use kOPT ranks victims by is that of the data trace, which only L1 sees
+        if (i != kL1 && config.replacementPolicy == kOPT) {
+            snprintf(pError, errorSize, "L%d cannot use OPT, only L1 can", i + 1);
+            return false;
+        }
+        pTimings[i] = &config.timing;
+    }
+    pTimings[descriptor.numberOfCacheLevels] = &descriptor.mainMemoryTiming;
+    for (uint8_t i = 0; i <= descriptor.numberOfCacheLevels; i++) {
+        // Request indices are handed out as int16_t
+        if (!pTimings[i]->accessTimeInCycles || !pTimings[i]->maxOutstandingRequests ||
+            pTimings[i]->maxOutstandingRequests > INT16_MAX) {
+            char level[16] = "Main memory";
+            if (i < descriptor.numberOfCacheLevels) {
+                snprintf(level, sizeof(level), "L%d", i + 1);
+            }
+            snprintf(pError, errorSize, "%s needs an access time & a queue depth of 1 to %d", level, INT16_MAX);
+            return false;
+        }
+    }
+    return true;
+}
+
+void Simulation::Run() {
+    Arena arena;
+    for (uint64_t configIndex = 0; configIndex < descriptors_.size(); configIndex++) {
+        RunConfig(configIndex, arena);
+    }
+}
+
+void Simulation::RunConfig(uint64_t configIndex, Arena& arena) {
+    assert_release(configIndex < descriptors_.size());
+    // Simulations are not tracked for progress nor sim traced
+    uint64_t accessIndex = 0;
+    SimCacheContext simCacheContext;
+    simCacheContext.pDescriptor = &descriptors_[configIndex];
+    simCacheContext.pAccesses = &accesses_;
+    simCacheContext.pNextUseIndices = pNextUseIndices_.get();
+    simCacheContext.pSummary = &summaries_[configIndex];
+    simCacheContext.pAccessIndex = &accessIndex;
+    simCacheContext.pSimTracer = nullptr;
+    simCacheContext.pLock = nullptr;
+    simCacheContext.threadId = 0;
+    simCacheContext.pArena = &arena;
+    arena.Resize(Simulator::GetArenaSize(descriptors_[configIndex]));
+    Simulator::SimCache(simCacheContext);
+    Multithreading::Lock(&lock_);
+    completedConfigs_.push_back(configIndex);
+    numConfigsLeft_--;
+    Multithreading::WakeAll(&configCompleted_);
+    Multithreading::Unlock(&lock_);
+}
+
+bool Simulation::WaitForCompleted(std::vector<uint64_t>& configIndices) {
+    configIndices.clear();
+    Multithreading::Lock(&lock_);
+    while (completedConfigs_.empty() && numConfigsLeft_) {
+        Multithreading::WaitForCondition(&configCompleted_, &lock_);
+    }
+    configIndices.swap(completedConfigs_);
+    Multithreading::Unlock(&lock_);
+    return !configIndices.empty();
+}
+
+void Simulation::Wait() {
+    Multithreading::Lock(&lock_);
+    while (numConfigsLeft_) {
+        Multithreading::WaitForCondition(&configCompleted_, &lock_);
+    }
+    Multithreading::Unlock(&lock_);
+}
+
+WorkerPool::WorkerPool(uint64_t numWorkers) : WorkerPool(numWorkers, UINT64_MAX) {
+}
+
+WorkerPool::WorkerPool(uint64_t numWorkers, uint64_t memoryBudget)
+    : isStopping_(false), memoryBudget_(memoryBudget), admittedBytes_(0) {
+    Multithreading::InitializeLock(&lock_);
+    Multithreading::InitializeCondition(&workAvailable_);
+    workers_ = std::vector<Thread_t>(numWorkers);
+    workerContexts_ = std::vector<PoolWorkerContext>(numWorkers);
+    arenas_ = std::vector<Arena>(numWorkers);
+    workerFootprints_ = std::vector<uint64_t>(numWorkers, 0);
+    for (uint64_t threadId = 0; threadId < numWorkers; threadId++) {
+        workerContexts_[threadId].pPool = this;
+        workerContexts_[threadId].threadId = threadId;
+        Multithreading::StartThread(WorkerPool::RunWorker, static_cast<void*>(&workerContexts_[threadId]),
+                                    &workers_[threadId]);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    Multithreading::Lock(&lock_);
+    isStopping_ = true;
+    Multithreading::WakeAll(&workAvailable_);
+    Multithreading::Unlock(&lock_);
+    Multithreading::WaitForThreads(workers_);
+}
+
+void WorkerPool::Submit(Simulation& simulation) {
+    Multithreading::Lock(&lock_);
+    for (uint64_t configIndex = 0; configIndex < simulation.GetNumConfigs(); configIndex++) {
+        workQueue_.push_back(
+            PoolWorkItem{&simulation, configIndex, Simulator::GetArenaSize(simulation.GetDescriptor(configIndex))});
+    }
+    Multithreading::WakeAll(&workAvailable_);
+    Multithreading::Unlock(&lock_);
+}
+
+void WorkerPool::Submit(Simulation& simulation, uint64_t configIndex) {
+    assert_release(configIndex < simulation.GetNumConfigs());
+    Multithreading::Lock(&lock_);
+    workQueue_.push_back(
+        PoolWorkItem{&simulation, configIndex, Simulator::GetArenaSize(simulation.GetDescriptor(configIndex))});
+    Multithreading::WakeAll(&workAvailable_);
+    Multithreading::Unlock(&lock_);
+}
+
+#ifdef _MSC_VER
+DWORD WINAPI WorkerPool::RunWorker(void* pWorkerContext) {
+#else
+void* WorkerPool::RunWorker(void* pWorkerContext) {
+#endif
+    const PoolWorkerContext& workerContext = *static_cast<PoolWorkerContext*>(pWorkerContext);
+    WorkerPool* pPool = workerContext.pPool;
+    // Left to the scheduler, a library must not change the affinity of its host's threads
+    Arena& arena = pPool->arenas_[workerContext.threadId];
+    PoolWorkItem workItem;
+    while (pPool->popWorkItem(workerContext.threadId, workItem)) {
+        workItem.pSimulation->RunConfig(workItem.configIndex, arena);
+    }
+#ifdef _MSC_VER
+    return 0;
+#else
+    pthread_exit(NULL);
+    return nullptr;
+#endif
+}
+
+bool WorkerPool::popWorkItem(uint64_t threadId, PoolWorkItem& workItem) {
+    Multithreading::Lock(&lock_);
+    if (workerFootprints_[threadId] != 0) {
+        // The worker is done with its last config, only the other workers hold memory
+        admittedBytes_ -= workerFootprints_[threadId];
+        workerFootprints_[threadId] = 0;
+        Multithreading::WakeAll(&workAvailable_);
+    }
+    while (true) {
+        auto workItemLeft = std::find_if(workQueue_.begin(), workQueue_.end(), [this](const PoolWorkItem& item) {
+            return admittedBytes_ + item.footprint <= memoryBudget_;
+        });
+        if (workItemLeft == workQueue_.end() && admittedBytes_ == 0) {
+            // Over the budget on its own, runs once nothing else does
+            workItemLeft = workQueue_.begin();
+        }
+        if (workItemLeft != workQueue_.end()) {
+            workItem = *workItemLeft;
+            workQueue_.erase(workItemLeft);
+            workerFootprints_[threadId] = workItem.footprint;
+            admittedBytes_ += workItem.footprint;
+            Multithreading::Unlock(&lock_);
+            return true;
+        }
+        if (workQueue_.empty() && isStopping_) {
+            Multithreading::Unlock(&lock_);
+            return false;
+        }
+        if (!workQueue_.empty()) {
+            // Nothing left that fits, give the memory of the arena back while waiting
+            arenas_[threadId].Release();
+        }
+        Multithreading::WaitForCondition(&workAvailable_, &lock_);
+    }
+}
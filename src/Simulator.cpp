@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <algorithm>
 #include <chrono>
@@ -14,65 +15,135 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
 #ifdef _MSC_VER
 #define NOMINMAX
 #include <Windows.h>
+#include <psapi.h>
 #endif
 
 #include "Cache.h"
+#include "CacheHierarchy.h"
+#include "HugePages.h"
 #include "IOUtilities.h"
 #include "Multithreading.h"
 #include "RequestManager.h"
 #include "SimTracer.h"
+#include "Simulation.h"
 #include "Simulator.h"
+#include "Topology.h"
 #include "debug.h"
 #include "default_test_params.h"
 
-#if (SIM_TRACE == 1)
-SimTracer* gSimTracer;
-FILE* sim_trace_f;
-#endif
-
-TestParamaters gTestParams;
+const Configuration Simulator::kInstructionCacheConfig =
+    Configuration(65536, 1024, 2, {kDefaultAccessTimeInCycles[kL1], kDefaultMaxOutstandingRequests[kL1]});
 
-Simulator::Simulator(const char* pInputFilename) : numThreadsOutstanding_(0) {
-
-    // Look for test parameters file and generate a default if not found
-    IOUtilities::LoadTestParameters();
+/**
+ * @brief                   Get a fingerprint of a sweep, FNV-1a over the identity of its trace file, as SharedTrace
+ * names its segment, & over its configs
+ *
+ * @param pTraceFilename    Trace file
+ * @param descriptors       Configs of the sweep, in enumeration order
+ * @return                  Fingerprint
+ */
+static uint64_t fingerprintSweep(const char* pTraceFilename, const std::vector<ConfigDescriptor>& descriptors) {
+    std::vector<uint64_t> words;
+    struct stat traceStat;
+    if (stat(pTraceFilename, &traceStat) == 0) {
+        words = {static_cast<uint64_t>(traceStat.st_dev), static_cast<uint64_t>(traceStat.st_ino),
+                 static_cast<uint64_t>(traceStat.st_size), static_cast<uint64_t>(traceStat.st_mtime)};
+    }
+    for (const ConfigDescriptor& descriptor : descriptors) {
+        words.push_back(descriptor.numberOfCacheLevels);
+        for (uint8_t i = 0; i < descriptor.numberOfCacheLevels; i++) {
+            const Configuration& config = descriptor.configs[i];
+            words.insert(words.end(), {config.cacheSize, config.blockSize, config.associativity,
+                                       static_cast<uint64_t>(config.replacementPolicy),
+                                       config.timing.accessTimeInCycles, config.timing.maxOutstandingRequests});
+        }
+        words.push_back(descriptor.mainMemoryTiming.accessTimeInCycles);
+        words.push_back(descriptor.mainMemoryTiming.maxOutstandingRequests);
+    }
+    uint64_t hash = 0xcbf29ce484222325;
+    for (uint64_t word : words) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash = (hash ^ ((word >> (8 * byte)) & 0xff)) * 0x100000001b3;
+        }
+    }
+    return hash;
+}
 
-    // Read in trace file
-    uint64_t fileLength = 0;
-    uint8_t* pFileContents = IOUtilities::ReadInFile(pInputFilename, fileLength);
-    IOUtilities::ParseBuffer(pFileContents, fileLength, accesses_);
+Simulator::Simulator(const char* pInputFilename, const TestParamaters& params, uint64_t shardIndex, uint64_t numShards)
+    : params_(params), accesses_(&hugePageUsage_), footprint_(trace_.dataAccesses_), shardIndex_(shardIndex),
+      numShards_(numShards), numThreadsOutstanding_(0) {
+    assert_release(shardIndex_ < numShards_);
+
+    // Read in trace file. Shards on the same host share one parsed copy
+    if (numShards_ > 1 && sharedTrace_.Attach(pInputFilename)) {
+        trace_ = sharedTrace_.GetView();
+    } else {
+        uint64_t fileLength = 0;
+        uint8_t* pFileContents = IOUtilities::ReadInFile(pInputFilename, fileLength);
+        IOUtilities::ParseBuffer(pFileContents, fileLength, accesses_);
+        trace_ = accesses_.View();
+    }
 
 #ifdef _MSC_VER
-    if (gTestParams.maxNumberOfThreads > MAXIMUM_WAIT_OBJECTS) {
-        gTestParams.maxNumberOfThreads = MAXIMUM_WAIT_OBJECTS;
+    if (params_.maxNumberOfThreads > MAXIMUM_WAIT_OBJECTS) {
+        params_.maxNumberOfThreads = MAXIMUM_WAIT_OBJECTS;
         printf("Setting maximum number of threads to Windows maximum of %" PRId32 "\n", MAXIMUM_WAIT_OBJECTS);
     }
 #endif
-    caches_ = std::vector<std::vector<std::unique_ptr<Cache>>>();
+    if (params_.replacementPolicy == kOPT || params_.compareToOptimal) {
+        buildNextUseIndices();
+    }
 
-    SetupCaches(kL1, gTestParams.minBlockSize[kL1], gTestParams.minCacheSize[kL1]);
-    numConfigs_ = caches_.size();
+    // Configs with the same results on this trace are simulated once
+    descriptors_ = EnumerateConfigs(params_);
+    for (const ConfigDescriptor& descriptor : descriptors_) {
+        auto scheduledConfig = scheduledConfigs_.try_emplace(GetResultKey(descriptor, footprint_), aliasOf_.size());
+        aliasOf_.push_back(scheduledConfig.first->second);
+    }
+    numConfigs_ = descriptors_.size();
+    sweepFingerprint_ = fingerprintSweep(pInputFilename, descriptors_);
+    assignShards();
+    footprint_.PrintSummary(stdout);
     printf("Total number of possible configs = %" PRIu64 "\n", numConfigs_);
-    if (numConfigs_ < static_cast<uint64_t>(gTestParams.maxNumberOfThreads) || (gTestParams.maxNumberOfThreads < 0)) {
-        gTestParams.maxNumberOfThreads = numConfigs_;
+    printf("Deduplicated %" PRIu64 " configs with results identical to an already scheduled config\n",
+           numConfigs_ - scheduledConfigs_.size());
+    if (numShards_ > 1) {
+        printf("Shard %" PRIu64 "/%" PRIu64 " simulates %" PRIu64 " of the configs, for %" PRIu64 " results\n",
+               shardIndex_, numShards_, configsToTest_, numConfigsInShard_);
+    }
+    if (configsToTest_ < static_cast<uint64_t>(params_.maxNumberOfThreads) || (params_.maxNumberOfThreads < 0)) {
+        params_.maxNumberOfThreads = configsToTest_;
+    }
+    // Shards sharing a host would each pin their workers the same way and crowd the same CPUs, they are left to the
+    // scheduler
+    isPinningWorkers_ = numShards_ == 1 && topology_.ShouldPinWorkers(params_.maxNumberOfThreads);
+    topology_.PrintSummary(params_.maxNumberOfThreads, isPinningWorkers_, stdout);
+    summaries_ = std::vector<ConfigSummary>(numConfigs_);
+    footprints_ = std::vector<uint64_t>(numConfigs_, 0);
+    for (uint64_t i = 0; i < numConfigs_; i++) {
+        if (aliasOf_[i] == i && shardOf_[i] == shardIndex_) {
+            footprints_[i] = GetArenaSize(descriptors_[i]);
+        }
     }
-    configsToTest_ = numConfigs_;
-    cycleCounters_ = std::vector<uint64_t>(numConfigs_);
-    threads_ = std::vector<Thread_t>(numConfigs_);
 
 #if (SIM_TRACE == 1)
-    uint64_t simTraceBufferMemorySize = gTestParams.maxNumberOfThreads * kSimTraceBufferSizeInBytes;
+    uint64_t simTraceBufferMemorySize = params_.maxNumberOfThreads * kSimTraceBufferSizeInBytes;
     if (simTraceBufferMemorySize > MEMORY_USAGE_LIMIT) {
         const int32_t newMaxNumberOfThreads = MEMORY_USAGE_LIMIT / kSimTraceBufferSizeInBytes;
         printf("Sim trace buffer memory is too big for %" PRId64 " threads. Lower thread "
                "count to %d\n",
-               gTestParams.maxNumberOfThreads, newMaxNumberOfThreads);
-        gTestParams.maxNumberOfThreads = newMaxNumberOfThreads;
+               params_.maxNumberOfThreads, newMaxNumberOfThreads);
+        params_.maxNumberOfThreads = newMaxNumberOfThreads;
     }
-    gSimTracer = new SimTracer(SIM_TRACE_FILENAME, numConfigs_);
+    pSimTracer_ = new SimTracer(SIM_TRACE_FILENAME, configsToTest_, params_.numberOfCacheLevels,
+                                params_.maxNumberOfThreads);
 #endif
 }
 
@@ -83,7 +154,9 @@ void* Simulator::TrackProgress(void* pSimulatorPointer) {
 #endif
     Simulator* pSimulator = static_cast<Simulator*>(pSimulatorPointer);
     const uint64_t numAccesses = static_cast<float>(pSimulator->GetNumAccesses());
-    float oneConfigPercentage = 100.0f / static_cast<float>(pSimulator->numConfigs_);
+    // Counted in the configs simulated, as configsToTest_ is, the aliases complete with them
+    const uint64_t numConfigsSimulated = pSimulator->numConfigsSimulatedInShard_;
+    float oneConfigPercentage = 100.0f / static_cast<float>(numConfigsSimulated);
     char progressBar[] = "[                                        ]";
     const int progressBars = sizeof(progressBar) / sizeof(char) - 3;
 
@@ -91,11 +164,11 @@ void* Simulator::TrackProgress(void* pSimulatorPointer) {
     while (pSimulator->configsToTest_) {
         // Calculate progress
         // 1. Configs completed
-        uint64_t configsDone = pSimulator->numConfigs_ - pSimulator->configsToTest_;
-        float progressPercent = (configsDone / static_cast<float>(pSimulator->numConfigs_)) * 100.0f;
+        uint64_t configsDone = numConfigsSimulated - pSimulator->configsToTest_;
+        float progressPercent = (configsDone / static_cast<float>(numConfigsSimulated)) * 100.0f;
 
         // 2. Configs in progress
-        for (auto i = 0; i < gTestParams.maxNumberOfThreads; i++) {
+        for (auto i = 0; i < pSimulator->params_.maxNumberOfThreads; i++) {
             if (pSimulator->accessIndices_[i] < numAccesses) {
                 progressPercent +=
                     oneConfigPercentage * (static_cast<float>(pSimulator->accessIndices_[i]) / numAccesses);
@@ -127,71 +200,409 @@ void* Simulator::TrackProgress(void* pSimulatorPointer) {
 #endif
 }
 
-void Simulator::PrintStats(FILE* pTextStream, FILE* pCSVStream) {
-    float minCpi = static_cast<float>(cycleCounters_[0]);
-    uint64_t min_i = 0;
-    if (pCSVStream) {
-        for (int i = 0; i < gTestParams.numberOfCacheLevels; i++) {
-            fprintf(pCSVStream, "Cache level, Cache size, Block size, Associativity, Num "
-                                "reads, Read miss rate, Num writes, Write miss rate, Total "
-                                "miss rate,");
+void Simulator::buildNextUseIndices() {
+    for (uint8_t cacheLevel = 0; cacheLevel < params_.numberOfCacheLevels; cacheLevel++) {
+        for (uint64_t blockSize = params_.minBlockSize[cacheLevel]; blockSize <= params_.maxBlockSize[cacheLevel];
+             blockSize <<= 1) {
+            bool alreadyBuilt = std::any_of(nextUseIndices_.begin(), nextUseIndices_.end(),
+                                            [blockSize](const NextUseIndex& nextUseIndex) {
+                                                return nextUseIndex.GetBlockSize() == blockSize;
+                                            });
+            if (!alreadyBuilt) {
+                nextUseIndices_.emplace_back(trace_.dataAccesses_, blockSize, &hugePageUsage_);
+            }
         }
-        fprintf(pCSVStream, "Main memory reads, Main memory writes, Total number of "
-                            "cycles, CPI\n");
     }
+}
+
+void Simulator::SetResultStreams(FILE* pTextStream, FILE* pCSVStream, FILE* pJSONStream, FILE* pColumnsStream) {
+    pTextStream_ = pTextStream;
+    pCSVStream_ = pCSVStream;
+    pJSONStream_ = pJSONStream;
+    pColumnsStream_ = pColumnsStream;
+}
+
+void Simulator::WritePartialResults(FILE* pStream) {
+    PartialResults results;
+    results.shardIndex = shardIndex_;
+    results.numShards = numShards_;
+    results.numConfigs = numConfigs_;
+    results.compareToOptimal = params_.compareToOptimal;
+    results.sweepFingerprint = sweepFingerprint_;
     for (uint64_t i = 0; i < numConfigs_; i++) {
-        IOUtilities::PrintStatistics(*caches_[i][kDataCache], cycleCounters_[i], pTextStream);
-        IOUtilities::PrintStatisticsCSV(*caches_[i][kDataCache], cycleCounters_[i], pCSVStream);
-        const Statistics& stats = caches_[i][kDataCache]->ViewStats();
-        float cpi = static_cast<float>(cycleCounters_[i]) / (stats.numInstructions);
-        if (cpi < minCpi) {
-            minCpi = cpi;
-            min_i = i;
+        if (shardOf_[i] == shardIndex_) {
+            results.configIndices.push_back(i);
+            results.descriptors.push_back(descriptors_[i]);
+            results.summaries.push_back(summaries_[i]);
         }
     }
-    if (pCSVStream) {
-        fclose(pCSVStream);
-    }
-    fprintf(pTextStream, "The config with the lowest CPI of %.4f:\n", minCpi);
-    IOUtilities::PrintConfiguration(*caches_[min_i][kDataCache], pTextStream);
+    IOUtilities::WritePartialResults(results, pStream);
 }
 
 Simulator::~Simulator() {
 #if (SIM_TRACE == 1)
-    delete gSimTracer;
+    delete pSimTracer_;
     printf("Wrote sim trace output to %s\n", SIM_TRACE_FILENAME);
 #endif
 }
 
 #ifdef _MSC_VER
-DWORD WINAPI Simulator::SimCache(void* pSimCacheContext) {
+DWORD WINAPI Simulator::RunWorker(void* pWorkerContext) {
 #else
-void* Simulator::SimCache(void* pSimCacheContext) {
+void* Simulator::RunWorker(void* pWorkerContext) {
 #endif
-    SimCacheContext* simCacheContext = static_cast<SimCacheContext*>(pSimCacheContext);
-    auto theseCaches = std::vector<Cache*>(kNumberOfCacheTypes);
-    for (auto i = 0; i < kNumberOfCacheTypes; i++) {
-        theseCaches[i] = simCacheContext->caches[i];
-        assert(theseCaches[i]->GetCacheLevel() == kL1);
-        theseCaches[i]->AllocateMemory();
+    const WorkerContext& workerContext = *static_cast<WorkerContext*>(pWorkerContext);
+    Simulator* pSimulator = workerContext.pSimulator;
+    // Sized by the worker once pinned, so the pages it touches first are on its node
+    Arena& arena = pSimulator->arenas_[workerContext.threadId];
+    MemoryAccessesView accesses = pSimulator->trace_;
+    const std::vector<NextUseIndex>* pNextUseIndices = &pSimulator->nextUseIndices_;
+    if (pSimulator->isPinningWorkers_) {
+        pSimulator->topology_.PinWorker(workerContext.threadId);
+        const TraceReplica& replica =
+            pSimulator->traceReplicas_[pSimulator->topology_.GetNodeIndexOfWorker(workerContext.threadId)];
+        accesses = replica.accesses.View();
+        pNextUseIndices = &replica.nextUseIndices;
     }
-    Simulator* pSimulator = simCacheContext->pSimulator;
-    uint64_t configIndex = simCacheContext->configIndex;
+    uint64_t configIndex;
+    while (pSimulator->popQueuedConfig(workerContext.threadId, configIndex)) {
+        const auto start = std::chrono::steady_clock::now();
+        arena.Resize(pSimulator->footprints_[configIndex]);
+        SimCacheContext simCacheContext;
+        simCacheContext.pDescriptor = &pSimulator->descriptors_[configIndex];
+        simCacheContext.pAccesses = &accesses;
+        simCacheContext.pNextUseIndices = pNextUseIndices;
+        simCacheContext.pSummary = &pSimulator->GetSummary(configIndex);
+        simCacheContext.pAccessIndex = &pSimulator->accessIndices_[workerContext.threadId];
+        simCacheContext.pLock = &pSimulator->lock_;
+        simCacheContext.pSimTracer = pSimulator->pSimTracer_;
+        simCacheContext.threadId = workerContext.threadId;
+        simCacheContext.pArena = &arena;
+        SimCache(simCacheContext);
+        pSimulator->pResultWriter_->Push(configIndex);
+        Multithreading::Lock(&pSimulator->lock_);
+        pSimulator->DecrementConfigsToTest();
+        pSimulator->DecrementNumThreadsOutstanding();
+        Multithreading::Unlock(&pSimulator->lock_);
+        const std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+        pSimulator->recordRunTime(configIndex, runTime.count());
+    }
+#ifdef _MSC_VER
+    return 0;
+#else
+    pthread_exit(NULL);
+    return nullptr;
+#endif
+}
 
-    const MemoryAccesses& accesses = pSimulator->GetAccesses();
-    const uint64_t numAccesses = pSimulator->GetNumAccesses();
+#ifdef _MSC_VER
+DWORD WINAPI Simulator::BuildTraceReplica(void* pReplicaContext) {
+#else
+void* Simulator::BuildTraceReplica(void* pReplicaContext) {
+#endif
+    const ReplicaContext& replicaContext = *static_cast<ReplicaContext*>(pReplicaContext);
+    Simulator* pSimulator = replicaContext.pSimulator;
+    pSimulator->topology_.PinToNode(replicaContext.nodeIndex);
+    TraceReplica& replica = pSimulator->traceReplicas_[replicaContext.nodeIndex];
+    const MemoryAccessesView& trace = pSimulator->trace_;
+    replica.accesses = MemoryAccesses(&pSimulator->hugePageUsage_);
+    replica.accesses.dataAccesses_.assign(trace.dataAccesses_.begin(), trace.dataAccesses_.end());
+    replica.accesses.instructionAccesses_.assign(trace.instructionAccesses_.begin(), trace.instructionAccesses_.end());
+    replica.nextUseIndices = pSimulator->nextUseIndices_;
+#ifdef _MSC_VER
+    return 0;
+#else
+    pthread_exit(NULL);
+    return nullptr;
+#endif
+}
+
+double Simulator::EstimateCost(const ConfigDescriptor& descriptor, uint64_t numAccesses) {
+    double totalSets = 0;
+    for (uint8_t cacheLevel = 0; cacheLevel < descriptor.numberOfCacheLevels; cacheLevel++) {
+        const Configuration& config = descriptor.configs[cacheLevel];
+        totalSets += static_cast<double>(config.cacheSize / config.blockSize / config.associativity);
+    }
+    return totalSets * descriptor.numberOfCacheLevels * numAccesses;
+}
+
+double Simulator::predictRunTime(uint64_t configIndex) const {
+    const ConfigDescriptor& descriptor = descriptors_[configIndex];
+    const uint8_t numLevels = descriptor.numberOfCacheLevels;
+    const ReplacementPolicy policy = descriptor.configs[kL1].replacementPolicy;
+    if (measuredCosts_[numLevels][policy] > 0) {
+        return estimatedCosts_[configIndex] * measuredSeconds_[numLevels][policy] / measuredCosts_[numLevels][policy];
+    }
+    double allSeconds = 0;
+    double allCosts = 0;
+    for (uint8_t levels = 0; levels <= kMaxNumberOfCacheLevels; levels++) {
+        for (uint8_t i = 0; i < kNumberOfReplacementPolicies; i++) {
+            allSeconds += measuredSeconds_[levels][i];
+            allCosts += measuredCosts_[levels][i];
+        }
+    }
+    return allCosts > 0 ? estimatedCosts_[configIndex] * allSeconds / allCosts : estimatedCosts_[configIndex];
+}
+
+void Simulator::sortConfigQueue() {
+    std::vector<double> predictedRunTimes(numConfigs_);
+    for (auto config = configQueue_.begin() + nextQueuedConfig_; config != configQueue_.end(); config++) {
+        predictedRunTimes[*config] = predictRunTime(*config);
+    }
+    // Stable, so configs predicted to take as long keep their enumeration order
+    std::stable_sort(configQueue_.begin() + nextQueuedConfig_, configQueue_.end(),
+                     [&predictedRunTimes](uint64_t a, uint64_t b) {
+                         return predictedRunTimes[a] > predictedRunTimes[b];
+                     });
+}
+
+void Simulator::recordRunTime(uint64_t configIndex, double seconds) {
+    const ConfigDescriptor& descriptor = descriptors_[configIndex];
+    Multithreading::Lock(&lock_);
+    measuredSeconds_[descriptor.numberOfCacheLevels][descriptor.configs[kL1].replacementPolicy] += seconds;
+    measuredCosts_[descriptor.numberOfCacheLevels][descriptor.configs[kL1].replacementPolicy] +=
+        estimatedCosts_[configIndex];
+    sortConfigQueue();
+    Multithreading::Unlock(&lock_);
+}
+
+void Simulator::assignShards() {
+    estimatedCosts_ = std::vector<double>(numConfigs_);
+    std::vector<uint64_t> scheduledConfigs;
+    for (uint64_t i = 0; i < numConfigs_; i++) {
+        if (aliasOf_[i] == i) {
+            scheduledConfigs.push_back(i);
+            estimatedCosts_[i] = EstimateCost(descriptors_[i], GetNumAccesses());
+        }
+    }
+    // Longest first onto the least loaded shard. Depends on the configs & the trace length only, so every shard comes
+    // to the same assignment
+    std::stable_sort(scheduledConfigs.begin(), scheduledConfigs.end(),
+                     [this](uint64_t a, uint64_t b) { return estimatedCosts_[a] > estimatedCosts_[b]; });
+    std::vector<double> shardCosts(numShards_, 0);
+    shardOf_ = std::vector<uint64_t>(numConfigs_);
+    for (uint64_t configIndex : scheduledConfigs) {
+        const uint64_t shard = std::min_element(shardCosts.begin(), shardCosts.end()) - shardCosts.begin();
+        shardOf_[configIndex] = shard;
+        shardCosts[shard] += estimatedCosts_[configIndex];
+    }
+    configsToTest_ = 0;
+    numConfigsInShard_ = 0;
+    for (uint64_t i = 0; i < numConfigs_; i++) {
+        shardOf_[i] = shardOf_[aliasOf_[i]];
+        numConfigsInShard_ += shardOf_[i] == shardIndex_;
+        configsToTest_ += aliasOf_[i] == i && shardOf_[i] == shardIndex_;
+    }
+    numConfigsSimulatedInShard_ = configsToTest_;
+}
+
+bool Simulator::popQueuedConfig(uint64_t threadId, uint64_t& configIndex) {
+    Multithreading::Lock(&lock_);
+    if (workerFootprints_[threadId] != 0) {
+        // The worker is done with its last config, only the other workers hold memory
+        admittedBytes_ -= workerFootprints_[threadId];
+        workerFootprints_[threadId] = 0;
+        Multithreading::WakeAll(&memoryReleased_);
+    }
+    while (true) {
+        const auto queueBegin = configQueue_.begin() + nextQueuedConfig_;
+        // Longest first among the configs that fit, so smaller configs run alongside a larger one that does not
+        auto config = std::find_if(queueBegin, configQueue_.end(), [this](uint64_t i) {
+            return admittedBytes_ + footprints_[i] <= memoryBudget_;
+        });
+        if (config == configQueue_.end() && admittedBytes_ == 0) {
+            // Over the budget on its own, runs once nothing else does
+            config = queueBegin;
+        }
+        if (config != configQueue_.end()) {
+            std::rotate(queueBegin, config, config + 1);
+            configIndex = configQueue_[nextQueuedConfig_++];
+            workerFootprints_[threadId] = footprints_[configIndex];
+            admittedBytes_ += workerFootprints_[threadId];
+            peakAdmittedBytes_ = std::max(peakAdmittedBytes_, admittedBytes_);
+            ++numThreadsOutstanding_;
+            if (nextQueuedConfig_ == configQueue_.size()) {
+                // The workers waiting for memory have nothing left to wait for
+                Multithreading::WakeAll(&memoryReleased_);
+            }
+            Multithreading::Unlock(&lock_);
+            return true;
+        }
+        // Nothing left that fits, give the memory of the arena back while waiting
+        arenas_[threadId].Release();
+        if (nextQueuedConfig_ == configQueue_.size()) {
+            Multithreading::Unlock(&lock_);
+            return false;
+        }
+        Multithreading::WaitForCondition(&memoryReleased_, &lock_);
+    }
+}
+
+/**
+ * @brief   Get the memory this process may use, the physical memory or the limit of its cgroup if lower
+ *
+ * @return  Size in bytes, UINT64_MAX if unknown
+ */
+static uint64_t getAvailableMemory() {
+    uint64_t availableBytes = UINT64_MAX;
+#ifdef __linux__
+    const long numPages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (numPages > 0 && pageSize > 0) {
+        availableBytes = static_cast<uint64_t>(numPages) * static_cast<uint64_t>(pageSize);
+    }
+    // cgroup v2 & v1, a container may get less than the machine has. "max" means no limit
+    const char* pLimitFilenames[] = {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes"};
+    for (const char* pLimitFilename : pLimitFilenames) {
+        FILE* pLimitFile = fopen(pLimitFilename, "r");
+        if (pLimitFile == nullptr) {
+            continue;
+        }
+        uint64_t limitBytes;
+        if (fscanf(pLimitFile, "%" SCNu64, &limitBytes) == 1) {
+            availableBytes = std::min(availableBytes, limitBytes);
+        }
+        fclose(pLimitFile);
+    }
+#elif defined(_MSC_VER)
+    MEMORYSTATUSEX memoryStatus;
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    if (GlobalMemoryStatusEx(&memoryStatus)) {
+        availableBytes = memoryStatus.ullTotalPhys;
+    }
+#endif
+    return availableBytes;
+}
+
+/**
+ * @brief   Get the most memory this process has had resident at once
+ *
+ * @return  Size in bytes, 0 if unknown
+ */
+static uint64_t getPeakResidentBytes() {
+#ifdef __linux__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // In KiB on Linux
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+    }
+#elif defined(_MSC_VER)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+#endif
+    return 0;
+}
+
+uint64_t Simulator::GetMemoryBudget(const TestParamaters& params) {
+    uint64_t budget = params.memoryBudgetInMegabytes << 20;
+    if (budget == 0) {
+        const uint64_t availableBytes = getAvailableMemory();
+        budget = availableBytes == UINT64_MAX ? UINT64_MAX : availableBytes / 4 * 3;
+    }
+    return budget;
+}
+
+void Simulator::setMemoryBudget() {
+    const uint64_t budget = GetMemoryBudget(params_);
+    // The trace arrays & next-use indices stay in memory for the whole run, once more for every NUMA replica
+    uint64_t traceBytes = (trace_.dataAccesses_.size() + trace_.instructionAccesses_.size()) * sizeof(Instruction);
+    for (const NextUseIndex& nextUseIndex : nextUseIndices_) {
+        traceBytes += nextUseIndex.GetSizeInBytes();
+    }
+    traceBytes *= 1 + traceReplicas_.size();
+    memoryBudget_ = budget > traceBytes ? budget - traceBytes : 0;
+
+    uint64_t smallestFootprint = UINT64_MAX;
+    uint64_t largestFootprint = 0;
+    uint64_t numConfigsOverBudget = 0;
+    for (uint64_t configIndex : configQueue_) {
+        smallestFootprint = std::min(smallestFootprint, footprints_[configIndex]);
+        largestFootprint = std::max(largestFootprint, footprints_[configIndex]);
+        numConfigsOverBudget += footprints_[configIndex] > memoryBudget_;
+    }
+    if (configQueue_.empty()) {
+        smallestFootprint = 0;
+    }
+    constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+    if (budget == UINT64_MAX) {
+        printf("No memory budget, the memory available is unknown\n");
+    } else {
+        printf("Memory budget %.1f MiB, %.1f MiB of it for the trace, %.1f MiB for the configs running at once\n",
+               budget / kBytesPerMegabyte, traceBytes / kBytesPerMegabyte, memoryBudget_ / kBytesPerMegabyte);
+    }
+    printf("Configs take up %" PRIu64 " KiB to %" PRIu64 " KiB each while they run\n", smallestFootprint >> 10,
+           largestFootprint >> 10);
+    if (numConfigsOverBudget) {
+        printf("WARNING: %" PRIu64 " configs do not fit in the memory budget, each will run on its own\n",
+               numConfigsOverBudget);
+    }
+}
+
+void Simulator::SimCache(const SimCacheContext& simCacheContext) {
+    switch (simCacheContext.pDescriptor->numberOfCacheLevels) {
+    case 1:
+        simulateConfig<1>(simCacheContext);
+        break;
+    case 2:
+        simulateConfig<2>(simCacheContext);
+        break;
+    case 3:
+        simulateConfig<3>(simCacheContext);
+        break;
+    default:
+        assert_release(0 && "Unsupported number of cache levels");
+        break;
+    }
+}
+
+template <uint8_t kNumDataCacheLevels>
+void Simulator::simulateConfig(const SimCacheContext& simCacheContext) {
+    Arena& arena = *simCacheContext.pArena;
+    arena.Reset();
+
+    // The caches only exist while the config is simulated
+    const ConfigDescriptor& descriptor = *simCacheContext.pDescriptor;
+    CacheHierarchy<kNumDataCacheLevels> dataCaches(descriptor.configs, descriptor.mainMemoryTiming);
+    CacheHierarchy<1> instructionCaches(&kInstructionCacheConfig, descriptor.mainMemoryTiming);
+    dataCaches.SetThreadId(simCacheContext.threadId);
+    dataCaches.SetSimTracer(simCacheContext.pSimTracer);
+    dataCaches.SetNextUseIndices(*simCacheContext.pNextUseIndices);
+    dataCaches.AllocateMemory(arena);
+    instructionCaches.SetThreadId(simCacheContext.threadId);
+    instructionCaches.SetSimTracer(simCacheContext.pSimTracer);
+    instructionCaches.SetNextUseIndices(*simCacheContext.pNextUseIndices);
+    instructionCaches.AllocateMemory(arena);
+    Cache* const theseCaches[kNumberOfCacheTypes] = {&dataCaches.GetTopLevelCache(),
+                                                     &instructionCaches.GetTopLevelCache()};
+
+    const MemoryAccessesView& accesses = *simCacheContext.pAccesses;
+    const uint64_t numAccesses = accesses.instructionAccesses_.size();
 
     uint64_t localCycleCounter = 0;
-    uint64_t outstanding_requests[kNumberOfCacheTypes][RequestManager::kMaxNumberOfRequests] = {
-        Simulator::kInvalidRequestIndex};
+    // Request pools of the L1s are sized by their configs, so are the per-request tables of the main loop
+    const uint64_t maxOutstandingRequests[kNumberOfCacheTypes] = {
+        descriptor.configs[kL1].timing.maxOutstandingRequests, kInstructionCacheConfig.timing.maxOutstandingRequests};
+    uint64_t* outstanding_requests[kNumberOfCacheTypes];
     auto completed_requests = std::vector<std::vector<int16_t>>(kNumberOfCacheTypes, std::vector<int16_t>());
+    for (auto cacheType = 0; cacheType < kNumberOfCacheTypes; cacheType++) {
+        outstanding_requests[cacheType] = arena.Allocate<uint64_t>(maxOutstandingRequests[cacheType]);
+        std::fill_n(outstanding_requests[cacheType], maxOutstandingRequests[cacheType],
+                    Simulator::kInvalidRequestIndex);
+        completed_requests[cacheType].reserve(maxOutstandingRequests[cacheType]);
+    }
 
-    DoubleList* pDataAccessRequests = new DoubleList(RequestManager::kMaxNumberOfRequests);
-    DoubleList* pFreeAccessRequests = new DoubleList(RequestManager::kMaxNumberOfRequests);
+    // FIFO of data accesses whose instruction fetch has completed, slot -> index of the data access in the trace.
+    // Every slot is reserved by an outstanding instruction fetch, so it is as deep as the instruction L1
+    const uint64_t numAccessRequestSlots = maxOutstandingRequests[kInstructionCache];
+    uint64_t* dataAccessIndices = arena.Allocate<uint64_t>(numAccessRequestSlots);
+    IndexListNode* pAccessRequestNodes = arena.Allocate<IndexListNode>(numAccessRequestSlots);
+    IndexList dataAccessRequests(pAccessRequestNodes, numAccessRequestSlots);
+    IndexList freeAccessRequests(pAccessRequestNodes, numAccessRequestSlots);
     uint64_t reservedCount = 0;
-    for (uint64_t requestIndex = 0; requestIndex < RequestManager::kMaxNumberOfRequests; requestIndex++) {
-        DoubleListElement* pElement = new DoubleListElement;
-        pFreeAccessRequests->PushElement(pElement);
+    for (uint64_t requestIndex = 0; requestIndex < numAccessRequestSlots; requestIndex++) {
+        freeAccessRequests.PushFront(requestIndex);
     }
     uint64_t i = 0;
     bool work_done = false;
@@ -205,14 +616,16 @@ void* Simulator::SimCache(void* pSimCacheContext) {
         isOutstandingRequest = false;
         work_done = false;
 
-        if (pDataAccessRequests->PeekHead()) {
-            DoubleListElement* pElement = pDataAccessRequests->PeekHead();
-            uint64_t instructionIndex = pElement->poolIndex_;
-            int16_t request_index =
-                theseCaches[kDataCache]->AddAccessRequest(accesses.dataAccesses_[instructionIndex], localCycleCounter);
+        if (dataAccessRequests.GetCount()) {
+            const uint64_t slot = dataAccessRequests.PeekFront();
+            uint64_t instructionIndex = dataAccessIndices[slot];
+            Instruction dataAccess = accesses.dataAccesses_[instructionIndex];
+            // Tells kOPT caches where in the trace this access is
+            dataAccess.dataAccessIndex = instructionIndex;
+            int16_t request_index = theseCaches[kDataCache]->IssueAccessRequest(dataAccess, localCycleCounter);
             if (request_index != RequestManager::kInvalidRequestIndex) {
-                pElement = pDataAccessRequests->PopElement();
-                pFreeAccessRequests->PushElement(pElement);
+                dataAccessRequests.PopFront();
+                freeAccessRequests.PushFront(slot);
                 outstanding_requests[kDataCache][request_index] = Simulator::kDataAccessRequest;
                 work_done = true;
             }
@@ -220,8 +633,8 @@ void* Simulator::SimCache(void* pSimCacheContext) {
         }
 
         if ((i < numAccesses) && !work_done) {
-            if (pDataAccessRequests->GetCount() + reservedCount < pDataAccessRequests->GetCapacity()) {
-                int16_t request_index = theseCaches[kInstructionCache]->AddAccessRequest(
+            if (dataAccessRequests.GetCount() + reservedCount < dataAccessRequests.GetCapacity()) {
+                int16_t request_index = theseCaches[kInstructionCache]->IssueAccessRequest(
                     accesses.instructionAccesses_[i], localCycleCounter);
                 if (request_index != -1) {
                     reservedCount++;
@@ -230,23 +643,24 @@ void* Simulator::SimCache(void* pSimCacheContext) {
                     ++i;
                     // Periodically sync the index for use by progress tracker
                     if (i % Simulator::kProgressTrackerSyncPeriod == 0) {
-                        pSimulator->accessIndices_[theseCaches[kDataCache]->threadId_] = i;
+                        *simCacheContext.pAccessIndex = i;
                     }
                     isOutstandingRequest = true;
                 }
             }
         }
 
-        for (auto j = 0; j < kNumberOfCacheTypes; j++) {
 #if (CONSOLE_PRINT == 1)
-            if (j == kDataCache) {
-                printf("Data Cache\n");
-            } else if (j == kInstructionCache) {
-                printf("Instruction Cache\n");
-            }
+        printf("Data Cache\n");
+#endif
+        completed_requests[kDataCache].clear();
+        dataCaches.ProcessCache(localCycleCounter, completed_requests[kDataCache]);
+#if (CONSOLE_PRINT == 1)
+        printf("Instruction Cache\n");
 #endif
-            completed_requests[j].clear();
-            theseCaches[j]->ProcessCache(localCycleCounter, completed_requests[j]);
+        completed_requests[kInstructionCache].clear();
+        instructionCaches.ProcessCache(localCycleCounter, completed_requests[kInstructionCache]);
+        for (auto j = 0; j < kNumberOfCacheTypes; j++) {
             work_done |= theseCaches[j]->GetWasWorkDoneThisCycle();
         }
 
@@ -273,22 +687,18 @@ void* Simulator::SimCache(void* pSimCacheContext) {
             if (accesses.instructionAccesses_[complete_request_index].dataAccessIndex == Instruction::invalidIndex) {
                 continue;
             }
-            DoubleListElement* pElement = pFreeAccessRequests->PopElement();
-            assert(pElement);
-            pElement->poolIndex_ = accesses.instructionAccesses_[complete_request_index].dataAccessIndex;
-            pDataAccessRequests->AddElementToTail(pElement);
+            const uint64_t slot = freeAccessRequests.PopFront();
+            assert(slot != IndexList::kNone);
+            dataAccessIndices[slot] = accesses.instructionAccesses_[complete_request_index].dataAccessIndex;
+            dataAccessRequests.PushBack(slot);
 
             isOutstandingRequest = true;
         }
         if (work_done) {
             localCycleCounter++;
         } else {
-            uint64_t earliestNextUsefulCycle = UINT64_MAX;
-            for (auto j = 0; j < kNumberOfCacheTypes; j++) {
-                uint64_t nextUsefulCycle = theseCaches[j]->CalculateEarliestNextUsefulCycle();
-                earliestNextUsefulCycle =
-                    nextUsefulCycle < earliestNextUsefulCycle ? nextUsefulCycle : earliestNextUsefulCycle;
-            }
+            const uint64_t earliestNextUsefulCycle = std::min(dataCaches.CalculateEarliestNextUsefulCycle(),
+                                                              instructionCaches.CalculateEarliestNextUsefulCycle());
             assert(earliestNextUsefulCycle > localCycleCounter);
             if (earliestNextUsefulCycle < UINT64_MAX) {
 #if (CONSOLE_PRINT == 1)
@@ -301,7 +711,7 @@ void* Simulator::SimCache(void* pSimCacheContext) {
         }
         if (!isOutstandingRequest) {
             for (auto cacheType = 0; cacheType < kNumberOfCacheTypes; cacheType++) {
-                for (uint64_t requestIndex = 0; requestIndex < RequestManager::kMaxNumberOfRequests; requestIndex++) {
+                for (uint64_t requestIndex = 0; requestIndex < maxOutstandingRequests[cacheType]; requestIndex++) {
                     if (outstanding_requests[cacheType][requestIndex] != Simulator::kInvalidRequestIndex) {
                         isOutstandingRequest = true;
                         break;
@@ -313,28 +723,30 @@ void* Simulator::SimCache(void* pSimCacheContext) {
     Statistics& stats = theseCaches[kDataCache]->GetStats();
     assert(stats.readHits + stats.readMisses + stats.writeHits + stats.writeMisses == accesses.dataAccesses_.size());
     stats.numInstructions = numAccesses;
-    pSimulator->accessIndices_[theseCaches[kDataCache]->threadId_] = i;
-    pSimulator->GetCycleCounter(configIndex) = localCycleCounter;
-    Multithreading::Lock(&pSimulator->lock_);
+    *simCacheContext.pAccessIndex = i;
+    // Reduce the config to its summary, the caches go away with this thread
+    ConfigSummary& summary = *simCacheContext.pSummary;
+    dataCaches.Summarize(summary);
+    summary.cycles = localCycleCounter;
 #if (SIM_TRACE == 1)
-    gSimTracer->WriteThreadBuffer(theseCaches[kDataCache]);
-#endif
-    pSimulator->DecrementConfigsToTest();
-    pSimulator->DecrementNumThreadsOutstanding();
-    // Mark thread as not in use
-    pSimulator->GetThreadsOutstanding()[theseCaches[kDataCache]->threadId_] = Simulator::kInvalidThreadId;
-    Multithreading::Unlock(&pSimulator->lock_);
-    for (auto i = 0; i < kNumberOfCacheTypes; i++) {
-        theseCaches[i]->FreeMemory();
+    if (simCacheContext.pSimTracer) {
+        Multithreading::Lock(simCacheContext.pLock);
+        simCacheContext.pSimTracer->WriteThreadBuffer(theseCaches[kDataCache]);
+        Multithreading::Unlock(simCacheContext.pLock);
     }
-#ifdef _MSC_VER
-    return 0;
-#else
-    delete pFreeAccessRequests;
-    delete pDataAccessRequests;
-    pthread_exit(NULL);
-    return nullptr;
 #endif
+    dataCaches.FreeMemory();
+    instructionCaches.FreeMemory();
+}
+
+uint64_t Simulator::GetArenaSize(const ConfigDescriptor& descriptor) {
+    const uint64_t numAccessRequestSlots = kInstructionCacheConfig.timing.maxOutstandingRequests;
+    return Arena::GetAllocationSize<uint64_t>(descriptor.configs[kL1].timing.maxOutstandingRequests) +
+           Arena::GetAllocationSize<uint64_t>(kInstructionCacheConfig.timing.maxOutstandingRequests) +
+           Arena::GetAllocationSize<uint64_t>(numAccessRequestSlots) +
+           Arena::GetAllocationSize<IndexListNode>(numAccessRequestSlots) +
+           Cache::GetArenaSize(descriptor.numberOfCacheLevels, descriptor.configs, descriptor.mainMemoryTiming) +
+           Cache::GetArenaSize(1, &kInstructionCacheConfig, descriptor.mainMemoryTiming);
 }
 
 void Simulator::DecrementConfigsToTest() {
@@ -351,77 +763,184 @@ void Simulator::DecrementNumThreadsOutstanding() {
  */
 void Simulator::CreateAndRunThreads(void) {
     Multithreading::InitializeLock(&lock_);
+    Multithreading::InitializeCondition(&memoryReleased_);
 
-    int64_t threadId = 0;
+    accessIndices_ = std::vector<uint64_t>(params_.maxNumberOfThreads, 0);
 
-    // internal threadId to pthread threadId mapping used to track which threads are active
-    threadsOutstanding_ = std::vector<Thread_t>(gTestParams.maxNumberOfThreads);
-    memset(threadsOutstanding_.data(), -1, sizeof(Thread_t) * threadsOutstanding_.size());
+    // One arena per thread slot, reused by every config run in the slot & only resized when a config needs a
+    // different size. Each worker sizes its own
+    arenas_.clear();
+    for (int64_t threadId = 0; threadId < params_.maxNumberOfThreads; threadId++) {
+        arenas_.emplace_back(&hugePageUsage_);
+    }
+    workerFootprints_ = std::vector<uint64_t>(params_.maxNumberOfThreads, 0);
+    admittedBytes_ = 0;
+    peakAdmittedBytes_ = 0;
+
+    // Workers pinned to a node other than the one that parsed the trace would read it across the interconnect, give
+    // every node with workers a copy of its own
+    const uint64_t numNodesWithWorkers =
+        std::min<uint64_t>(topology_.GetNumaNodes().size(), params_.maxNumberOfThreads);
+    traceReplicas_.clear();
+    if (isPinningWorkers_) {
+        traceReplicas_ = std::vector<TraceReplica>(numNodesWithWorkers);
+        auto replicaContexts = std::vector<ReplicaContext>(numNodesWithWorkers);
+        auto replicaThreads = std::vector<Thread_t>(numNodesWithWorkers);
+        for (uint64_t nodeIndex = 0; nodeIndex < numNodesWithWorkers; nodeIndex++) {
+            replicaContexts[nodeIndex].pSimulator = this;
+            replicaContexts[nodeIndex].nodeIndex = nodeIndex;
+            Multithreading::StartThread(Simulator::BuildTraceReplica, static_cast<void*>(&replicaContexts[nodeIndex]),
+                                        &replicaThreads[nodeIndex]);
+        }
+        Multithreading::WaitForThreads(replicaThreads);
+    }
 
-    accessIndices_ = std::vector<uint64_t>(gTestParams.maxNumberOfThreads, 0);
+    // Longest first, so that the run does not end on a few large configs started last. As configs finish, the queue is
+    // reordered by their measured run times
+    configQueue_.clear();
+    for (uint64_t i = 0; i < numConfigs_; i++) {
+        if (aliasOf_[i] == i && shardOf_[i] == shardIndex_) {
+            configQueue_.push_back(i);
+        }
+    }
+    nextQueuedConfig_ = 0;
+    memset(measuredSeconds_, 0, sizeof(measuredSeconds_));
+    memset(measuredCosts_, 0, sizeof(measuredCosts_));
+    sortConfigQueue();
+    setMemoryBudget();
+
+    // Results are written as the configs complete rather than once they all did
+    pResultWriter_ = std::make_unique<ResultWriter>(descriptors_, summaries_, aliasOf_, params_.compareToOptimal,
+                                                    pTextStream_, pCSVStream_, pJSONStream_, pColumnsStream_);
+    pResultWriter_->Start();
 
 #if (CONSOLE_PRINT == 0)
     Thread_t progressThread;
     Multithreading::StartThread(Simulator::TrackProgress, this, &progressThread);
 #endif
 
-    auto contexts = std::vector<SimCacheContext>(numConfigs_);
-    for (uint64_t i = 0; i < numConfigs_; i++) {
-        while (numThreadsOutstanding_.load() == gTestParams.maxNumberOfThreads)
-            ;
-        Multithreading::Lock(&lock_);
-        ++numThreadsOutstanding_;
-        // Search for a threadId that is not in use
-        for (threadId = 0; threadId < gTestParams.maxNumberOfThreads; threadId++) {
-            if (threadsOutstanding_[threadId] == kInvalidThreadId) {
-                break;
-            }
-        }
-        contexts[i].caches = std::vector<Cache*>();
-        for (size_t j = 0; j < caches_[i].size(); ++j) {
-            caches_[i][j]->SetThreadId(threadId);
-            contexts[i].caches.push_back(caches_[i][j].get());
-        }
-        contexts[i].pSimulator = this;
-        contexts[i].configIndex = i;
-        Multithreading::StartThread(Simulator::SimCache, static_cast<void*>(&contexts[i]), &threads_[i]);
-
-        threadsOutstanding_[threadId] = threads_[i];
-        Multithreading::Unlock(&lock_);
+    // A fixed pool of workers, each pulls configs off the queue until it is empty. An idle worker takes the longest
+    // config left that fits in the memory budget, so many small configs run at once but only a few large ones.
+    // Joining them blocks until all configs are done
+    workers_ = std::vector<Thread_t>(params_.maxNumberOfThreads);
+    workerContexts_ = std::vector<WorkerContext>(params_.maxNumberOfThreads);
+    for (uint64_t threadId = 0; threadId < workers_.size(); threadId++) {
+        workerContexts_[threadId].pSimulator = this;
+        workerContexts_[threadId].threadId = threadId;
+        Multithreading::StartThread(Simulator::RunWorker, static_cast<void*>(&workerContexts_[threadId]),
+                                    &workers_[threadId]);
     }
-    Multithreading::WaitForThreads(threads_);
+    Multithreading::WaitForThreads(workers_);
 
 #if (CONSOLE_PRINT == 0)
     Multithreading::WaitForThreads(std::vector<Thread_t>(1, progressThread));
 #endif
     assert(numThreadsOutstanding_ == 0);
+    assert(admittedBytes_ == 0);
+    hugePageUsage_.PrintSummary(stdout);
+    constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+    printf("Peak RSS %.1f MiB, the configs running at once took up at most %.1f MiB\n",
+           getPeakResidentBytes() / kBytesPerMegabyte, peakAdmittedBytes_ / kBytesPerMegabyte);
+    // The writer fills in the results of the configs that were not simulated from the config they alias
+    pResultWriter_->Finish();
+    pResultWriter_.reset();
+}
+
+std::vector<ConfigDescriptor> Simulator::EnumerateConfigs(const TestParamaters& params) {
+    std::vector<ConfigDescriptor> descriptors;
+    Configuration configs[kMaxNumberOfCacheLevels];
+    SetupCaches(params, kL1, params.minBlockSize[kL1], params.minCacheSize[kL1], configs, descriptors);
+    for (const ConfigDescriptor& descriptor : descriptors) {
+        char error[128];
+        if (!Simulation::IsDescriptorValid(descriptor, error, sizeof(error))) {
+            fprintf(stderr, "Invalid config in the sweep of the ini: %s\n", error);
+            exit(1);
+        }
+    }
+    return descriptors;
 }
 
-void Simulator::SetupCaches(CacheLevel cacheLevel, uint64_t minBlockSize, uint64_t minCacheSize) {
-    static Configuration configs[kMaxNumberOfCacheLevels];
-    for (uint64_t blockSize = std::max(minBlockSize, gTestParams.minBlockSize[cacheLevel]);
-         blockSize <= gTestParams.maxBlockSize[cacheLevel]; blockSize <<= 1) {
-        for (uint64_t cacheSize = std::max(minCacheSize, blockSize); cacheSize <= gTestParams.maxCacheSize[cacheLevel];
+void Simulator::SetupCaches(const TestParamaters& params, CacheLevel cacheLevel, uint64_t minBlockSize,
+                            uint64_t minCacheSize, Configuration (&configs)[kMaxNumberOfCacheLevels],
+                            std::vector<ConfigDescriptor>& descriptors) {
+    for (uint64_t blockSize = std::max(minBlockSize, params.minBlockSize[cacheLevel]);
+         blockSize <= params.maxBlockSize[cacheLevel]; blockSize <<= 1) {
+        for (uint64_t cacheSize = std::max(minCacheSize, blockSize); cacheSize <= params.maxCacheSize[cacheLevel];
              cacheSize <<= 1) {
-            for (uint8_t blocksPerSet = gTestParams.minBlocksPerSet[cacheLevel];
-                 blocksPerSet <= gTestParams.maxBlocksPerSet[cacheLevel]; blocksPerSet <<= 1) {
+            for (uint64_t blocksPerSet = params.minBlocksPerSet[cacheLevel];
+                 blocksPerSet <= params.maxBlocksPerSet[cacheLevel]; blocksPerSet <<= 1) {
                 configs[cacheLevel].blockSize = blockSize;
                 configs[cacheLevel].cacheSize = cacheSize;
                 configs[cacheLevel].associativity = blocksPerSet;
-                if (Cache::IsCacheConfigValid(configs[cacheLevel])) {
-                    if (cacheLevel < gTestParams.numberOfCacheLevels - 1) {
+                if (!Cache::IsCacheConfigValid(configs[cacheLevel])) {
+                    continue;
+                }
+                for (LevelTiming timing : getTimingsToTest(params, cacheLevel)) {
+                    configs[cacheLevel].timing = timing;
+                    if (cacheLevel < params.numberOfCacheLevels - 1) {
                         assert(cacheLevel != kMaxNumberOfCacheLevels);
-                        SetupCaches(static_cast<CacheLevel>(cacheLevel + 1), blockSize,
-                                    gTestParams.minCacheSize[cacheLevel + 1]);
+                        SetupCaches(params, static_cast<CacheLevel>(cacheLevel + 1), blockSize,
+                                    params.minCacheSize[cacheLevel + 1], configs, descriptors);
                     } else {
-                        caches_.push_back(std::vector<std::unique_ptr<Cache>>());
-                        caches_.back().push_back(
-                            std::make_unique<Cache>(nullptr, kL1, gTestParams.numberOfCacheLevels, configs));
-                        Configuration instructionCacheConfig = Configuration(65536, 1024, 2);
-                        caches_.back().push_back(std::make_unique<Cache>(nullptr, kL1, 1, &instructionCacheConfig));
+                        for (LevelTiming mainMemoryTiming : getTimingsToTest(params, kMainMemory)) {
+                            addDescriptors(params, configs, mainMemoryTiming, descriptors);
+                        }
                     }
                 }
             }
         }
     }
 }
+
+std::vector<LevelTiming> Simulator::getTimingsToTest(const TestParamaters& params, CacheLevel cacheLevel) {
+    std::vector<LevelTiming> timings;
+    for (uint64_t accessTime = params.minAccessTimeInCycles[cacheLevel];
+         accessTime <= params.maxAccessTimeInCycles[cacheLevel]; accessTime <<= 1) {
+        for (uint64_t maxOutstandingRequests = params.minOutstandingRequests[cacheLevel];
+             maxOutstandingRequests <= params.maxOutstandingRequests[cacheLevel]; maxOutstandingRequests <<= 1) {
+            timings.push_back({accessTime, maxOutstandingRequests});
+        }
+    }
+    return timings;
+}
+
+void Simulator::addDescriptors(const TestParamaters& params, Configuration* pConfigs,
+                               const LevelTiming& mainMemoryTiming, std::vector<ConfigDescriptor>& descriptors) {
+    std::vector<ReplacementPolicy> replacementPolicies(1, params.replacementPolicy);
+    if (params.compareToOptimal) {
+        replacementPolicies.push_back(kOPT);
+    }
+    for (ReplacementPolicy replacementPolicy : replacementPolicies) {
+        // kOPT ranks victims by their next use in the data trace, the reference stream of L1 only. The levels below
+        // keep kLRU, so that kOPT changes L1 alone
+        pConfigs[kL1].replacementPolicy = replacementPolicy;
+        for (uint8_t i = 1; i < params.numberOfCacheLevels; i++) {
+            pConfigs[i].replacementPolicy = kLRU;
+        }
+        ConfigDescriptor descriptor = ConfigDescriptor();
+        std::copy(pConfigs, pConfigs + params.numberOfCacheLevels, descriptor.configs);
+        descriptor.mainMemoryTiming = mainMemoryTiming;
+        descriptor.numberOfCacheLevels = params.numberOfCacheLevels;
+        descriptors.push_back(descriptor);
+    }
+}
+
+std::vector<uint64_t> Simulator::GetResultKey(const ConfigDescriptor& descriptor, TraceFootprint& footprint) {
+    // Ways beyond the most blocks the trace maps to one set are never used for replacement, so all such
+    // associativities give identical results
+    std::vector<uint64_t> resultKey;
+    for (uint8_t i = 0; i < descriptor.numberOfCacheLevels; i++) {
+        const Configuration& config = descriptor.configs[i];
+        const uint64_t numSets = config.cacheSize / config.blockSize / config.associativity;
+        const bool isConflictFree = footprint.GetMaxBlocksPerSet(config.blockSize, numSets) <= config.associativity;
+        resultKey.push_back(config.blockSize);
+        resultKey.push_back(numSets);
+        resultKey.push_back(isConflictFree ? 0 : config.associativity);
+        resultKey.push_back(config.timing.accessTimeInCycles);
+        resultKey.push_back(config.timing.maxOutstandingRequests);
+    }
+    resultKey.push_back(descriptor.mainMemoryTiming.accessTimeInCycles);
+    resultKey.push_back(descriptor.mainMemoryTiming.maxOutstandingRequests);
+    resultKey.push_back(descriptor.configs[kL1].replacementPolicy);
+    return resultKey;
+}
@@ -0,0 +1,159 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "Topology.h"
+
+#ifdef __linux__
+/**
+ * @brief           Parses a sysfs CPU list such as "0-3,8-11"
+ *
+ * @param pFilename File holding the list
+ * @return          CPUs of the list, empty if the file could not be read
+ */
+static std::vector<uint32_t> readCpuList(const char* pFilename) {
+    std::vector<uint32_t> cpus;
+    FILE* pFile = fopen(pFilename, "r");
+    if (pFile == nullptr) {
+        return cpus;
+    }
+    unsigned first;
+    while (fscanf(pFile, "%u", &first) == 1) {
+        unsigned last = first;
+        int separator = fgetc(pFile);
+        if (separator == '-') {
+            if (fscanf(pFile, "%u", &last) != 1) {
+                break;
+            }
+            separator = fgetc(pFile);
+        }
+        for (unsigned cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(pFile);
+    return cpus;
+}
+
+static bool pinCurrentThread(const std::vector<uint32_t>& cpus) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (uint32_t cpu : cpus) {
+        CPU_SET(cpu, &cpuSet);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+}
+#endif
+
+static std::vector<NumaNode> discoverNumaNodes() {
+    std::vector<NumaNode> nodes;
+#ifdef __linux__
+    cpu_set_t allowedCpus;
+    CPU_ZERO(&allowedCpus);
+    const bool isAffinityKnown = sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) == 0;
+    std::vector<uint32_t> nodeIds = readCpuList("/sys/devices/system/node/online");
+    for (uint32_t nodeId : nodeIds) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%u/cpulist", nodeId);
+        NumaNode node;
+        node.nodeId = nodeId;
+        for (uint32_t cpu : readCpuList(filename)) {
+            // A cpuset (e.g. a container or taskset) may leave only part of a node to this process
+            if (!isAffinityKnown || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowedCpus))) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            nodes.push_back(node);
+        }
+    }
+    if (nodes.empty() && isAffinityKnown) {
+        // No NUMA support in the kernel, all allowed CPUs are one node
+        NumaNode node;
+        node.nodeId = 0;
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowedCpus)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(node);
+    }
+#endif
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, std::vector<uint32_t>()});
+    }
+    return nodes;
+}
+
+Topology::Topology() : nodes_(discoverNumaNodes()) {
+}
+
+uint64_t Topology::GetNodeIndexOfWorker(uint64_t workerIndex) const {
+    return workerIndex % nodes_.size();
+}
+
+bool Topology::ShouldPinWorkers(uint64_t numWorkers) const {
+    return nodes_.size() > 1 && numWorkers > 1;
+}
+
+bool Topology::PinWorker(uint64_t workerIndex) const {
+    return PinToNode(GetNodeIndexOfWorker(workerIndex));
+}
+
+bool Topology::PinToNode(uint64_t nodeIndex) const {
+    const NumaNode& node = nodes_[nodeIndex];
+    if (node.cpus.empty()) {
+        return false;
+    }
+#ifdef __linux__
+    return pinCurrentThread(node.cpus);
+#else
+    return false;
+#endif
+}
+
+void Topology::PrintSummary(uint64_t numWorkers, bool isPinned, FILE* stream) const {
+    const std::vector<NumaNode>& nodes = nodes_;
+    if (nodes.size() == 1 && nodes[0].cpus.empty()) {
+        fprintf(stream, "CPU topology unknown, %" PRIu64 " workers are not pinned\n", numWorkers);
+        return;
+    }
+    if (isPinned) {
+        fprintf(stream, "%zu NUMA nodes, %" PRIu64 " workers pinned round-robin across them\n", nodes.size(),
+                numWorkers);
+    } else {
+        fprintf(stream, "%zu NUMA node(s), %" PRIu64 " workers left to the scheduler\n", nodes.size(), numWorkers);
+    }
+    for (uint64_t nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++) {
+        const NumaNode& node = nodes[nodeIndex];
+        const uint64_t numNodeWorkers = numWorkers / nodes.size() + (nodeIndex < numWorkers % nodes.size() ? 1 : 0);
+        fprintf(stream, "  node %u: %zu CPUs (", node.nodeId, node.cpus.size());
+        // Print the CPUs as ranges, the way sysfs lists them
+        for (uint64_t i = 0; i < node.cpus.size();) {
+            uint64_t last = i;
+            while (last + 1 < node.cpus.size() && node.cpus[last + 1] == node.cpus[last] + 1) {
+                last++;
+            }
+            fprintf(stream, i ? ",%u" : "%u", node.cpus[i]);
+            if (last != i) {
+                fprintf(stream, "-%u", node.cpus[last]);
+            }
+            i = last + 1;
+        }
+        if (isPinned) {
+            fprintf(stream, "), %" PRIu64 " workers\n", numNodeWorkers);
+        } else {
+            fprintf(stream, ")\n");
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "GlobalIncludes.h"
+#include "TraceFootprint.h"
+#include "debug.h"
+
+TraceFootprint::TraceFootprint(const InstructionSpan_t& dataAccesses) : dataAccesses_(dataAccesses) {
+}
+
+uint64_t TraceFootprint::GetNumberOfBlocks(uint64_t blockSize) {
+    return getBlockAddresses(blockSize).size();
+}
+
+uint64_t TraceFootprint::GetMaxBlocksPerSet(uint64_t blockSize, uint64_t numSets) {
+    assert(isPowerOfTwo(numSets));
+    auto [iterator, inserted] = maxBlocksPerSet_.try_emplace(std::make_pair(blockSize, numSets), 0);
+    if (inserted) {
+        const std::vector<uint64_t>& blockAddresses = getBlockAddresses(blockSize);
+        std::vector<uint64_t> blocksPerSet(numSets, 0);
+        for (uint64_t blockAddress : blockAddresses) {
+            uint64_t count = ++blocksPerSet[blockAddress & (numSets - 1)];
+            iterator->second = std::max(iterator->second, count);
+        }
+    }
+    return iterator->second;
+}
+
+void TraceFootprint::PrintSummary(FILE* stream) const {
+    for (const auto& [blockSize, blockAddresses] : blockAddresses_) {
+        fprintf(stream, "Trace footprint with %" PRIu64 "B blocks = %" PRIu64 " blocks (%" PRIu64 "B)\n", blockSize,
+                static_cast<uint64_t>(blockAddresses.size()), blockSize * blockAddresses.size());
+    }
+}
+
+const std::vector<uint64_t>& TraceFootprint::getBlockAddresses(uint64_t blockSize) {
+    assert_release(isPowerOfTwo(blockSize) && "Block size must be a power of 2!");
+    auto [iterator, inserted] = blockAddresses_.try_emplace(blockSize);
+    if (inserted) {
+        uint64_t blockSizeBits = 0;
+        for (uint64_t tmp = blockSize; tmp > 1; tmp >>= 1) {
+            blockSizeBits++;
+        }
+        std::vector<uint64_t>& blockAddresses = iterator->second;
+        blockAddresses.reserve(dataAccesses_.size());
+        for (const Instruction& access : dataAccesses_) {
+            blockAddresses.push_back(access.ptr >> blockSizeBits);
+        }
+        std::sort(blockAddresses.begin(), blockAddresses.end());
+        blockAddresses.erase(std::unique(blockAddresses.begin(), blockAddresses.end()), blockAddresses.end());
+        blockAddresses.shrink_to_fit();
+    }
+    return iterator->second;
+}
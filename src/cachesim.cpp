@@ -0,0 +1,152 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+#include "Cache.h"
+#include "Simulation.h"
+#include "cachesim.h"
+
+static_assert(CACHESIM_MAX_CACHE_LEVELS == kMaxNumberOfCacheLevels, "Update CACHESIM_MAX_CACHE_LEVELS");
+static_assert(CACHESIM_LRU == static_cast<int>(kLRU) && CACHESIM_OPT == static_cast<int>(kOPT),
+              "Update cachesim_replacement_policy");
+
+struct cachesim_trace {
+    std::shared_ptr<Trace> pTrace;
+};
+
+struct cachesim_simulation {
+    std::unique_ptr<Simulation> pSimulation;
+};
+
+struct cachesim_pool {
+    std::unique_ptr<WorkerPool> pPool;
+};
+
+/**
+ * @brief               Converts a hierarchy of the C ABI to a config
+ *
+ * @param hierarchy     Hierarchy to convert
+ * @return              Config of the hierarchy
+ */
+static ConfigDescriptor toDescriptor(const cachesim_hierarchy& hierarchy) {
+    ConfigDescriptor descriptor = ConfigDescriptor();
+    descriptor.numberOfCacheLevels = hierarchy.number_of_cache_levels;
+    for (uint8_t i = 0; i < kMaxNumberOfCacheLevels; i++) {
+        const cachesim_cache_config& level = hierarchy.levels[i];
+        Configuration& config = descriptor.configs[i];
+        config.cacheSize = level.cache_size;
+        config.blockSize = level.block_size;
+        config.associativity = level.associativity;
+        config.replacementPolicy = static_cast<ReplacementPolicy>(level.replacement_policy);
+        config.timing = {level.timing.access_time_in_cycles, level.timing.max_outstanding_requests};
+    }
+    descriptor.mainMemoryTiming = {hierarchy.main_memory_timing.access_time_in_cycles,
+                                   hierarchy.main_memory_timing.max_outstanding_requests};
+    return descriptor;
+}
+
+extern "C" {
+
+cachesim_trace* cachesim_trace_load(const char* filename) {
+    std::shared_ptr<Trace> pTrace = Trace::Load(filename);
+    if (pTrace == nullptr) {
+        return nullptr;
+    }
+    return new cachesim_trace{pTrace};
+}
+
+uint64_t cachesim_trace_get_num_instructions(const cachesim_trace* trace) {
+    return trace->pTrace->GetNumInstructions();
+}
+
+void cachesim_trace_free(cachesim_trace* trace) {
+    delete trace;
+}
+
+void cachesim_hierarchy_init(cachesim_hierarchy* hierarchy, uint8_t number_of_cache_levels) {
+    const ConfigDescriptor descriptor = Simulation::GetDefaultDescriptor(number_of_cache_levels);
+    *hierarchy = cachesim_hierarchy();
+    hierarchy->number_of_cache_levels = number_of_cache_levels;
+    for (uint8_t i = 0; i < kMaxNumberOfCacheLevels; i++) {
+        hierarchy->levels[i].replacement_policy = CACHESIM_LRU;
+        hierarchy->levels[i].timing = {descriptor.configs[i].timing.accessTimeInCycles,
+                                       descriptor.configs[i].timing.maxOutstandingRequests};
+    }
+    hierarchy->main_memory_timing = {descriptor.mainMemoryTiming.accessTimeInCycles,
+                                     descriptor.mainMemoryTiming.maxOutstandingRequests};
+}
+
+int cachesim_hierarchy_validate(const cachesim_hierarchy* hierarchy, char* error, size_t error_size) {
+    char ignoredError[128];
+    if (error == nullptr) {
+        error = ignoredError;
+        error_size = sizeof(ignoredError);
+    }
+    return Simulation::IsDescriptorValid(toDescriptor(*hierarchy), error, error_size);
+}
+
+cachesim_simulation* cachesim_simulation_create(cachesim_trace* trace, const cachesim_hierarchy* hierarchies,
+                                                size_t num_hierarchies, char* error, size_t error_size) {
+    std::vector<ConfigDescriptor> descriptors;
+    for (size_t i = 0; i < num_hierarchies; i++) {
+        char hierarchyError[128];
+        if (!cachesim_hierarchy_validate(&hierarchies[i], hierarchyError, sizeof(hierarchyError))) {
+            if (error) {
+                snprintf(error, error_size, "Hierarchy %zu: %s", i, hierarchyError);
+            }
+            return nullptr;
+        }
+        descriptors.push_back(toDescriptor(hierarchies[i]));
+    }
+    return new cachesim_simulation{std::make_unique<Simulation>(trace->pTrace, std::move(descriptors))};
+}
+
+void cachesim_simulation_run(cachesim_simulation* simulation) {
+    simulation->pSimulation->Run();
+}
+
+void cachesim_simulation_run_one(cachesim_simulation* simulation, size_t index) {
+    Arena arena;
+    simulation->pSimulation->RunConfig(index, arena);
+}
+
+void cachesim_simulation_wait(cachesim_simulation* simulation) {
+    simulation->pSimulation->Wait();
+}
+
+void cachesim_simulation_get_result(const cachesim_simulation* simulation, size_t index, cachesim_result* result) {
+    const ConfigSummary& summary = simulation->pSimulation->GetSummary(index);
+    *result = cachesim_result();
+    for (uint8_t i = 0; i < simulation->pSimulation->GetDescriptor(index).numberOfCacheLevels; i++) {
+        const Statistics& stats = summary.stats[i];
+        const LatencySummary& latency = summary.latencies[i];
+        result->levels[i] = {stats.readHits, stats.readMisses, stats.writeHits, stats.writeMisses, stats.writebacks,
+                             latency.p50,    latency.p90,      latency.p99,     latency.max};
+    }
+    result->number_of_instructions = summary.stats[kL1].numInstructions;
+    result->cycles = summary.cycles;
+    if (result->number_of_instructions) {
+        result->cpi = static_cast<double>(result->cycles) / static_cast<double>(result->number_of_instructions);
+    }
+}
+
+void cachesim_simulation_free(cachesim_simulation* simulation) {
+    delete simulation;
+}
+
+cachesim_pool* cachesim_pool_create(uint64_t num_workers) {
+    return new cachesim_pool{std::make_unique<WorkerPool>(num_workers)};
+}
+
+void cachesim_pool_submit(cachesim_pool* pool, cachesim_simulation* simulation) {
+    pool->pPool->Submit(*simulation->pSimulation);
+}
+
+void cachesim_pool_free(cachesim_pool* pool) {
+    delete pool;
+}
+
+} // extern "C"
@@ -3,86 +3,89 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdlib.h>
 
-DoubleList::DoubleList(uint64_t capacity) {
-    pHead_ = nullptr;
-    pTail_ = nullptr;
+IndexList::IndexList(IndexListNode* pNodes, uint64_t capacity) {
+    pNodes_ = pNodes;
+    head_ = kNone;
+    tail_ = kNone;
     count_ = 0;
     capacity_ = capacity;
 }
 
-DoubleList::~DoubleList() {
-    for_each_in_double_list(this) {
-        (void)poolIndex;
-        delete elementIterator;
+void IndexList::Remove(uint64_t index) {
+    IndexListNode& node = pNodes_[index];
+    assert(count_);
+    if (node.previous != kNone) {
+        pNodes_[node.previous].next = node.next;
+    } else {
+        assert(head_ == index);
+        head_ = node.next;
     }
-}
-
-bool DoubleList::RemoveElement(DoubleListElement* pElement) {
-    for_each_in_double_list(this) {
-        (void)poolIndex;
-        if (elementIterator == pElement) {
-            if (pElement->pPrevious_) {
-                pElement->pPrevious_->pNext_ = pElement->pNext_;
-            }
-            if (pElement->pNext_) {
-                pElement->pNext_->pPrevious_ = pElement->pPrevious_;
-            }
-            if (pHead_ == pElement) {
-                pHead_ = pElement->pNext_;
-            }
-            if (pTail_ == pElement) {
-                pTail_ = pElement->pPrevious_;
-            }
-            count_--;
-            return true;
-        }
+    if (node.next != kNone) {
+        pNodes_[node.next].previous = node.previous;
+    } else {
+        assert(tail_ == index);
+        tail_ = node.previous;
     }
-    return false;
+    count_--;
 }
 
-bool DoubleList::AddElementToTail(DoubleListElement* pElement) {
+bool IndexList::PushBack(uint64_t index) {
     if (count_ == capacity_) {
         return false;
     }
-    pElement->pNext_ = NULL;
-    pElement->pPrevious_ = pTail_;
-    if (pTail_) {
-        pTail_->pNext_ = pElement;
+    IndexListNode& node = pNodes_[index];
+    node.next = kNone;
+    node.previous = tail_;
+    if (tail_ != kNone) {
+        pNodes_[tail_].next = static_cast<uint32_t>(index);
     } else {
-        pHead_ = pElement;
+        head_ = static_cast<uint32_t>(index);
     }
-    pTail_ = pElement;
+    tail_ = static_cast<uint32_t>(index);
     count_++;
     return true;
 }
 
-bool DoubleList::PushElement(DoubleListElement* pElement) {
+bool IndexList::PushFront(uint64_t index) {
     if (count_ == capacity_) {
         return false;
     }
-    pElement->pPrevious_ = NULL;
-    pElement->pNext_ = pHead_;
-    if (pHead_) {
-        pHead_->pPrevious_ = pElement;
+    IndexListNode& node = pNodes_[index];
+    node.previous = kNone;
+    node.next = head_;
+    if (head_ != kNone) {
+        pNodes_[head_].previous = static_cast<uint32_t>(index);
+    } else {
+        tail_ = static_cast<uint32_t>(index);
     }
-    pHead_ = pElement;
+    head_ = static_cast<uint32_t>(index);
     count_++;
     return true;
 }
 
-DoubleListElement* DoubleList::PopElement() {
-    DoubleListElement* head = pHead_;
-    if (head == pTail_) {
-        pTail_ = nullptr;
+void IndexList::InsertAfter(uint64_t index, uint64_t previous) {
+    assert(count_ < capacity_);
+    if (previous == kNone) {
+        PushFront(index);
+        return;
     }
-    if (head) {
-        if (head->pNext_) {
-            head->pNext_->pPrevious_ = NULL;
-        }
-        pHead_ = head->pNext_;
-        count_--;
+    IndexListNode& node = pNodes_[index];
+    node.previous = static_cast<uint32_t>(previous);
+    node.next = pNodes_[previous].next;
+    if (node.next != kNone) {
+        pNodes_[node.next].previous = static_cast<uint32_t>(index);
+    } else {
+        tail_ = static_cast<uint32_t>(index);
+    }
+    pNodes_[previous].next = static_cast<uint32_t>(index);
+    count_++;
+}
+
+uint64_t IndexList::PopFront() {
+    const uint64_t head = head_;
+    if (head != kNone) {
+        Remove(head);
     }
     return head;
 }
@@ -1,6 +1,10 @@
+#include <algorithm>
 #include <cinttypes>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <thread>
 
 #ifdef __GNUC__
 #include <unistd.h>
@@ -10,17 +14,31 @@
 #include <time.h>
 #endif
 
+#include "Batch.h"
 #include "Cache.h"
+#include "Daemon.h"
 #include "IOUtilities.h"
 #include "SimTracer.h"
 #include "Simulator.h"
 #include "debug.h"
 #include "default_test_params.h"
+
 /**
  *  @brief Prints the usage of the program in case of error
  */
 static void usage(void) {
-    fprintf(stderr, "Usage: ./cache <input trace> [output statistics file]\n");
+    fprintf(stderr, "Usage: ./cache [--shard <i>/<N>] [--jsonl <file>] [--columns <file>] <input trace> [output "
+                    "statistics file]\n"
+                    "       ./cache --batch <output statistics file> <input trace>[@weight]...\n"
+                    "       ./cache --daemon <socket path>\n"
+                    "  --shard <i>/<N>  Simulate shard i of N of the sweep & write its partial results to the output\n"
+                    "                   file, to be combined with cache-merge\n"
+                    "  --jsonl <file>   Also write the results of every config as a line of JSON as it completes\n"
+                    "  --columns <file> Also write the results in the binary columnar format of inc/ResultWriter.h\n"
+                    "  --batch          Run the sweep over a suite of traces on one worker pool, & weigh the\n"
+                    "                   results of every config over the suite. Weights default to 1. The traces\n"
+                    "                   & the configs running at once are kept within MEMORY_BUDGET_MB\n"
+                    "  --daemon         Serve simulation jobs on a Unix domain socket, see inc/Daemon.h\n");
     exit(1);
 }
 
@@ -31,6 +49,74 @@ int main(int argc, char** argv) {
     time_t t = time(NULL);
     FILE* pTextOutputStream = stdout;
     FILE* pCsvOutputStream = nullptr;
+    uint64_t shardIndex = 0;
+    uint64_t numShards = 1;
+    if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
+        if (argc != 3) {
+            usage();
+        }
+#if (SIM_TRACE == 1 || CONSOLE_PRINT == 1)
+        fprintf(stderr, "Daemon mode runs jobs concurrently & unattended, it is not built with sim trace or console "
+                        "print\n");
+        exit(1);
+#endif
+        // Only the thread count is taken from the ini, jobs bring their own configs
+        TestParamaters params;
+        IOUtilities::LoadTestParameters(params);
+        int64_t numWorkers = params.maxNumberOfThreads;
+        if (numWorkers < 0) {
+            numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        Daemon daemon(numWorkers);
+        return daemon.Run(argv[2]);
+    }
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        if (argc < 4) {
+            usage();
+        }
+#if (SIM_TRACE == 1 || CONSOLE_PRINT == 1)
+        fprintf(stderr, "Batch mode runs the traces concurrently, it is not built with sim trace or console print\n");
+        exit(1);
+#endif
+        TestParamaters params;
+        IOUtilities::LoadTestParameters(params);
+        Batch batch(params);
+        for (int i = 3; i < argc; i++) {
+            if (!batch.AddTrace(argv[i])) {
+                fprintf(stderr, "Invalid weight in %s, expected a positive number\n", argv[i]);
+                usage();
+            }
+        }
+        const int status = batch.Run(argv[2]);
+        t = time(NULL) - t;
+        printf("Program took %" PRId64 " seconds\n", t);
+        return status;
+    }
+    FILE* pJSONOutputStream = nullptr;
+    FILE* pColumnsOutputStream = nullptr;
+    while (argc > 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--shard") == 0) {
+            if (sscanf(argv[2], "%" SCNu64 "/%" SCNu64, &shardIndex, &numShards) != 2 || numShards == 0 ||
+                shardIndex >= numShards) {
+                fprintf(stderr, "Invalid shard, expected <i>/<N> with i < N\n");
+                usage();
+            }
+        } else if (strcmp(argv[1], "--jsonl") == 0 || strcmp(argv[1], "--columns") == 0) {
+            const bool isJSON = strcmp(argv[1], "--jsonl") == 0;
+            FILE*& pStream = isJSON ? pJSONOutputStream : pColumnsOutputStream;
+            pStream = fopen(argv[2], isJSON ? "w" : "wb");
+            if (pStream == nullptr) {
+                fprintf(stderr, "Unable to open output file %s\n", argv[2]);
+                usage();
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[1]);
+            usage();
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    const bool isSharded = numShards > 1;
     if (argc < 2) {
         fprintf(stderr, "Not enough args!\n");
         usage();
@@ -40,16 +126,34 @@ int main(int argc, char** argv) {
             fprintf(stderr, "Unable to open output file %s\n", argv[2]);
             usage();
         }
-        std::string csvOutputFilename(argv[2]);
-        csvOutputFilename.append(".csv");
-        pCsvOutputStream = fopen(csvOutputFilename.c_str(), "w");
+        if (!isSharded) {
+            std::string csvOutputFilename(argv[2]);
+            csvOutputFilename.append(".csv");
+            pCsvOutputStream = fopen(csvOutputFilename.c_str(), "w");
+        }
+    } else if (isSharded) {
+        fprintf(stderr, "A shard needs an output file for its partial results\n");
+        usage();
     }
 
-    Simulator simulator(argv[1]);
+    // Look for test parameters file and generate a default if not found
+    TestParamaters params;
+    IOUtilities::LoadTestParameters(params);
+    Simulator simulator(argv[1], params, shardIndex, numShards);
 
+    // A shard only writes its partial results to the text output, once it is done
+    simulator.SetResultStreams(isSharded ? nullptr : pTextOutputStream, pCsvOutputStream, pJSONOutputStream,
+                               pColumnsOutputStream);
     simulator.CreateAndRunThreads();
-    simulator.PrintStats(pTextOutputStream, pCsvOutputStream);
+    if (isSharded) {
+        simulator.WritePartialResults(pTextOutputStream);
+    }
 
+    for (FILE* pStream : {pCsvOutputStream, pJSONOutputStream, pColumnsOutputStream}) {
+        if (pStream) {
+            fclose(pStream);
+        }
+    }
     if (pTextOutputStream != stdout) {
         fclose(pTextOutputStream);
     }
@@ -0,0 +1,109 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Cache.h"
+#include "IOUtilities.h"
+
+/**
+ *  @brief Prints the usage of the program in case of error
+ */
+static void usage(void) {
+    fprintf(stderr, "Usage: ./cache-merge <output statistics file> <partial results file>...\n"
+                    "Combines the partial results of every shard of a sweep (./cache --shard <i>/<N>) into the output\n"
+                    "that a single ./cache run of the whole sweep writes\n");
+    exit(1);
+}
+
+/**
+ * MAIN FUNCTION
+ */
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Not enough args!\n");
+        usage();
+    }
+
+    std::vector<ConfigDescriptor> descriptors;
+    std::vector<ConfigSummary> summaries;
+    std::vector<bool> hasResult;
+    std::vector<bool> hasShard;
+    bool compareToOptimal = false;
+    uint64_t sweepFingerprint = 0;
+    for (int i = 2; i < argc; i++) {
+        FILE* pPartialStream = fopen(argv[i], "r");
+        if (pPartialStream == nullptr) {
+            fprintf(stderr, "Unable to open partial results file %s\n", argv[i]);
+            exit(1);
+        }
+        PartialResults results;
+        if (!IOUtilities::ReadPartialResults(pPartialStream, results)) {
+            fprintf(stderr, "%s is not a partial results file, or is truncated\n", argv[i]);
+            exit(1);
+        }
+        fclose(pPartialStream);
+        if (descriptors.empty()) {
+            descriptors = std::vector<ConfigDescriptor>(results.numConfigs);
+            summaries = std::vector<ConfigSummary>(results.numConfigs);
+            hasResult = std::vector<bool>(results.numConfigs, false);
+            hasShard = std::vector<bool>(results.numShards, false);
+            compareToOptimal = results.compareToOptimal;
+            sweepFingerprint = results.sweepFingerprint;
+        }
+        // Another ini or trace with as many configs would otherwise merge into a wrong report
+        if (results.numConfigs != descriptors.size() || results.numShards != hasShard.size() ||
+            results.compareToOptimal != compareToOptimal || results.sweepFingerprint != sweepFingerprint) {
+            fprintf(stderr, "%s is from a different sweep than %s\n", argv[i], argv[2]);
+            exit(1);
+        }
+        if (hasShard[results.shardIndex]) {
+            fprintf(stderr, "Shard %" PRIu64 " is given twice\n", results.shardIndex);
+            exit(1);
+        }
+        hasShard[results.shardIndex] = true;
+        for (uint64_t j = 0; j < results.configIndices.size(); j++) {
+            const uint64_t configIndex = results.configIndices[j];
+            if (configIndex >= descriptors.size() || hasResult[configIndex]) {
+                fprintf(stderr, "%s has an invalid or duplicate config %" PRIu64 "\n", argv[i], configIndex);
+                exit(1);
+            }
+            descriptors[configIndex] = results.descriptors[j];
+            summaries[configIndex] = results.summaries[j];
+            hasResult[configIndex] = true;
+        }
+    }
+    for (uint64_t shardIndex = 0; shardIndex < hasShard.size(); shardIndex++) {
+        if (!hasShard[shardIndex]) {
+            fprintf(stderr, "Missing the results of shard %" PRIu64 "/%zu\n", shardIndex, hasShard.size());
+            exit(1);
+        }
+    }
+    if (descriptors.empty()) {
+        fprintf(stderr, "The sweep has no configs\n");
+        exit(1);
+    }
+    for (uint64_t configIndex = 0; configIndex < hasResult.size(); configIndex++) {
+        if (!hasResult[configIndex]) {
+            fprintf(stderr, "No shard has the results of config %" PRIu64 "\n", configIndex);
+            exit(1);
+        }
+    }
+
+    FILE* pTextOutputStream = fopen(argv[1], "w");
+    if (pTextOutputStream == nullptr) {
+        fprintf(stderr, "Unable to open output file %s\n", argv[1]);
+        usage();
+    }
+    std::string csvOutputFilename(argv[1]);
+    csvOutputFilename.append(".csv");
+    FILE* pCsvOutputStream = fopen(csvOutputFilename.c_str(), "w");
+    IOUtilities::PrintResults(descriptors, summaries, compareToOptimal, pTextOutputStream, pCsvOutputStream);
+    fclose(pTextOutputStream);
+    if (pCsvOutputStream) {
+        fclose(pCsvOutputStream);
+    }
+    printf("Merged %d shards into %s\n", argc - 2, argv[1]);
+    return 0;
+}